@@ -31,7 +31,7 @@ from arybo.lib.mba_impl_petanque import simplify as simplify_vec
 from arybo.lib.mba_impl_petanque import expand_esf as expand_esf_vec
 from arybo.lib.mba_impl_petanque import simplify_inplace as simplify_inplace_vec
 from arybo.lib.mba_impl_petanque import expand_esf_inplace as expand_esf_inplace_vec
-from pytanque import Vector, Expr
+from pytanque import Vector, VectorView, Expr
 
 def expr_contains(e, o):
     ''' Returns true if o is in e '''
@@ -240,13 +240,10 @@ class MBAVariable(object):
 
     def __getitem__(self, v):
         if isinstance(v, slice):
-            indices = range(*v.indices(self.nbits))
             # Returns a variable from a different MBA space
-            mba_ret = self.__new_mba(len(indices))
-            ret = mba_ret.from_cst(0)
-            for i,idx in enumerate(indices):
-                ret.vec[i] = self.at(idx)
-            return ret
+            vec = self.vec[v]
+            mba_ret = self.__new_mba(len(vec))
+            return mba_ret.from_vec(vec)
         elif isinstance(v, six.integer_types):
             return self.at(v)
         else:
@@ -263,10 +260,7 @@ class MBAVariable(object):
             raise ValueError("n must be > %d bits" % self.nbits)
 
         mba_ret = self.__new_mba(n)
-        ret = mba_ret.from_cst(0)
-        for i in range(self.nbits):
-            ret.vec[i] = self.vec[i]
-        return mba_ret.from_vec(ret)
+        return mba_ret.from_vec(VectorView.extend(self.vec, n).to_vector())
 
     def sext(self, n):
         ''' Sign-extend the variable to n bits.
@@ -279,13 +273,8 @@ class MBAVariable(object):
             raise ValueError("n must be > %d bits" % self.nbits)
 
         mba_ret = self.__new_mba(n)
-        ret = mba_ret.from_cst(0)
-        for i in range(self.nbits):
-            ret.vec[i] = self.vec[i]
         last_bit = self.vec[self.nbits-1]
-        for i in range(self.nbits,n):
-            ret.vec[i] = last_bit
-        return mba_ret.from_vec(ret)
+        return mba_ret.from_vec(VectorView.extend(self.vec, n, last_bit).to_vector())
 
     def evaluate(self, values):
         ''' Evaluates the expression to an integer
@@ -28,29 +28,21 @@ import copy
 import six
 from six.moves import range
 
+from pytanque import MBA as NativeMBA
 from pytanque import symbol, imm, Vector, Matrix, simplify, simplify_inplace, expand_esf_inplace, subs_vectors, subs_exprs, subs_exprs_inplace, analyses, esf_vector, esf, expand_esf, or_to_esf_inplace, Expr
 
 def get_vector_from_cst(nbits, n):
-    vec = Vector(nbits)
-    vec.set_int_be(n, nbits)
-    return vec
+    return NativeMBA(nbits).cst(n & ((1<<nbits) - 1))
 
 def get_int(nbits, v):
-    return v.get_int_be()
-
-def popcount(n):
+    # Vector.get_int_be only reads the first 64 bits
+    if len(v) <= 64:
+        return v.get_int_be()
     ret = 0
-    while n>0:
-        if (n&1) == 1:
-            ret += 1
-        n >>= 1
+    for i in range(0, len(v), 64):
+        ret |= v[i:i+64].get_int_be() << i
     return ret
 
-def next_zero_bit(v):
-    v = ~v
-    v = (v ^ (v - 1)) >> 1
-    return popcount(v)
-
 def evaluate_expr(E, nbits, map_):
     # keys of map_ can be mba variables or symbols
     #   => an mba variable must map to an integer or an mba variable
@@ -84,7 +76,7 @@ def evaluate_expr(E, nbits, map_):
     subs_exprs_inplace(E, keys, values)
     simplify_inplace(E)
     try:
-        return E.get_int_be()
+        return get_int(nbits, E)
     except RuntimeError:
         return E
 
@@ -101,26 +93,34 @@ def test_N(nbits, X, n):
 
 class MBAImpl(object):
     def __init__(self, nbits):
-        self.__set_nbits(nbits)
+        self._mba = NativeMBA(nbits)
+        self.nbits = nbits
+        self.max_uint = (1<<nbits) - 1
         self.gen_x = Vector(nbits)
-        self.use_esf = False
-        self.use_opt_mba = True
         for i in range(0, nbits):
             self.gen_x[i] = symbol("__gen_X_%d" % i)
 
-    def __set_nbits(self, nbits):
-        self.nbits = nbits
-        self.max_uint = (1<<nbits) - 1
+    @property
+    def use_esf(self):
+        return self._mba.use_esf
+
+    @use_esf.setter
+    def use_esf(self, v):
+        self._mba.use_esf = v
+
+    @property
+    def use_opt_mba(self):
+        return self._mba.use_opt_mba
+
+    @use_opt_mba.setter
+    def use_opt_mba(self, v):
+        self._mba.use_opt_mba = v
 
     def var_symbols(self, name):
-        symbols = [symbol("%s%d" % (name, i)) for i in range(0, self.nbits)]
-        M = Vector(self.nbits)
-        for i in range(0, self.nbits):
-            M[i] = symbols[i]
-        return M
+        return self._mba.var_symbols(name)
 
     def get_vector_from_cst(self, n):
-        return get_vector_from_cst(self.nbits, n)
+        return self._mba.cst(n & self.max_uint)
 
     def get_int(self, v):
         return get_int(self.nbits, v)
@@ -134,218 +134,41 @@ class MBAImpl(object):
     def null_matrix(self):
         return Matrix(self.nbits, self.nbits)
 
-#    def iadd_Y(self, X, Y):
-#        carry = imm(0)
-#        for i in range(0, self.nbits):
-#            Xi = X[i]
-#            mul_XY = simplify_inplace(Xi*Y[i])
-#            Xi += Y[i]
-#            simplify_inplace(Xi)
-#            carry_new = simplify_inplace(mul_XY + (carry * Xi))
-#            Xi += carry
-#            simplify_inplace(Xi)
-#            carry = carry_new
+    # Word-level operations are implemented by pytanque.MBA. Constants are
+    # truncated to nbits bits.
 
     def iadd_Y(self, X, Y):
-        carry = imm(0)
-        ret = Vector(self.nbits)
-        if self.use_esf:
-            for i in range(0, self.nbits):
-                new_carry = esf(2, [X[i], Y[i], carry])
-                X[i] += simplify_inplace(Y[i]+carry)
-                carry = new_carry
-        else:
-            for i in range(0, self.nbits):
-                sum_XY = simplify_inplace(X[i]+Y[i])
-                new_carry = simplify_inplace(X[i]*Y[i] + (carry * sum_XY))
-                X[i] = sum_XY + carry
-                carry = new_carry
-        return ret
+        self._mba.iadd_Y(X, Y)
+        return X
 
     def add_Y(self, X, Y):
-        carry = imm(0)
-        ret = Vector(self.nbits)
-        if self.use_esf:
-            for i in range(0, self.nbits):
-                ret[i] = simplify_inplace(X[i]+Y[i]+carry)
-                carry = esf(2, [X[i], Y[i], carry])
-        else:
-            for i in range(0, self.nbits):
-                sum_XY = simplify_inplace(X[i]+Y[i])
-                ret[i] = simplify_inplace(sum_XY+carry)
-                carry = simplify_inplace(X[i]*Y[i] + (carry * sum_XY))
-        return ret
+        return self._mba.add_Y(X, Y)
 
     def add_n(self, X, n):
-        n = n & self.max_uint
-        if self.use_esf or not self.use_opt_mba:
-            return self.add_Y(X, self.get_vector_from_cst(n))
-        else:
-            return self.add_n_mba(X, n)
-
-    def add_n_mba(self, X, n):
-        null = Vector(self.nbits)
-        n = self.get_vector_from_cst(n)
-        while (n != null):
-            new_X = simplify_inplace(self.xor_Y(X, n))
-            n = simplify_inplace(self.and_Y(self.lshift_n(X, 1), self.lshift_n(n, 1)))
-            X = new_X
-        return (X)
-
-    def sub_n_mba(self, X, n):
-        null = Vector(self.nbits)
-        n = self.get_vector_from_cst(n)
-        while (n != null):
-            X = simplify_inplace(self.xor_Y(X, n))
-            n = simplify_inplace(self.and_Y(self.lshift_n(X, 1), self.lshift_n(n, 1)))
-        return (X)
+        return self._mba.add_n(X, n & self.max_uint)
 
     def iadd_n(self, X, n):
-        n = n & self.max_uint
-        if self.use_esf:
-            return self.iadd_Y(X, self.get_vector_from_cst(n))
-        return self.iadd_n_mba(X, n)
-
-    def iadd_n_mba(self, X, n):
-        null = Vector(self.nbits)
-        n = self.get_vector_from_cst(n)
-        while (n != null):
-            carry = simplify_inplace(self.and_Y(X, n))
-            self.ixor_Y(X, n)
-            simplify_inplace(X)
-            n     = self.lshift_n(carry, 1)
+        self._mba.iadd_n(X, n & self.max_uint)
         return X
 
     def iadd_lshifted_Y(self, X, Y, offset):
-        if self.use_esf:
-            self.iadd_Y(X, self.lshift_n(Y, offset))
-            simplify_inplace(X)
-            return
-        carry = imm(0)
-        for i in range(0, self.nbits):
-            if i < offset:
-                Yi = imm(0)
-            else:
-                Yi = Y[i-offset]
-            Xi = X[i]
-            mul_XY = simplify_inplace(Xi*Yi)
-            Xi += Yi
-            simplify_inplace(Xi)
-            carry_new = simplify_inplace(mul_XY + (carry * Xi))
-            Xi += carry
-            simplify_inplace(Xi)
-            carry = carry_new
+        self._mba.iadd_lshifted_Y(X, Y, offset)
+        return X
 
     def sub_Y(self, X, Y):
-        carry = imm(0)
-        ret = Vector(self.nbits)
-        if self.use_esf:
-            for i in range(0, self.nbits):
-                ret[i] = simplify_inplace(X[i]+Y[i]+carry)
-                carry = esf(2, [X[i]+imm(1), Y[i], carry])
-        else:
-            for i in range(0, self.nbits):
-                sum_XY = simplify_inplace(X[i]+Y[i])
-                ret[i] = simplify_inplace(sum_XY+carry)
-                carry = simplify_inplace((X[i]+imm(1))*Y[i] + (carry * (sum_XY+imm(1))))
-        return ret
+        return self._mba.sub_Y(X, Y)
 
     def sub_n(self, X, n):
-        n = n & self.max_uint
-        return self.sub_Y(X, self.get_vector_from_cst(n))
+        return self._mba.sub_n(X, n & self.max_uint)
 
     def mul_Y(self, X, Y):
-        ret = Vector(self.nbits)
-        i = 0
-        for i in range(0, self.nbits):
-            Yi_vec = Vector(self.nbits, Y[i])
-            self.iadd_Y(ret, self.lshift_n(X, i) * Yi_vec)
-        return ret
-
-    def mul_n_org(self, X, n):
-        n = n & self.max_uint
-        ret = Vector(self.nbits)
-        i = 0
-        while n > 0:
-            if (n & 1) == 1:
-                self.iadd_lshifted_Y(ret, X, i)
-            n >>= 1
-            i += 1
-        return ret
+        return self._mba.mul_Y(X, Y)
 
     def mul_n(self, X, n):
-        if (n == 1):
-            return X
-        ret = Vector(self.nbits)
-        if (n == 0):
-            return ret
-        n = n & self.max_uint
-        i = 0
-        final_sum = 0
-        not_x = None
-        def compute_not_x(not_x):
-            if not_x is None:
-                not_x = self.not_X(X)
-            return not_x
-
-        while n > 0:
-            # Optimisations from the Hacker's delight
-            nz = next_zero_bit(n)
-            if (nz >= 3):
-                not_x = compute_not_x(not_x)
-                self.iadd_lshifted_Y(ret, X, nz+i)
-                self.iadd_lshifted_Y(ret, not_x, i)
-                final_sum += 1<<i
-                n >>= nz
-                i += nz
-            else:
-                bits4 = n&0b1111
-                if bits4 == 0b1011:
-                    not_x = compute_not_x(not_x)
-                    self.iadd_lshifted_Y(ret, X, 4+i)
-                    self.iadd_lshifted_Y(ret, not_x, 2+i)
-                    self.iadd_lshifted_Y(ret, not_x, i)
-                    final_sum += 1<<(i+2)
-                    final_sum += 1<<i
-                    n >>= 4
-                    i += 4
-                elif bits4 == 0b1101:
-                    not_x = compute_not_x(not_x)
-                    self.iadd_lshifted_Y(ret, X, 4+i)
-                    self.iadd_lshifted_Y(ret, not_x, 1+i)
-                    self.iadd_lshifted_Y(ret, not_x, i)
-                    final_sum += 1<<(i+1)
-                    final_sum += 1<<i
-                    n >>= 4
-                    i += 4
-                else:
-                    if (n & 1) == 1:
-                        self.iadd_lshifted_Y(ret, X, i)
-                    n >>= 1
-                    i += 1
-        if final_sum > 0:
-            self.iadd_n(ret, final_sum & self.max_uint)
-        return ret
+        return self._mba.mul_n(X, n & self.max_uint)
 
     def div_n(self, X, n):
-        ret = Vector(self.nbits*2+1)
-        for i in range(self.nbits):
-            ret[i] = X[i]
-        nc = (2**self.nbits/n)*n - 1
-        for p in range(self.nbits, 2*self.nbits+1):
-            if(2**p > nc*(n - 1 - ((2**p - 1) % n))):
-                break
-        else:
-            raise RuntimeError("division: unable to find the shifting count")
-        m = (2**p + n - 1 - ((2**p - 1) % n))//n
-        self.__set_nbits(2*self.nbits+1)
-        ret = self.mul_n(ret, m)
-        ret = self.rshift_n(ret, p)
-        self.__set_nbits((self.nbits - 1)//2)
-        final_ret = Vector(self.nbits)
-        for i in range(self.nbits):
-            final_ret[i] = ret[i]
-        return final_ret
+        return self._mba.div_n(X, n)
 
     def phi_X(self, X):
         def f(i, j):
@@ -359,31 +182,16 @@ class MBAImpl(object):
         #return self.phi_X(Y)*X
 
     def and_n(self, X, n):
-        if n < 0:
-            n = n & self.max_uint
-        ret = Vector(self.nbits)
-        for i in range(self.nbits):
-            if n & (1<<i):
-                ret[i] = X[i]
-        return ret
-        #return self.phi_X(self.get_vector_from_cst(n))*X
+        return self._mba.and_n(X, n & self.max_uint)
 
     def and_exp(self, X, e):
         return X*e
 
     def not_X(self, X):
-        return X + self.get_vector_from_cst(self.max_uint)
+        return self._mba.not_X(X)
 
     def xor_n(self, X, n):
-        if n < 0:
-            n = n % self
-        ret = Vector(self.nbits)
-        for i in range(self.nbits):
-            if n & (1 << i):
-                ret[i] = X[i] + imm(1)
-            else:
-                ret[i] = X[i]
-        return ret
+        return self._mba.xor_n(X, n & self.max_uint)
 
     def xor_exp(self, X, e):
         return X+e
@@ -398,7 +206,7 @@ class MBAImpl(object):
         X += e
 
     def oppose_X(self, X):
-        return self.add_n(self.not_X(X), 1)
+        return self._mba.oppose_X(X)
 
     def notand_n(self, X, n):
         return self.not_X(self.and_n(X, n))
@@ -410,10 +218,7 @@ class MBAImpl(object):
         return self.not_exp(self.and_exp(X, e))
 
     def or_Y(self, X, Y):
-        if self.use_esf:
-            return esf_vector(2, [X, Y]) + esf_vector(1, [X, Y])
-        else:
-            return self.xor_Y(self.and_Y(X, Y), self.xor_Y(X, Y))
+        return self._mba.or_Y(X, Y)
 
     def or_exp(self, X, e):
         if self.use_esf:
@@ -423,27 +228,16 @@ class MBAImpl(object):
             return self.xor_exp(self.and_exp(X, e), self.xor_exp(X, e))
 
     def or_n(self, X, n):
-        ret = Vector(self.nbits)
-        for i in range(self.nbits):
-            if n & (1<<i):
-                ret[i] = imm(1)
-            else:
-                ret[i] = X[i]
-        return ret
+        return self._mba.or_n(X, n & self.max_uint)
 
     def lshift_n(self, X, n):
-        return X>>n
+        return self._mba.lshift_n(X, n)
 
     def rshift_n(self, X, n):
-        return X<<n
+        return self._mba.rshift_n(X, n)
 
     def arshift_n(self, X, n):
-        n = min(n, self.nbits)
-        ret = X<<n
-        last_bit = X[self.nbits-1]
-        for i in range(self.nbits-n, self.nbits):
-            ret[i] = last_bit
-        return ret
+        return self._mba.arshift_n(X, n)
 
     def rshift_Y(self, X, Y):
         # Generate 2**Y and multiply X by this
@@ -453,16 +247,10 @@ class MBAImpl(object):
     def rol_n(self, X, n):
         # rol(0b(d b c a), 1) = 0b(b c a d)
         # rol(vec(a,b,c,d), 1) = vec(d,a,c,b))
-        ret = Vector(self.nbits)
-        for i in range(self.nbits):
-            ret[i] = X[(i-n)%self.nbits]
-        return ret
+        return self._mba.rol_n(X, n)
 
     def ror_n(self, X, n):
-        ret = Vector(self.nbits)
-        for i in range(self.nbits):
-            ret[i] = X[(i+n)%self.nbits]
-        return ret
+        return self._mba.ror_n(X, n)
 
     def evaluate(self, E, values):
         return evaluate_expr(E, self.nbits, values)
@@ -29,7 +29,7 @@ from six.moves import range
 import networkx as nx
 import collections, itertools
 
-from pytanque import Vector, subs_exprs, SymbolsSet, SymbolsHist, esf
+from pytanque import Vector, subs_exprs, SymbolsSet, SymbolsHist, esf, analyses
 from arybo.lib import MBA, MBAVariable, expand_esf, simplify, simplify_inplace, expand_esf_inplace
 
 try:
@@ -192,13 +192,9 @@ def find_esfs_degree(e, d):
     return esfs
 
 def find_esfs(e):
-    esfs = []
-    max_degree = e.anf_esf_max_degree()
-    #print("max_degree: %d" % max_degree)
-    for d in reversed(range(2,max_degree+1)):
-        esfs.extend(find_esfs_degree(e,d))
-    for e_ in esfs: e += e_
-    return esfs
+    # Native version of find_esfs_degree for every degree, which also
+    # replaces in e the expansions of the ESFs found by the ESFs
+    return analyses.find_esfs(e)
 
 def solve_binomial(k, v):
     # Find the biggest N such as (N,k) <= v by bruteforce
@@ -8,4 +8,8 @@
 #define PA_USE_TBB
 #endif
 
+#if 1
+#define PA_SIMPS_STATS
+#endif
+
 #endif
@@ -1,8 +1,20 @@
+#include <pa/anf.h>
+#include <pa/arena.h>
+#include <pa/bitmatrix.h>
+#include <pa/bitsliced.h>
+#include <pa/budget.h>
+#include <pa/errors.h>
 #include <pa/exprs.h>
+#include <pa/expr_pool.h>
+#include <pa/jit.h>
 #include <pa/matrix.h>
+#include <pa/mba.h>
 #include <pa/vector.h>
+#include <pa/vector_view.h>
 #include <pa/prettyprinter.h>
+#include <pa/serialize.h>
 #include <pa/simps.h>
+#include <pa/sparse_matrix.h>
 #include <pa/subs.h>
 #include <pa/analyses.h>
 #include <pa/syms_set.h>
@@ -14,6 +26,7 @@
 #include <pybind11/stl.h>
 
 #include <sstream>
+#include <stdexcept>
 
 namespace py = pybind11;
 
@@ -133,25 +146,52 @@ static void vector_set(pa::Vector& v, const size_t i, pa::Expr const& e)
 	v[i] = e;
 }
 
-static pa::Vector vector_slice(pa::Vector const& v, py::slice const& s)
+static pa::VectorView view_slice(pa::Vector const& v, py::slice const& s)
 {
 	size_t start, stop, step;
 	size_t slicelength;
 	if (!s.compute(v.size(), &start, &stop, &step, &slicelength))
 		throw py::error_already_set();
+	return pa::VectorView::slice(v, start, slicelength, (ptrdiff_t)step);
+}
 
-	pa::Vector ret;
-	auto& ret_storage = ret.args();
-	ret_storage.reserve(slicelength);
-	auto it = v.begin();
-	auto end = v.begin();
-	std::advance(it, start);
-	std::advance(end, stop);
-	while (it != end) {
-		ret_storage.emplace_back(*it);
-		std::advance(it, step);
-	}
-	return ret;
+static pa::Vector vector_slice(pa::Vector const& v, py::slice const& s)
+{
+	return view_slice(v, s).to_vector();
+}
+
+static void vector_view_construct(pa::Vector& v, pa::VectorView const& view)
+{
+	new (&v) pa::Vector{view.to_vector()};
+}
+
+static pa::Expr const& vector_view_at(pa::VectorView const& v, const size_t i)
+{
+	if (i >= v.size())
+		throw py::index_error();
+	return v.at(i);
+}
+
+pa::Vector (pa::VectorView::*vector_view_mul_vector)(pa::Vector const&) const = &pa::VectorView::operator*;
+pa::Vector (pa::VectorView::*vector_view_mul_expr)(pa::Expr const&) const = &pa::VectorView::operator*;
+
+static void vector_view_set(pa::VectorView& v, const size_t i, pa::Expr const& e)
+{
+	if (i >= v.size())
+		throw py::index_error();
+	v[i] = e;
+}
+
+static py::iterator vector_view_iter(pa::VectorView const& v)
+{
+	// Iterate over a copy, so that writes to the view during the iteration
+	// do not invalidate the iterator.
+	return py::iter(py::cast(v.to_vector()));
+}
+
+static std::string vector_view_str(pa::VectorView const& v)
+{
+	return vector_str(v.to_vector());
 }
 
 struct VectorNotImmediate: public std::exception
@@ -183,11 +223,6 @@ pa::Expr& (pa::Matrix::*matrix_at)(const size_t, const size_t) = &pa::Matrix::at
 pa::Matrix (pa::Matrix::*matrix_mul_matrix)(pa::Matrix const&) const = &pa::Matrix::operator*;
 pa::Vector (pa::Matrix::*matrix_mul_vector)(pa::Vector const&) const = &pa::Matrix::operator*;
 
-static std::shared_ptr<pa::Matrix> matrix_identity(const size_t n)
-{
-	return std::make_shared<pa::Matrix>(pa::Matrix::identity(n));
-}
-
 void matrix_construct(pa::Matrix* self, const size_t nlines, const size_t ncols, py::object& f)
 {
 	new (self) pa::Matrix{pa::Matrix::construct(nlines, ncols,
@@ -204,28 +239,126 @@ static std::string matrix_str(pa::Matrix const& m)
 	return ss.str();
 }
 
-pa::Expr& (*simp_exp)(pa::Expr&) =   &pa::simps::simplify;
-pa::Vector& (*simp_vec)(pa::Vector&) = &pa::simps::simplify;
-pa::Matrix& (*simp_mat)(pa::Matrix&) = &pa::simps::simplify;
+// Builds a SparseMatrix if at most a quarter of the entries returned by f are
+// non zero, and a Matrix otherwise
+static py::object matrix_auto(const size_t nlines, const size_t ncols, py::object& f)
+{
+	pa::Matrix ret = pa::Matrix::construct(nlines, ncols,
+		[&f] (const size_t i, const size_t j) -> pa::Expr
+		{
+			return *f(i, j).cast<pa::Expr const*>();
+		});
+	size_t nnz = 0;
+	for (pa::Expr const& e: ret) {
+		nnz += !(e.is_imm() && !e.as<pa::ExprImm>().value());
+	}
+	if (nnz*4 <= ret.nelts()) {
+		return py::cast(pa::SparseMatrix{ret});
+	}
+	return py::cast(std::move(ret));
+}
+
+static std::string sparse_matrix_str(pa::SparseMatrix const& m)
+{
+	return matrix_str(m.to_matrix());
+}
+
+pa::SparseMatrix (pa::SparseMatrix::*sparse_matrix_mul)(pa::SparseMatrix const&) const = &pa::SparseMatrix::operator*;
+pa::Vector (pa::SparseMatrix::*sparse_matrix_mul_vector)(pa::Vector const&) const = &pa::SparseMatrix::operator*;
+
+static py::object bitmatrix_from_matrix(pa::Matrix const& m)
+{
+	pa::BitMatrix ret;
+	if (!pa::BitMatrix::from_matrix(m, ret)) {
+		return py::none();
+	}
+	return py::cast(std::move(ret));
+}
+
+static py::object bitmatrix_solve(pa::BitMatrix const& m, pa::BitMatrix const& B)
+{
+	pa::BitMatrix X;
+	if (!m.solve(B, X)) {
+		return py::none();
+	}
+	return py::cast(std::move(X));
+}
+
+static py::tuple vectorial_decomp_bits(pa::Vector const& symbols, pa::Vector const& v)
+{
+	pa::analyses::VectorialDecomp ret = pa::analyses::vectorial_decomp_bits(symbols, v);
+	return py::make_tuple(std::move(ret.matrix), std::move(ret.cst), std::move(ret.nl));
+}
+
+pa::BitMatrix (pa::BitMatrix::*bitmatrix_mul)(pa::BitMatrix const&) const = &pa::BitMatrix::operator*;
+pa::Vector (pa::BitMatrix::*bitmatrix_mul_vector)(pa::Vector const&) const = &pa::BitMatrix::operator*;
+
+// Expr.args() returns a reference to the arguments of an expression, through
+// which they can be modified without clearing the normalized flag of their
+// parents. Clears it on every expression that has a modified sub-expression,
+// so that the next simplification doesn't skip them. Returns whether e
+// needs to be simplified again.
+static bool clear_stale_normalized(pa::Expr& e)
+{
+	if (!e.has_args()) {
+		return false;
+	}
+	const bool normalized = e.is_normalized();
+	bool stale = !normalized;
+	for (pa::Expr& a: e.args()) {
+		stale |= clear_stale_normalized(a);
+	}
+	// The non-const access to the arguments above cleared the flag
+	if (!stale) {
+		e.set_normalized();
+	}
+	return stale;
+}
+
+template <class V>
+static void clear_stale_normalized_all(V& v)
+{
+	for (pa::Expr& e: v) {
+		clear_stale_normalized(e);
+	}
+}
+
+static pa::Expr& simp_exp(pa::Expr& e)
+{
+	clear_stale_normalized(e);
+	return pa::simps::simplify(e);
+}
+
+static pa::Vector& simp_vec(pa::Vector& v)
+{
+	clear_stale_normalized_all(v);
+	return pa::simps::simplify(v);
+}
+
+static pa::Matrix& simp_mat(pa::Matrix& m)
+{
+	clear_stale_normalized_all(m);
+	return pa::simps::simplify(m);
+}
 
 static pa::Expr simp_exp_copy(pa::Expr const& e)
 {
 	pa::Expr ret = e;
-	pa::simps::simplify(ret);
+	simp_exp(ret);
 	return ret;
 }
 
 static pa::Vector simp_vec_copy(pa::Vector const& v)
 {
 	pa::Vector ret = v;
-	pa::simps::simplify(ret);
+	simp_vec(ret);
 	return ret;
 }
 
 static pa::Matrix simp_mat_copy(pa::Matrix const& m)
 {
 	pa::Matrix ret = m;
-	pa::simps::simplify(ret);
+	simp_mat(ret);
 	return ret;
 }
 
@@ -467,7 +600,7 @@ static pa::Expr expr_eval(pa::Expr const& e, std::map<pa::Expr, pa::Expr> const&
 {
 	pa::Expr ret = e;
 	subs_exprs(ret, map);
-  pa::simps::simplify(ret);
+  simp_exp(ret);
 	return ret;
 }
 
@@ -530,6 +663,73 @@ static pa::Vector expand_esf_vec(pa::Vector& v)
 	return ret;
 }
 
+static py::dict simplify_caches_stats()
+{
+	py::dict ret;
+	for (pa::simps::CacheStats const& s: pa::simps::caches_stats()) {
+		py::dict stats;
+		stats["hits"] = s.hits;
+		stats["misses"] = s.misses;
+		stats["evictions"] = s.evictions;
+		stats["size"] = s.size;
+		ret[s.name] = stats;
+	}
+	return ret;
+}
+
+static py::dict simplify_rules_stats()
+{
+	py::dict ret;
+	for (pa::simps::RuleStats const& s: pa::simps::rules_stats()) {
+		py::dict stats;
+		stats["attempts"] = s.attempts;
+		stats["rewrites"] = s.rewrites;
+		stats["time_ns"] = s.time_ns;
+		stats["args_before"] = s.args_before;
+		stats["args_after"] = s.args_after;
+		stats["max_args"] = s.max_args;
+		ret[s.name] = stats;
+	}
+	return ret;
+}
+
+// Python context manager around pa::BudgetScope. The budget object is kept
+// alive by the context manager, as long as it is used by the simplifications.
+class PyBudgetScope
+{
+public:
+	PyBudgetScope(py::object budget):
+		_budget(budget)
+	{ }
+
+	PyBudgetScope& enter()
+	{
+		if (_scope) {
+			throw std::runtime_error("budget scope already entered");
+		}
+		_scope.reset(new pa::BudgetScope{_budget.is_none() ? nullptr : _budget.cast<pa::Budget*>()});
+		return *this;
+	}
+
+	void exit(py::args)
+	{
+		_scope.reset();
+	}
+
+private:
+	std::unique_ptr<pa::BudgetScope> _scope;
+	py::object _budget;
+};
+
+static pa::Expr anf_via_truth_table(pa::Expr const& e, size_t max_symbols)
+{
+	pa::ANF ret;
+	if (!pa::ANF::from_expr_truth_table(e, ret, max_symbols)) {
+		throw std::invalid_argument("expression depends on too many symbols");
+	}
+	return ret.to_expr();
+}
+
 static void or_to_esf_inplace(pa::Expr& e)
 {
 	pa::simps::or_to_esf(e);
@@ -623,6 +823,262 @@ static pa::SymbolsHist::count_type syms_hist_value_count(pa::SymbolsHist::const_
 bool (pa::SymbolsHist::*syms_hist_compute)(pa::Expr const&) = &pa::SymbolsHist::compute;
 bool (pa::SymbolsHist::*syms_hist_compute_args_mul)(pa::Expr const&, unsigned) = &pa::SymbolsHist::compute;
 
+// Handle on an interned expression, that keeps its pool alive
+struct PyExprRef
+{
+	std::shared_ptr<pa::ExprPool> pool;
+	pa::ExprRef ref;
+};
+
+static PyExprRef expr_pool_intern(std::shared_ptr<pa::ExprPool> const& pool, pa::Expr const& e)
+{
+	return PyExprRef{pool, pool->intern(e)};
+}
+
+static std::vector<PyExprRef> expr_pool_intern_vec(std::shared_ptr<pa::ExprPool> const& pool, pa::Vector const& v)
+{
+	std::vector<PyExprRef> ret;
+	ret.reserve(v.size());
+	for (pa::Expr const& e: v) {
+		ret.emplace_back(PyExprRef{pool, pool->intern(e)});
+	}
+	return ret;
+}
+
+static pa::Vector expr_pool_to_vector(std::vector<PyExprRef> const& refs)
+{
+	std::vector<pa::ExprRef> v;
+	v.reserve(refs.size());
+	for (PyExprRef const& r: refs) {
+		v.push_back(r.ref);
+	}
+	return pa::ExprPool::to_vector(v);
+}
+
+static pa::Expr expr_ref_expr(PyExprRef const& r)
+{
+	return pa::ExprPool::to_expr(r.ref);
+}
+
+static std::string expr_ref_str(PyExprRef const& r)
+{
+	return expr_str(pa::ExprPool::to_expr(r.ref));
+}
+
+static std::vector<PyExprRef> expr_ref_args(PyExprRef const& r)
+{
+	std::vector<PyExprRef> ret;
+	ret.reserve(r.ref->nargs());
+	for (pa::ExprRef const& a: r.ref->args()) {
+		ret.emplace_back(PyExprRef{r.pool, a});
+	}
+	return ret;
+}
+
+static void check_same_pool(PyExprRef const& a, PyExprRef const& b)
+{
+	if (a.pool != b.pool) {
+		throw std::invalid_argument("expressions come from different pools");
+	}
+}
+
+static PyExprRef expr_ref_add(PyExprRef const& a, PyExprRef const& b)
+{
+	check_same_pool(a, b);
+	return PyExprRef{a.pool, a.ref + b.ref};
+}
+
+static PyExprRef expr_ref_mul(PyExprRef const& a, PyExprRef const& b)
+{
+	check_same_pool(a, b);
+	return PyExprRef{a.pool, a.ref * b.ref};
+}
+
+static PyExprRef expr_ref_or(PyExprRef const& a, PyExprRef const& b)
+{
+	check_same_pool(a, b);
+	return PyExprRef{a.pool, a.ref | b.ref};
+}
+
+static bool expr_ref_eq(PyExprRef const& a, PyExprRef const& b)
+{
+	return a.ref == b.ref;
+}
+
+static bool expr_ref_neq(PyExprRef const& a, PyExprRef const& b)
+{
+	return a.ref != b.ref;
+}
+
+static uint64_t expr_ref_hash(PyExprRef const& r)
+{
+	return r.ref.hash();
+}
+
+static pa::expr_type_id expr_ref_type(PyExprRef const& r)
+{
+	return r.ref->type();
+}
+
+// Python context manager around pa::ArenaScope
+class PyArenaScope
+{
+public:
+	PyArenaScope(size_t chunk_size):
+		_chunk_size(chunk_size)
+	{ }
+
+	PyArenaScope& enter()
+	{
+		if (_scope) {
+			throw std::runtime_error("arena scope already entered");
+		}
+		_scope.reset(new pa::ArenaScope{_chunk_size});
+		return *this;
+	}
+
+	void exit(py::args)
+	{
+		_scope.reset();
+	}
+
+	size_t bytes_allocated() const
+	{
+		return _scope ? _scope->bytes_allocated() : 0;
+	}
+
+private:
+	std::unique_ptr<pa::ArenaScope> _scope;
+	size_t _chunk_size;
+};
+
+// Conversions between Python integers and rows of words, bit i of an integer
+// being the bit i of the row
+static void py_int_to_row(py::object v, pa::BitslicedEvaluator::word_type* row, size_t row_words)
+{
+	typedef pa::BitslicedEvaluator::word_type word_type;
+	const py::int_ word_mask(~word_type{0});
+	const py::int_ word_shift(pa::BitslicedEvaluator::word_bits);
+	for (size_t w = 0; w < row_words; w++) {
+		row[w] = (v & word_mask).cast<word_type>();
+		v = v >> word_shift;
+	}
+}
+
+static py::object py_int_from_row(pa::BitslicedEvaluator::word_type const* row, size_t row_words)
+{
+	const py::int_ word_shift(pa::BitslicedEvaluator::word_bits);
+	py::object ret = py::int_(0);
+	for (size_t w = row_words; w > 0; w--) {
+		ret = (ret << word_shift) | py::int_(row[w-1]);
+	}
+	return ret;
+}
+
+// Converts a non-negative Python integer of any size to a pa::MBA::Constant
+static pa::MBA::Constant mba_constant(py::int_ const& n)
+{
+	if (n < py::int_(0)) {
+		throw py::value_error("expected a non-negative integer");
+	}
+	const size_t nbits = n.attr("bit_length")().cast<size_t>();
+	pa::MBA::Constant ret((nbits+63)/64);
+	py_int_to_row(n, ret.data(), ret.size());
+	return ret;
+}
+
+// MBA operations taking a constant, which is converted before releasing the
+// GIL
+template <pa::Vector (pa::MBA::*F)(pa::Vector const&, pa::MBA::Constant const&) const>
+static pa::Vector mba_op_n(pa::MBA const& mba, pa::Vector const& X, py::int_ const& n)
+{
+	const pa::MBA::Constant N = mba_constant(n);
+	py::gil_scoped_release release;
+	return (mba.*F)(X, N);
+}
+
+static void mba_iadd_n(pa::MBA const& mba, pa::Vector& X, py::int_ const& n)
+{
+	const pa::MBA::Constant N = mba_constant(n);
+	py::gil_scoped_release release;
+	mba.iadd_n(X, N);
+}
+
+static pa::Vector mba_cst(pa::MBA const& mba, py::int_ const& n)
+{
+	return mba.cst(mba_constant(n));
+}
+
+// Evaluates f (a BitslicedEvaluator or a JitFunction) on a list of Python
+// integers, bit i of each integer being the value of input i. Returns the
+// outputs with the same encoding.
+template <class F>
+static py::list batch_eval(F const& f, py::list const& values)
+{
+	typedef pa::BitslicedEvaluator::word_type word_type;
+	const size_t in_row = f.input_row_words();
+	const size_t out_row = f.output_row_words();
+
+	const size_t n = py::len(values);
+	std::vector<word_type> in(n*in_row);
+	for (size_t i = 0; i < n; i++) {
+		py_int_to_row(values[i], &in[i*in_row], in_row);
+	}
+	std::vector<word_type> out(n*out_row);
+	f.eval(in.data(), out.data(), n);
+
+	py::list ret(n);
+	for (size_t i = 0; i < n; i++) {
+		ret[i] = py_int_from_row(&out[i*out_row], out_row);
+	}
+	return ret;
+}
+
+static py::object jit_call(pa::JitFunction const& f, py::object const& v)
+{
+	std::vector<pa::JitFunction::word_type> in(f.input_row_words());
+	std::vector<pa::JitFunction::word_type> out(f.output_row_words());
+	py_int_to_row(v, in.data(), in.size());
+	f(in.data(), out.data());
+	return py_int_from_row(out.data(), out.size());
+}
+
+// pybind11 holders can't be shared pointers to const objects
+static std::shared_ptr<pa::JitFunction> jit_compile_vec(pa::Vector const& outputs, pa::Vector const& inputs)
+{
+	return std::const_pointer_cast<pa::JitFunction>(pa::jit_compile(outputs, inputs));
+}
+
+static std::shared_ptr<pa::JitFunction> jit_compile_app(pa::App const& app)
+{
+	return std::const_pointer_cast<pa::JitFunction>(pa::jit_compile(app));
+}
+
+void (*save_exp)(std::string const&, pa::Expr const&) = &pa::serialize::save<pa::Expr>;
+void (*save_vec)(std::string const&, pa::Vector const&) = &pa::serialize::save<pa::Vector>;
+void (*save_mat)(std::string const&, pa::Matrix const&) = &pa::serialize::save<pa::Matrix>;
+void (*save_affapp)(std::string const&, pa::AffApp const&) = &pa::serialize::save<pa::AffApp>;
+void (*save_app)(std::string const&, pa::App const&) = &pa::serialize::save<pa::App>;
+
+// Loads the object saved in path, whatever its type
+static py::object serialize_load(std::string const& path)
+{
+	pa::serialize::Reader r(path);
+	switch (r.kind()) {
+		case pa::serialize::Kind::Expr:
+			return py::cast(r.to_expr());
+		case pa::serialize::Kind::Vector:
+			return py::cast(r.to_vector());
+		case pa::serialize::Kind::Matrix:
+			return py::cast(r.to_matrix());
+		case pa::serialize::Kind::AffApp:
+			return py::cast(r.to_affapp());
+		case pa::serialize::Kind::App:
+			return py::cast(r.to_app());
+	};
+	throw pa::errors::InvalidFormat{};
+}
+
 template <class T>
 auto py_iterator()
 {
@@ -727,8 +1183,33 @@ PYBIND11_MODULE(pytanque, m)
 		.def("__rshift__", vector_rshift)
 		.def("__eq__", &pa::Vector::operator==)
 		.def("__ne__", &pa::Vector::operator!=)
+		.def("__init__", vector_view_construct)
 		;
 
+	py::class_<pa::VectorView>(m, "VectorView", "Represents a view of a Vector, whose elements are copied on the first write. The viewed vector must not be modified while the view is used.")
+		.def(py::init<pa::Vector const&>(), py::keep_alive<1,2>())
+		.def_static("shift_left", &pa::VectorView::shift_left, py::arg("v"), py::arg("n"), py::arg("fill") = pa::Expr{pa::ExprImm(0)}, py::keep_alive<0,1>())
+		.def_static("shift_right", &pa::VectorView::shift_right, py::arg("v"), py::arg("n"), py::arg("fill") = pa::Expr{pa::ExprImm(0)}, py::keep_alive<0,1>())
+		.def_static("rotate_left", &pa::VectorView::rotate_left, py::keep_alive<0,1>())
+		.def_static("rotate_right", &pa::VectorView::rotate_right, py::keep_alive<0,1>())
+		.def_static("extend", &pa::VectorView::extend, py::arg("v"), py::arg("n"), py::arg("fill") = pa::Expr{pa::ExprImm(0)}, py::keep_alive<0,1>())
+		.def_static("slice", view_slice, py::keep_alive<0,1>())
+		.def("size", &pa::VectorView::size)
+		.def("copied", &pa::VectorView::copied)
+		.def("to_vector", &pa::VectorView::to_vector)
+		.def("__getitem__", vector_view_at, py::return_value_policy::copy)
+		.def("__setitem__", vector_view_set)
+		.def("__iter__", vector_view_iter)
+		.def("__len__", &pa::VectorView::size)
+		.def("__repr__", vector_view_str)
+		.def("__add__", &pa::VectorView::operator+)
+		.def("__mul__", vector_view_mul_vector)
+		.def("__mul__", vector_view_mul_expr)
+		.def("__eq__", &pa::VectorView::operator==)
+		.def("__ne__", &pa::VectorView::operator!=)
+		;
+	py::implicitly_convertible<pa::VectorView, pa::Vector>();
+
 	py::class_<pa::Matrix>(m, "Matrix", "Represents a matrix of Expr objects")
 		.def(py::init<const size_t, const size_t>())
 		.def(py::init<const size_t, const size_t, pa::Expr const&>())
@@ -742,13 +1223,52 @@ PYBIND11_MODULE(pytanque, m)
 		.def(py::self += py::self)
 		.def(py::self * py::self)
 		.def(py::self * pa::Vector{})
-		.def("identity", matrix_identity)
+		.def_static("identity", &pa::Matrix::identity)
 		.def("__iter__", py_iterator<pa::Matrix>(), py::keep_alive<0,1>())
 		.def("__repr__", matrix_str)
 		.def("__eq__", &pa::Matrix::operator==)
 		.def("__ne__", &pa::Matrix::operator!=)
 		;
 
+	py::class_<pa::SparseMatrix>(m, "SparseMatrix", "Represents a matrix of Expr objects that only stores its non zero entries")
+		.def(py::init<const size_t, const size_t>())
+		.def(py::init<pa::Matrix const&>())
+		.def_static("identity", &pa::SparseMatrix::identity)
+		.def("to_matrix", &pa::SparseMatrix::to_matrix)
+		.def("nlines", &pa::SparseMatrix::nlines)
+		.def("ncols", &pa::SparseMatrix::ncols)
+		.def("nnz", &pa::SparseMatrix::nnz)
+		.def("at", &pa::SparseMatrix::at)
+		.def(py::self + py::self)
+		.def("__mul__", sparse_matrix_mul)
+		.def("__mul__", sparse_matrix_mul_vector)
+		.def("__repr__", sparse_matrix_str)
+		.def("__eq__", &pa::SparseMatrix::operator==)
+		.def("__ne__", &pa::SparseMatrix::operator!=)
+		;
+	m.def("matrix", matrix_auto,
+		"Builds a matrix from f(i, j), as a SparseMatrix if most of its entries are zero, and as a Matrix otherwise");
+
+	py::class_<pa::BitMatrix>(m, "BitMatrix", "Represents a bit-packed matrix over GF(2)")
+		.def(py::init<const size_t, const size_t>())
+		.def("nlines", &pa::BitMatrix::nlines)
+		.def("ncols", &pa::BitMatrix::ncols)
+		.def("at", (bool (pa::BitMatrix::*)(const size_t, const size_t) const) &pa::BitMatrix::at)
+		.def("set", &pa::BitMatrix::set)
+		.def("rank", &pa::BitMatrix::rank)
+		.def("inverse", &pa::BitMatrix::inverse, "Inverse of the matrix, or an empty matrix if it isn't invertible")
+		.def("solve", bitmatrix_solve, "Finds X such that self*X = B, or returns None if there isn't any")
+		.def_static("identity", &pa::BitMatrix::identity)
+		.def_static("from_matrix", bitmatrix_from_matrix, "Converts a Matrix of immediates, or returns None")
+		.def("to_matrix", &pa::BitMatrix::to_matrix)
+		.def(py::self + py::self)
+		.def(py::self += py::self)
+		.def("__mul__", bitmatrix_mul)
+		.def("__mul__", bitmatrix_mul_vector)
+		.def("__eq__", &pa::BitMatrix::operator==)
+		.def("__ne__", &pa::BitMatrix::operator!=)
+		;
+
 	py::class_<pa::AffApp>(m, "AffApp", "Represents an affine application")
 		.def(py::init<pa::Matrix const&, pa::Vector const&>())
 		.def("__call__", &pa::AffApp::operator())
@@ -776,6 +1296,72 @@ PYBIND11_MODULE(pytanque, m)
 		.def("__repr__", app_str)
 		;
 
+	py::class_<pa::BitslicedEvaluator>(m, "BitslicedEvaluator",
+		"Compiled form of a vector of expressions or of an App object, that\
+		evaluates it on many concrete inputs at once")
+		.def(py::init<pa::Vector const&, pa::Vector const&>(), py::arg("outputs"), py::arg("inputs"))
+		.def(py::init<pa::App const&>())
+		.def("ninputs", &pa::BitslicedEvaluator::ninputs)
+		.def("noutputs", &pa::BitslicedEvaluator::noutputs)
+		.def("ninstructions", &pa::BitslicedEvaluator::ninstructions)
+		.def("eval", batch_eval<pa::BitslicedEvaluator>,
+			"Evaluates on a list of integers, bit i of each one being the value\
+			of input i. Returns the outputs as a list of integers.")
+		;
+
+	py::class_<pa::JitFunction, std::shared_ptr<pa::JitFunction>>(m, "JitFunction",
+		"Native code compiled from a vector of expressions or an App object")
+		.def("ninputs", &pa::JitFunction::ninputs)
+		.def("noutputs", &pa::JitFunction::noutputs)
+		.def("is_native", &pa::JitFunction::is_native)
+		.def("code_size", &pa::JitFunction::code_size)
+		.def("__call__", jit_call,
+			"Evaluates on an integer, bit i being the value of input i")
+		.def("eval", batch_eval<pa::JitFunction>,
+			"Evaluates on a list of integers, bit i of each one being the value\
+			of input i. Returns the outputs as a list of integers.")
+		;
+	m.def("jit_compile", jit_compile_vec, py::arg("outputs"), py::arg("inputs"));
+	m.def("jit_compile", jit_compile_app);
+	m.def("jit_cache_size", pa::jit_cache_size);
+	m.def("jit_cache_clear", pa::jit_cache_clear);
+
+	py::class_<pa::ExprPool, std::shared_ptr<pa::ExprPool>>(m, "ExprPool",
+		"Hash-consed expression store, where structurally equal\
+		subexpressions are only stored once")
+		.def(py::init<>())
+		.def("intern", expr_pool_intern)
+		.def("intern", expr_pool_intern_vec)
+		.def("to_vector", expr_pool_to_vector)
+		.def("size", &pa::ExprPool::size)
+		.def("__len__", &pa::ExprPool::size)
+		;
+
+	py::class_<PyExprRef>(m, "ExprRef", "Handle to an expression interned in an ExprPool")
+		.def("expr", expr_ref_expr, "Create a (deep) Expr object from this handle")
+		.def("args", expr_ref_args)
+		.def("type", expr_ref_type)
+		.def("__add__", expr_ref_add)
+		.def("__mul__", expr_ref_mul)
+		.def("__or__", expr_ref_or)
+		.def("__eq__", expr_ref_eq)
+		.def("__ne__", expr_ref_neq)
+		.def("__hash__", expr_ref_hash)
+		.def("__repr__", expr_ref_str)
+		;
+
+	py::class_<PyArenaScope>(m, "ArenaScope",
+		"Context manager that allocates expressions' arguments from an arena,\
+		released at once when the scope ends. Results that are kept should be\
+		exported.")
+		.def(py::init<size_t>(), py::arg("chunk_size") = pa::ArenaScope::default_chunk_size)
+		.def("__enter__", &PyArenaScope::enter, py::return_value_policy::reference_internal)
+		.def("__exit__", &PyArenaScope::exit)
+		.def("bytes_allocated", &PyArenaScope::bytes_allocated)
+		.def_static("export", pa::ArenaScope::export_expr)
+		.def_static("export", pa::ArenaScope::export_vector)
+		;
+
 	//py::class_<std::map<pa::Expr, pa::Expr>>(m, "map_exprs")
 	//	.def(py::map_indexing_suite<std::map<pa::Expr, pa::Expr>>())
 	//	;
@@ -813,13 +1399,82 @@ PYBIND11_MODULE(pytanque, m)
 	m.def("esf", esf);
 	m.def("esf_vector", esf_vector);
 
-	m.def("simplify_inplace", simp_exp, py::return_value_policy::reference_internal);
-	m.def("simplify_inplace", simp_vec, py::return_value_policy::reference_internal);
-	m.def("simplify_inplace", simp_mat, py::return_value_policy::reference_internal);
+	m.def("simplify_inplace", simp_exp, py::return_value_policy::reference_internal, py::call_guard<py::gil_scoped_release>());
+	m.def("simplify_inplace", simp_vec, py::return_value_policy::reference_internal, py::call_guard<py::gil_scoped_release>());
+	m.def("simplify_inplace", simp_mat, py::return_value_policy::reference_internal, py::call_guard<py::gil_scoped_release>());
+
+	m.def("simplify", simp_exp_copy, py::call_guard<py::gil_scoped_release>());
+	m.def("simplify", simp_vec_copy, py::call_guard<py::gil_scoped_release>());
+	m.def("simplify", simp_mat_copy, py::call_guard<py::gil_scoped_release>());
+
+	py::class_<pa::simps::Config>(m, "SimplifyConfig", "Global configuration of the simplification algorithms")
+		.def_readwrite("nthreads", &pa::simps::Config::nthreads)
+		.def_readwrite("grain_size", &pa::simps::Config::grain_size)
+		.def_readwrite("products_grain_size", &pa::simps::Config::products_grain_size)
+		.def_readwrite("truth_table_max_symbols", &pa::simps::Config::truth_table_max_symbols)
+		.def_readwrite("identify_ors_max_candidates", &pa::simps::Config::identify_ors_max_candidates)
+		.def_readwrite("cache_size", &pa::simps::Config::cache_size)
+		.def_readwrite("rules_stats", &pa::simps::Config::rules_stats)
+		;
+	m.def("simplify_config", &pa::simps::config, py::return_value_policy::reference);
 
-	m.def("simplify", simp_exp_copy);
-	m.def("simplify", simp_vec_copy);
-	m.def("simplify", simp_mat_copy);
+	py::class_<pa::Budget>(m, "Budget", "Resource limits of simplify and expand_esf, which raise BudgetExceeded when they are exceeded")
+		.def(py::init<>())
+		.def_property("max_nodes", &pa::Budget::max_nodes, &pa::Budget::set_max_nodes)
+		.def_property("max_monomials", &pa::Budget::max_monomials, &pa::Budget::set_max_monomials)
+		.def("set_timeout", &pa::Budget::set_timeout, "Sets the deadline to this number of seconds from now (0 removes it)")
+		.def("cancel", &pa::Budget::cancel, "Cancels the running computation (can be called from another thread)")
+		.def("cancelled", &pa::Budget::cancelled)
+		.def("nodes", &pa::Budget::nodes)
+		.def("monomials", &pa::Budget::monomials)
+		.def("reset", &pa::Budget::reset, "Resets the consumed resources and the cancellation")
+		;
+	py::class_<PyBudgetScope>(m, "BudgetScope",
+		"Context manager that makes the simplifications run by the current\
+		thread use a Budget (None removes the limits)")
+		.def(py::init<py::object>())
+		.def("__enter__", &PyBudgetScope::enter, py::return_value_policy::reference_internal)
+		.def("__exit__", &PyBudgetScope::exit)
+		;
+	py::register_exception<pa::errors::BudgetExceeded>(m, "BudgetExceeded");
+
+	py::class_<pa::MBA>(m, "MBA", "Word-level arithmetic over vectors of nbits boolean expressions. Constants are non-negative integers of any size, truncated to nbits bits.")
+		.def(py::init<const size_t>())
+		.def_property_readonly("nbits", &pa::MBA::nbits)
+		.def_property("use_esf", &pa::MBA::use_esf, &pa::MBA::set_use_esf)
+		.def_property("use_opt_mba", &pa::MBA::use_opt_mba, &pa::MBA::set_use_opt_mba)
+		.def("cst", mba_cst)
+		.def("var_symbols", &pa::MBA::var_symbols)
+		.def("add_Y", &pa::MBA::add_Y, py::call_guard<py::gil_scoped_release>())
+		.def("iadd_Y", &pa::MBA::iadd_Y, py::call_guard<py::gil_scoped_release>())
+		.def("add_n", mba_op_n<&pa::MBA::add_n>)
+		.def("iadd_n", mba_iadd_n)
+		.def("iadd_lshifted_Y", &pa::MBA::iadd_lshifted_Y, py::call_guard<py::gil_scoped_release>())
+		.def("sub_Y", &pa::MBA::sub_Y, py::call_guard<py::gil_scoped_release>())
+		.def("sub_n", mba_op_n<&pa::MBA::sub_n>)
+		.def("mul_Y", &pa::MBA::mul_Y, py::call_guard<py::gil_scoped_release>())
+		.def("mul_n", mba_op_n<&pa::MBA::mul_n>)
+		.def("div_n", mba_op_n<&pa::MBA::div_n>)
+		.def("not_X", &pa::MBA::not_X)
+		.def("oppose_X", &pa::MBA::oppose_X, py::call_guard<py::gil_scoped_release>())
+		.def("and_n", mba_op_n<&pa::MBA::and_n>)
+		.def("xor_n", mba_op_n<&pa::MBA::xor_n>)
+		.def("or_n", mba_op_n<&pa::MBA::or_n>)
+		.def("or_Y", &pa::MBA::or_Y)
+		.def("lshift_n", &pa::MBA::lshift_n)
+		.def("rshift_n", &pa::MBA::rshift_n)
+		.def("arshift_n", &pa::MBA::arshift_n)
+		.def("rol_n", &pa::MBA::rol_n)
+		.def("ror_n", &pa::MBA::ror_n)
+		;
+	py::register_exception<pa::errors::DivisionByZero>(m, "DivisionByZero", PyExc_ZeroDivisionError);
+
+	m.def("save", save_exp);
+	m.def("save", save_vec);
+	m.def("save", save_mat);
+	m.def("save", save_affapp);
+	m.def("save", save_app);
+	m.def("load", serialize_load, "Loads an Expr, Vector, Matrix, AffApp or App object saved with save");
 
 	m.def("subs_vectors", subs_vectors_exp);
 	m.def("subs_vectors", subs_vectors_vec);
@@ -833,11 +1488,20 @@ PYBIND11_MODULE(pytanque, m)
 	m.def("subs_exprs", subs_exprs_vec);
 	m.def("subs_exprs", subs_exprs_mat);
 
-	m.def("expand_esf_inplace", expand_esf_inplace, py::return_value_policy::reference_internal);
-	m.def("expand_esf_inplace", expand_esf_inplace_vec, py::return_value_policy::reference_internal);
+	m.def("expand_esf_inplace", expand_esf_inplace, py::return_value_policy::reference_internal, py::call_guard<py::gil_scoped_release>());
+	m.def("expand_esf_inplace", expand_esf_inplace_vec, py::return_value_policy::reference_internal, py::call_guard<py::gil_scoped_release>());
+
+	m.def("expand_esf", expand_esf, py::call_guard<py::gil_scoped_release>());
+	m.def("expand_esf", expand_esf_vec, py::call_guard<py::gil_scoped_release>());
 
-	m.def("expand_esf", expand_esf);
-	m.def("expand_esf", expand_esf_vec);
+	m.def("simplify_caches_stats", simplify_caches_stats,
+		"Statistics (hits, misses, evictions and size) of the caches of simplify and expand_esf");
+	m.def("clear_simplify_caches", pa::simps::clear_caches);
+	m.def("simplify_rules_stats", simplify_rules_stats,
+		"Statistics (attempts, rewrites, time and sizes) of the rules and passes of the simplifications, if SimplifyConfig.rules_stats is set");
+	m.def("reset_simplify_rules_stats", pa::simps::reset_rules_stats);
+	m.def("anf_via_truth_table", anf_via_truth_table, py::arg("e"), py::arg("max_symbols") = 20,
+		"Computes the ANF of an expression from its truth table, if it depends on at most max_symbols symbols");
 
 	m.def("or_to_esf_inplace", or_to_esf_inplace, py::return_value_policy::reference_internal);
 	m.def("or_to_esf", or_to_esf);
@@ -855,6 +1519,10 @@ PYBIND11_MODULE(pytanque, m)
 	{
 		py::module analyses = m.def_submodule("analyses");
 		analyses.def("vectorial_decomp", pa::analyses::vectorial_decomp);
+		analyses.def("vectorial_decomp_bits", vectorial_decomp_bits,
+			"Decomposes a vector into (M, cst, nl), with M a BitMatrix, such that v = M*symbols + cst + nl");
+		analyses.def("find_esfs", pa::analyses::find_esfs,
+			"Finds the ESFs whose expansions are in the ANF expression e, and replaces these expansions by the ESFs in e. Returns the ESFs found by decreasing degree.");
 	}
 
 	{
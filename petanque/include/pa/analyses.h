@@ -27,11 +27,13 @@
 #define PETANQUE_ANALYSES_H
 
 #include <pa/app.h>
+#include <pa/bitmatrix.h>
 #include <pa/compat.h>
 #include <pa/exports.h>
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 namespace pa {
 
@@ -51,8 +53,26 @@ private:
 	std::string _err;
 };
 
+// Decomposition of a vector v of expressions into matrix*symbols + cst + nl,
+// where nl is the non linear part, expressed with the original symbols
+struct VectorialDecomp
+{
+	BitMatrix matrix;
+	Vector cst;
+	Vector nl;
+};
+
+// v must be simplified. Throws UnknownSymbol if one of its linear terms isn't
+// in symbols.
+PA_API VectorialDecomp vectorial_decomp_bits(Vector const& symbols, Vector const& v);
 PA_API App vectorial_decomp(Vector const& symbols, Vector const& v);
 
+// Finds the ESFs (of degree at least 2) whose expansions are in the ANF
+// expression e, and replaces these expansions by the ESFs in e. The ESFs are
+// returned by decreasing degree. This is the native version of
+// arybo.tools.find_esfs.
+PA_API std::vector<Expr> find_esfs(Expr& e);
+
 template <typename Iterator>
 Iterator find_expr(Iterator begin, Iterator end, Expr const& s)
 {
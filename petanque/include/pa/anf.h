@@ -0,0 +1,142 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_ANF_H
+#define PETANQUE_ANF_H
+
+#include <cstdint>
+#include <vector>
+
+#include <pa/exports.h>
+#include <pa/exprs.h>
+
+namespace pa {
+
+// Dense representation of an expression in algebraic normal form (ANF), that
+// is an addition of products of symbols (and possibly of the constant 1).
+//
+// Each monomial is a bitmask over the (sorted) symbols of the support of the
+// expression, stored as nwords() 64-bit words. Monomials are kept sorted in
+// the same order as the arguments of the equivalent ExprAdd, so that
+// conversion from and to Expr objects are linear.
+class PA_API ANF
+{
+public:
+	typedef uint64_t word_type;
+	typedef ExprSym::idx_type idx_type;
+
+	static constexpr size_t word_bits = sizeof(word_type)*8;
+	// Maximum number of symbols in the support of an ANF
+	static constexpr size_t max_symbols = 256;
+	// Maximum number of symbols of a truth table (which has 2^n bits)
+	static constexpr size_t max_truth_table_symbols = 30;
+
+public:
+	// Null expression
+	ANF();
+
+	// Null expression over the support 'syms', which must be sorted
+	explicit ANF(std::vector<idx_type> syms);
+
+public:
+	// Returns true iif e is in ANF (or is a product of symbols, a symbol or an
+	// immediate)
+	static bool is_anf(Expr const& e);
+
+	// Adds the symbols used by an expression that verifies is_anf to syms.
+	// syms is kept sorted and unique.
+	static void support(Expr const& e, std::vector<idx_type>& syms);
+
+	// Create an ANF object from an expression that verifies is_anf.
+	// Returns false if e is not in ANF or if its support is too large.
+	static bool from_expr(Expr const& e, ANF& ret);
+	static bool from_expr(Expr const& e, std::vector<idx_type> const& syms, ANF& ret);
+
+	// Computes the ANF of any expression (ORs and ESFs included) from its
+	// truth table, which costs O(2^n) for a support of n symbols whatever
+	// the size of e. Returns false if this support has more than max_syms
+	// symbols.
+	static bool from_expr_truth_table(Expr const& e, ANF& ret, size_t max_syms);
+
+	// Adds the symbols used by any expression to syms, which is kept sorted
+	// and unique
+	static void full_support(Expr const& e, std::vector<idx_type>& syms);
+
+	// Truth table over syms of the product of the expressions in [begin,
+	// end), whose supports must be included in syms. Bit x of the table
+	// (bit x%64 of word x/64) is the value of the product when each symbol
+	// syms[i] is set to bit i of x. Tables of less than 6 symbols are
+	// repeated across the only word of the table.
+	static std::vector<word_type> truth_table(Expr const* begin, Expr const* end, std::vector<idx_type> const& syms);
+
+	// ANF of the function whose truth table over syms (as returned by
+	// truth_table) is tt, computed with the Moebius transform
+	static ANF from_truth_table(std::vector<idx_type> syms, std::vector<word_type> tt);
+
+	// Returns the ExprAdd object equivalent to this, whose arguments are sorted
+	Expr to_expr_add() const;
+	// Returns the simplest expression equivalent to this
+	Expr to_expr() const;
+
+public:
+	inline std::vector<idx_type> const& symbols() const { return _syms; }
+	inline size_t nwords() const { return _nwords; }
+	inline size_t nmonomials() const { return _monos.size()/_nwords; }
+	inline bool is_zero() const { return nmonomials() == 0; }
+
+	inline word_type const* monomial(size_t i) const { return &_monos[i*_nwords]; }
+
+	// Degree of the polynomial (0 for the null one)
+	unsigned degree() const;
+
+	// Changes the support of this object. syms must be a sorted superset of
+	// the current support.
+	void rebase(std::vector<idx_type> const& syms);
+
+public:
+	ANF& operator+=(ANF const& o);
+	ANF& operator*=(ANF const& o);
+
+	ANF operator+(ANF const& o) const;
+	ANF operator*(ANF const& o) const;
+
+	bool operator==(ANF const& o) const;
+	inline bool operator!=(ANF const& o) const { return !(*this == o); }
+
+private:
+	bool push_monomial(Expr const& e);
+	Expr monomial_expr(size_t i) const;
+	static ANF add_same_support(ANF const& a, ANF const& b);
+	static ANF mul_same_support(ANF const& a, ANF const& b);
+
+private:
+	std::vector<idx_type> _syms;
+	std::vector<word_type> _monos;
+	size_t _nwords;
+};
+
+} // pa
+
+#endif
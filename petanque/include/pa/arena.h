@@ -0,0 +1,140 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_ARENA_H
+#define PETANQUE_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include <pa/exports.h>
+
+namespace pa {
+
+class Expr;
+class Vector;
+
+// Bump allocator whose memory is released in one shot. It is reference
+// counted by its scope and every allocation it made, so that objects that
+// escape an ArenaScope stay valid (their memory is only released once they
+// are destroyed).
+class PA_API Arena
+{
+public:
+	Arena(size_t chunk_size);
+	Arena(Arena const&) = delete;
+	Arena& operator=(Arena const&) = delete;
+
+public:
+	void* allocate(size_t bytes);
+
+	inline void acquire() { _refs.fetch_add(1, std::memory_order_relaxed); }
+	void release();
+
+	inline size_t bytes_allocated() const { return _allocated; }
+
+private:
+	~Arena();
+
+private:
+	std::vector<char*> _chunks;
+	char* _cur;
+	char* _end;
+	size_t _chunk_size;
+	size_t _allocated;
+	std::atomic<size_t> _refs;
+};
+
+// RAII object that makes every ExprArgs storage allocated by the current
+// thread come from an Arena, until it is destroyed.
+// Expressions that need to outlive the scope should be exported, so that the
+// arena memory can be freed when the scope ends.
+class PA_API ArenaScope
+{
+public:
+	static constexpr size_t default_chunk_size = 1<<16;
+
+public:
+	ArenaScope(size_t chunk_size = default_chunk_size);
+	~ArenaScope();
+
+	ArenaScope(ArenaScope const&) = delete;
+	ArenaScope& operator=(ArenaScope const&) = delete;
+
+public:
+	// Deep copy objects outside of any arena
+	static Expr export_expr(Expr const& e);
+	static Vector export_vector(Vector const& v);
+
+	inline size_t bytes_allocated() const { return _arena->bytes_allocated(); }
+
+	static Arena* current();
+
+private:
+	Arena* _arena;
+	Arena* _prev;
+};
+
+PA_API void* arena_allocate(size_t bytes);
+PA_API void arena_deallocate(void* p) noexcept;
+
+// Stateless allocator that uses the arena of the current scope, if any, and
+// the heap otherwise.
+template <class T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+public:
+	ArenaAllocator() noexcept { }
+
+	template <class U>
+	ArenaAllocator(ArenaAllocator<U> const&) noexcept
+	{ }
+
+public:
+	T* allocate(size_t n)
+	{
+		static_assert(alignof(T) <= sizeof(void*), "arena allocations are only aligned on pointers");
+		return static_cast<T*>(arena_allocate(n*sizeof(T)));
+	}
+
+	void deallocate(T* p, size_t) noexcept
+	{
+		arena_deallocate(p);
+	}
+
+	template <class U>
+	inline bool operator==(ArenaAllocator<U> const&) const { return true; }
+
+	template <class U>
+	inline bool operator!=(ArenaAllocator<U> const&) const { return false; }
+};
+
+} // pa
+
+#endif
@@ -0,0 +1,143 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_BITMATRIX_H
+#define PETANQUE_BITMATRIX_H
+
+#include <pa/exports.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pa {
+
+class Matrix;
+class Vector;
+
+// Matrix over GF(2), stored row-major with 64 entries per word. Bit j%64 of
+// word j/64 of a line is the entry at column j. Lines are padded with zeros
+// up to a whole number of words, so that line operations work on whole
+// words.
+//
+// Matrix uses it for its matrices whose entries are all immediates.
+class PA_API BitMatrix
+{
+public:
+	typedef uint64_t word_type;
+	static constexpr size_t word_bits = sizeof(word_type)*8;
+	// Number of lines combined in the tables of the method of the four
+	// Russians
+	static constexpr size_t table_bits = 8;
+
+public:
+	BitMatrix():
+		_nlines(0),
+		_ncols(0),
+		_nwords(0)
+	{ }
+
+	// Zero matrix
+	BitMatrix(const size_t nlines, const size_t ncols);
+
+public:
+	static BitMatrix identity(const size_t n);
+
+	// Converts m into ret, if all its entries are immediates
+	static bool from_matrix(Matrix const& m, BitMatrix& ret);
+	Matrix to_matrix() const;
+
+public:
+	inline size_t nlines() const { return _nlines; }
+	inline size_t ncols() const { return _ncols; }
+	inline bool empty() const { return _nlines == 0 || _ncols == 0; }
+
+	inline bool at(const size_t line, const size_t col) const
+	{
+		return (line_words(line)[col/word_bits] >> (col%word_bits)) & 1;
+	}
+
+	inline void set(const size_t line, const size_t col, const bool v)
+	{
+		word_type& w = line_words(line)[col/word_bits];
+		const word_type mask = word_type{1} << (col%word_bits);
+		w = v ? (w | mask) : (w & ~mask);
+	}
+
+	inline word_type* line_words(const size_t line) { return &_words[line*_nwords]; }
+	inline word_type const* line_words(const size_t line) const { return &_words[line*_nwords]; }
+	inline size_t words_per_line() const { return _nwords; }
+
+public:
+	// Line a += line b
+	void add_lines(const size_t a, const size_t b);
+	void swap_lines(const size_t a, const size_t b);
+	void swap_cols(const size_t a, const size_t b);
+
+	// Same as Matrix::T_fact
+	size_t T_fact(BitMatrix& T, BitMatrix& U, std::vector<size_t>& perm) const;
+	size_t rank() const;
+	// Returns an empty matrix if this one isn't invertible
+	BitMatrix inverse() const;
+	// Finds X such that this*X = B. Returns false if there isn't any. If
+	// there are several of them, free variables are set to zero.
+	bool solve(BitMatrix const& B, BitMatrix& X) const;
+
+public:
+	BitMatrix& operator+=(BitMatrix const& o);
+	BitMatrix  operator+ (BitMatrix const& o) const;
+	// Computed with the method of the four Russians
+	BitMatrix  operator* (BitMatrix const& o) const;
+	// Each line of the result is the sum of the elements of o selected by
+	// the corresponding line of this matrix
+	Vector     operator* (Vector const& o) const;
+
+	bool operator==(BitMatrix const& o) const;
+	bool operator!=(BitMatrix const& o) const { return !(*this == o); }
+
+private:
+	// Gauss-Jordan elimination of this matrix, applying the same operations
+	// to the lines of B (if not null). Columns of the pivots are stored in
+	// pivots, and their lines are the first ones. Returns the rank.
+	//
+	// Pivots are found by blocks of table_bits, and the other lines are
+	// reduced by all the pivots of a block at once, using a table of their
+	// combinations (method of the four Russians).
+	size_t eliminate(BitMatrix* B, std::vector<size_t>& pivots);
+
+	// Index of the first column from col whose entry is set in line, or
+	// ncols() if there isn't any
+	size_t first_set(const size_t line, const size_t col) const;
+
+private:
+	size_t _nlines;
+	size_t _ncols;
+	size_t _nwords;
+	std::vector<word_type> _words;
+};
+
+} // pa
+
+#endif
@@ -0,0 +1,160 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_BITSLICED_H
+#define PETANQUE_BITSLICED_H
+
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+#include <pa/exports.h>
+#include <pa/exprs.h>
+
+namespace pa {
+
+class Vector;
+class App;
+
+// Compiled form of a vector of expressions, that evaluates it on many
+// concrete inputs at once.
+//
+// Expressions are compiled into a flat list of XOR/AND/OR/ESF instructions
+// over registers, structurally equal subexpressions being computed only
+// once. Each register holds one bit of many evaluations ("bit planes"), so
+// that one machine instruction evaluates a node on 64, 256 or 512 inputs.
+// Compiled expressions are neither simplified nor modified.
+class PA_API BitslicedEvaluator
+{
+	friend class JitFunction;
+
+public:
+	typedef uint64_t word_type;
+	static constexpr size_t word_bits = sizeof(word_type)*8;
+
+	// Number of words processed at once by one instruction
+	enum class Width: unsigned {
+		Auto = 0, // widest one supported by the CPU
+		W64 = 1,
+		W256 = 4,
+		W512 = 8
+	};
+
+	struct UnknownSymbol: public std::exception
+	{
+		const char* what() const noexcept override
+		{
+			return "expression uses a symbol which is not an input of the evaluator";
+		}
+	};
+
+public:
+	// inputs must be symbols: input i of the evaluator is inputs[i]
+	BitslicedEvaluator(Vector const& outputs, Vector const& inputs);
+
+	// Inputs are the argument symbols of app, that is arg_symbol(i) for i in
+	// [0, app.matrix().ncols())
+	explicit BitslicedEvaluator(App const& app);
+
+public:
+	inline size_t ninputs() const { return _ninputs; }
+	inline size_t noutputs() const { return _outputs.size(); }
+	inline size_t ninstructions() const { return _instrs.size(); }
+	inline size_t nregisters() const { return _nregs; }
+
+	// Number of words of an input (resp. output) row given to (resp. returned
+	// by) eval
+	inline size_t input_row_words() const { return words_for(ninputs()); }
+	inline size_t output_row_words() const { return words_for(noutputs()); }
+
+	// Widest width supported by the running CPU
+	static Width native_width();
+
+	// Outputs and inputs of the vector equivalent to app, as used by the App
+	// constructor
+	static void app_vectors(App const& app, Vector& outputs, Vector& inputs);
+
+public:
+	// Evaluates on nwords*word_bits inputs given as bit planes. in holds
+	// ninputs() planes of nwords words each, bit k of in[i*nwords+w] being the
+	// value of input i for the evaluation number w*word_bits+k. out receives
+	// noutputs() planes with the same layout.
+	void eval_planes(word_type const* in, word_type* out, size_t nwords, Width width = Width::Auto) const;
+
+	// Evaluates on n concrete inputs. in holds n rows of input_row_words()
+	// words, bit i of a row being the value of input i. out receives n rows of
+	// output_row_words() words.
+	void eval(word_type const* in, word_type* out, size_t n, Width width = Width::Auto) const;
+
+	// Same as above, n being values.size()/input_row_words()
+	std::vector<word_type> eval(std::vector<word_type> const& values, Width width = Width::Auto) const;
+
+private:
+	enum class Op: uint8_t {
+		Xor,
+		And,
+		Or,
+		ESF
+	};
+
+	struct Instr
+	{
+		Op op;
+		uint32_t degree;
+		uint32_t dst;
+		uint32_t args_begin;
+		uint32_t args_end;
+	};
+
+	// Registers 0 and 1 hold the constants 0 and 1, followed by the inputs
+	static constexpr uint32_t reg_zero = 0;
+	static constexpr uint32_t reg_one = 1;
+	static constexpr uint32_t reg_inputs = 2;
+
+	static inline size_t words_for(size_t nbits) { return (nbits + word_bits - 1)/word_bits; }
+
+	struct Compiler;
+	struct Runner;
+
+	void compile(Vector const& outputs, Vector const& inputs);
+	void allocate_registers();
+
+	// Conversions between n rows of nbits bits and the corresponding bit
+	// planes, as described in eval and eval_planes
+	static void rows_to_planes(word_type const* rows, size_t n, size_t nbits, word_type* planes);
+	static void planes_to_rows(word_type const* planes, size_t n, size_t nbits, word_type* rows);
+
+private:
+	std::vector<Instr> _instrs;
+	std::vector<uint32_t> _args;
+	std::vector<uint32_t> _outputs;
+	size_t _ninputs;
+	size_t _nregs;
+	uint32_t _max_degree;
+};
+
+} // pa
+
+#endif
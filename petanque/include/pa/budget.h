@@ -0,0 +1,119 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_BUDGET_H
+#define PETANQUE_BUDGET_H
+
+#include <pa/exports.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace pa {
+
+// Limits on the resources used by a simplification or an expansion (see
+// BudgetScope). They are checked as the computation goes, and
+// errors::BudgetExceeded is thrown as soon as one of them is exceeded. The
+// expression being processed is then left in a valid state, equivalent to
+// the original one, but only partially simplified or expanded.
+//
+// Limits must be set before the computation starts, but cancel() can be
+// called from any thread at any time.
+class PA_API Budget
+{
+public:
+	typedef std::chrono::steady_clock clock_type;
+
+public:
+	Budget();
+
+public:
+	// Maximum number of nodes visited by simplify (0 means no limit)
+	uint64_t max_nodes() const { return _max_nodes; }
+	void set_max_nodes(uint64_t n) { _max_nodes = n; }
+
+	// Maximum number of monomials created by expansions (0 means no limit)
+	uint64_t max_monomials() const { return _max_monomials; }
+	void set_max_monomials(uint64_t n) { _max_monomials = n; }
+
+	// Sets the deadline to seconds from now (0 removes it)
+	void set_timeout(double seconds);
+	bool has_deadline() const { return _has_deadline; }
+
+	void cancel() { _cancelled = true; }
+	bool cancelled() const { return _cancelled; }
+
+	// Resources consumed since the last reset
+	uint64_t nodes() const { return _nodes; }
+	uint64_t monomials() const { return _monomials; }
+
+	// Resets the consumed resources and the cancellation. The limits and the
+	// deadline are kept.
+	void reset();
+
+public:
+	// Account for resources about to be consumed. They throw
+	// errors::BudgetExceeded if a limit is exceeded, if the deadline has
+	// passed or if the computation has been cancelled.
+	void consume_nodes(uint64_t n);
+	void consume_monomials(uint64_t n);
+	// Only checks the deadline and the cancellation
+	void check() const;
+
+private:
+	uint64_t _max_nodes;
+	uint64_t _max_monomials;
+	clock_type::time_point _deadline;
+	bool _has_deadline;
+	std::atomic<bool> _cancelled;
+	std::atomic<uint64_t> _nodes;
+	std::atomic<uint64_t> _monomials;
+};
+
+// RAII object that makes the simplifications and expansions run by the
+// current thread (and the tasks they spawn) account their resources in
+// budget, until it is destroyed. nullptr removes the limits within the
+// scope. The budget must outlive the scope.
+class PA_API BudgetScope
+{
+public:
+	explicit BudgetScope(Budget* budget);
+	~BudgetScope();
+
+	BudgetScope(BudgetScope const&) = delete;
+	BudgetScope& operator=(BudgetScope const&) = delete;
+
+public:
+	static Budget* current();
+
+private:
+	Budget* _budget;
+	Budget* _prev;
+};
+
+} // pa
+
+#endif
@@ -0,0 +1,91 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_CACHE_H
+#define PETANQUE_CACHE_H
+
+#include <pa/exports.h>
+#include <pa/exprs.h>
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace pa {
+
+// Thread-safe cache of the results of a transformation of expressions (like
+// a simplification), indexed by the structure of their inputs. It keeps at
+// most capacity() entries, and evicts the least recently used ones first.
+class PA_API ExprCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t size;
+	};
+
+public:
+	explicit ExprCache(size_t capacity = 0);
+
+public:
+	// Sets out to the cached result for in, if any
+	bool lookup(Expr const& in, Expr& out);
+	void insert(Expr const& in, Expr const& out);
+
+	size_t capacity() const;
+	void set_capacity(size_t capacity);
+
+	// Removes every entry and resets the statistics
+	void clear();
+	Stats stats() const;
+
+private:
+	struct Entry
+	{
+		uint64_t hash;
+		Expr in;
+		Expr out;
+	};
+	typedef std::list<Entry> lru_type;
+
+	static uint64_t hash(Expr const& e);
+	void evict(size_t size);
+
+private:
+	// Most recently used entries first
+	lru_type _lru;
+	std::unordered_multimap<uint64_t, lru_type::iterator> _index;
+	size_t _capacity;
+	Stats _stats;
+	mutable std::mutex _mutex;
+};
+
+} // pa
+
+#endif
@@ -0,0 +1,410 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_COMPACT_VECTOR_H
+#define PETANQUE_COMPACT_VECTOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace pa {
+
+// std::vector-like container whose handle is a single pointer. The size and
+// the capacity are stored in front of the elements, in the same heap block.
+// The first allocation of a growing vector reserves N elements, so that small
+// vectors are allocated only once.
+//
+// Elements can't be stored inline, as this container is used to store the
+// arguments of Expr objects (whose size would then depend on itself). Still,
+// this makes an Expr object 10 bytes long (instead of 26 with std::vector),
+// which makes arrays of arguments denser.
+template <class T, size_t N, class Alloc = std::allocator<T>>
+class CompactVector
+{
+	static_assert(N > 0, "initial capacity must be strictly positive");
+
+public:
+	typedef T value_type;
+	typedef size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef T& reference;
+	typedef T const& const_reference;
+	typedef T* pointer;
+	typedef T const* const_pointer;
+	typedef T* iterator;
+	typedef T const* const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+	typedef Alloc allocator_type;
+
+private:
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<char> byte_allocator;
+
+	struct Header
+	{
+		uint32_t size;
+		uint32_t capacity;
+	};
+
+public:
+	CompactVector():
+		_h(nullptr)
+	{ }
+
+	explicit CompactVector(size_type n):
+		_h(nullptr)
+	{
+		resize(n);
+	}
+
+	CompactVector(size_type n, const_reference v):
+		_h(nullptr)
+	{
+		resize(n, v);
+	}
+
+	template <class Iterator, class = typename std::iterator_traits<Iterator>::iterator_category>
+	CompactVector(Iterator begin, Iterator end):
+		_h(nullptr)
+	{
+		assign(begin, end);
+	}
+
+	CompactVector(std::initializer_list<T> const& il):
+		_h(nullptr)
+	{
+		assign(il.begin(), il.end());
+	}
+
+	CompactVector(CompactVector const& o):
+		_h(nullptr)
+	{
+		assign(o.begin(), o.end());
+	}
+
+	CompactVector(CompactVector&& o) noexcept:
+		_h(o._h)
+	{
+		o._h = nullptr;
+	}
+
+	~CompactVector()
+	{
+		release();
+	}
+
+	CompactVector& operator=(CompactVector const& o)
+	{
+		if (&o != this) {
+			CompactVector tmp(o);
+			swap(tmp);
+		}
+		return *this;
+	}
+
+	CompactVector& operator=(CompactVector&& o) noexcept
+	{
+		if (&o != this) {
+			release();
+			_h = o._h;
+			o._h = nullptr;
+		}
+		return *this;
+	}
+
+public:
+	size_type size() const { return _h ? _h->size : 0; }
+	size_type capacity() const { return _h ? _h->capacity : 0; }
+	bool empty() const { return size() == 0; }
+	size_type max_size() const { return std::numeric_limits<uint32_t>::max(); }
+	allocator_type get_allocator() const { return allocator_type(); }
+
+	pointer data() { return _h ? elts() : nullptr; }
+	const_pointer data() const { return _h ? elts() : nullptr; }
+
+	iterator begin() { return data(); }
+	iterator end() { return data() + size(); }
+	const_iterator begin() const { return data(); }
+	const_iterator end() const { return data() + size(); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+	reverse_iterator rbegin() { return reverse_iterator(end()); }
+	reverse_iterator rend() { return reverse_iterator(begin()); }
+	const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+	const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+	const_reverse_iterator crbegin() const { return rbegin(); }
+	const_reverse_iterator crend() const { return rend(); }
+
+	reference operator[](size_type i) { assert(i < size()); return elts()[i]; }
+	const_reference operator[](size_type i) const { assert(i < size()); return elts()[i]; }
+	reference front() { return (*this)[0]; }
+	const_reference front() const { return (*this)[0]; }
+	reference back() { return (*this)[size()-1]; }
+	const_reference back() const { return (*this)[size()-1]; }
+
+public:
+	void reserve(size_type n)
+	{
+		if (n > capacity()) {
+			reallocate(n);
+		}
+	}
+
+	void shrink_to_fit()
+	{
+		const size_type n = size();
+		if (n == 0) {
+			release();
+		}
+		else
+		if (n < capacity()) {
+			reallocate(n);
+		}
+	}
+
+	void clear()
+	{
+		destroy(begin(), end());
+		if (_h) {
+			_h->size = 0;
+		}
+	}
+
+	void resize(size_type n)
+	{
+		resize_with(n, [](T* p) { new (p) T(); });
+	}
+
+	void resize(size_type n, const_reference v)
+	{
+		if (n > capacity()) {
+			// v might be one of our elements
+			T tmp(v);
+			resize_with(n, [&tmp](T* p) { new (p) T(tmp); });
+		}
+		else {
+			resize_with(n, [&v](T* p) { new (p) T(v); });
+		}
+	}
+
+	template <class Iterator>
+	void assign(Iterator begin, Iterator end)
+	{
+		clear();
+		const size_type n = std::distance(begin, end);
+		if (n == 0) {
+			return;
+		}
+		reserve(n);
+		T* p = elts();
+		for (; begin != end; ++begin) {
+			new (p) T(*begin);
+			++p;
+			_h->size++;
+		}
+	}
+
+	template <class... Args>
+	void emplace_back(Args&& ... args)
+	{
+		if (size() == capacity()) {
+			// args might reference one of our elements
+			T tmp(std::forward<Args>(args)...);
+			grow(size()+1);
+			new (end()) T(std::move(tmp));
+		}
+		else {
+			new (end()) T(std::forward<Args>(args)...);
+		}
+		_h->size++;
+	}
+
+	void push_back(const_reference v) { emplace_back(v); }
+	void push_back(T&& v) { emplace_back(std::move(v)); }
+
+	void pop_back()
+	{
+		assert(!empty());
+		back().~T();
+		_h->size--;
+	}
+
+	template <class... Args>
+	iterator emplace(const_iterator pos, Args&& ... args)
+	{
+		const size_type idx = pos - begin();
+		assert(idx <= size());
+		T tmp(std::forward<Args>(args)...);
+		if (idx == size()) {
+			emplace_back(std::move(tmp));
+			return begin() + idx;
+		}
+		emplace_back(std::move(back()));
+		T* e = elts();
+		std::move_backward(e + idx, e + size() - 2, e + size() - 1);
+		e[idx] = std::move(tmp);
+		return e + idx;
+	}
+
+	iterator insert(const_iterator pos, const_reference v) { return emplace(pos, v); }
+	iterator insert(const_iterator pos, T&& v) { return emplace(pos, std::move(v)); }
+
+	template <class Iterator, class = typename std::iterator_traits<Iterator>::iterator_category>
+	iterator insert(const_iterator pos, Iterator begin, Iterator end)
+	{
+		const size_type idx = pos - this->begin();
+		const size_type org_size = size();
+		assert(idx <= org_size);
+		reserve(org_size + std::distance(begin, end));
+		for (; begin != end; ++begin) {
+			emplace_back(*begin);
+		}
+		std::rotate(this->begin() + idx, this->begin() + org_size, this->end());
+		return this->begin() + idx;
+	}
+
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		const size_type idx = first - begin();
+		const size_type n = last - first;
+		if (n > 0) {
+			T* e = elts();
+			std::move(e + idx + n, e + size(), e + idx);
+			destroy(end() - n, end());
+			_h->size -= n;
+		}
+		return begin() + idx;
+	}
+
+	iterator erase(const_iterator pos) { return erase(pos, pos+1); }
+
+	void swap(CompactVector& o) noexcept
+	{
+		std::swap(_h, o._h);
+	}
+
+public:
+	bool operator==(CompactVector const& o) const
+	{
+		return size() == o.size() && std::equal(begin(), end(), o.begin());
+	}
+
+	bool operator!=(CompactVector const& o) const { return !(*this == o); }
+
+	bool operator<(CompactVector const& o) const
+	{
+		return std::lexicographical_compare(begin(), end(), o.begin(), o.end());
+	}
+
+private:
+	T* elts() const
+	{
+		static_assert(alignof(T) <= alignof(Header), "elements can't be aligned after the header");
+		return reinterpret_cast<T*>(_h+1);
+	}
+
+	static void destroy(T* begin, T* end)
+	{
+		for (; begin != end; ++begin) {
+			begin->~T();
+		}
+	}
+
+	void grow(size_type min)
+	{
+		const size_type cap = capacity();
+		reallocate(std::max(min, cap == 0 ? N : cap*2));
+	}
+
+	void reallocate(size_type cap)
+	{
+		assert(cap >= size());
+		assert(cap <= max_size());
+		byte_allocator alloc;
+		Header* h = reinterpret_cast<Header*>(alloc.allocate(sizeof(Header) + cap*sizeof(T)));
+		const size_type n = size();
+		h->size = n;
+		h->capacity = cap;
+		if (_h) {
+			T* src = elts();
+			T* dst = reinterpret_cast<T*>(h+1);
+			for (size_type i = 0; i < n; i++) {
+				new (&dst[i]) T(std::move(src[i]));
+				src[i].~T();
+			}
+			deallocate(_h);
+		}
+		_h = h;
+	}
+
+	template <class F>
+	void resize_with(size_type n, F const& construct)
+	{
+		const size_type org = size();
+		if (n < org) {
+			destroy(begin() + n, end());
+			_h->size = n;
+			return;
+		}
+		if (n == org) {
+			return;
+		}
+		reserve(n);
+		for (T* p = elts() + org; p != elts() + n; ++p) {
+			construct(p);
+		}
+		_h->size = n;
+	}
+
+	void release()
+	{
+		if (_h) {
+			destroy(begin(), end());
+			deallocate(_h);
+			_h = nullptr;
+		}
+	}
+
+	static void deallocate(Header* h)
+	{
+		byte_allocator alloc;
+		alloc.deallocate(reinterpret_cast<char*>(h), sizeof(Header) + h->capacity*sizeof(T));
+	}
+
+private:
+	Header* _h;
+};
+
+} // pa
+
+#endif
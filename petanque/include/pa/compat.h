@@ -33,4 +33,47 @@ typedef SSIZE_T ssize_t;
 #endif
 #endif
 
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace pa {
+
+inline unsigned popcount64(uint64_t v)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	return (unsigned)__popcnt64(v);
+#elif defined(_MSC_VER)
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (unsigned)((v * 0x0101010101010101ULL) >> 56);
+#else
+	return (unsigned)__builtin_popcountll(v);
+#endif
+}
+
+// Index of the least significant bit set. v must not be null.
+inline unsigned ctz64(uint64_t v)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long ret;
+	_BitScanForward64(&ret, v);
+	return (unsigned)ret;
+#elif defined(_MSC_VER)
+	unsigned ret = 0;
+	while ((v & 1) == 0) {
+		v >>= 1;
+		ret++;
+	}
+	return ret;
+#else
+	return (unsigned)__builtin_ctzll(v);
+#endif
+}
+
+} // pa
+
 #endif
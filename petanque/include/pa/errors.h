@@ -39,6 +39,52 @@ struct PA_API SizeMismatch: public std::exception
 	const char* what() const noexcept override { return "size mismatch"; }
 };
 
+struct PA_API InvalidFormat: public std::exception
+{
+	const char* what() const noexcept override { return "invalid or unsupported serialized data"; }
+};
+
+struct PA_API IOError: public std::exception
+{
+	const char* what() const noexcept override { return "unable to read or write file"; }
+};
+
+struct PA_API DivisionByZero: public std::exception
+{
+	const char* what() const noexcept override { return "division by zero"; }
+};
+
+// Thrown when a computation exceeds its resource budget (see pa::Budget)
+struct PA_API BudgetExceeded: public std::exception
+{
+	enum Reason
+	{
+		nodes,
+		monomials,
+		deadline,
+		cancelled
+	};
+
+	explicit BudgetExceeded(Reason reason_): reason(reason_) { }
+
+	const char* what() const noexcept override
+	{
+		switch (reason) {
+			case nodes:
+				return "budget exceeded: too many nodes";
+			case monomials:
+				return "budget exceeded: too many monomials";
+			case deadline:
+				return "budget exceeded: deadline passed";
+			case cancelled:
+				return "budget exceeded: cancelled";
+		};
+		return "budget exceeded";
+	}
+
+	Reason reason;
+};
+
 }
 
 }
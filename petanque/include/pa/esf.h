@@ -0,0 +1,59 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_ESF_H
+#define PETANQUE_ESF_H
+
+#include <pa/exports.h>
+#include <pa/exprs.h>
+
+#include <limits>
+
+namespace pa {
+
+// Closed-form arithmetic on elementary symmetric functions, so that they can
+// be kept unexpanded. In the following, e_k(X) is the ESF of degree k over
+// the arguments X, which are boolean expressions (so that x*x = x).
+
+// Maximum degree of an ExprESF object
+constexpr size_t esf_max_degree = std::numeric_limits<ExprESF::degree_type>::max();
+
+// e_k(args), as its simplest expression: 1 for k == 0, 0 for k >
+// args.size(), the sum of the arguments for k == 1 and their product for k
+// == args.size(). k must be lower or equal to esf_max_degree.
+PA_API Expr esf(size_t k, ExprArgs const& args);
+
+// e_i(args)*e_j(args) = sum of the e_k(args) such that C(k, i)*C(i, i+j-k)
+// is odd, for max(i, j) <= k <= i+j. min(i+j, args.size()) must be lower or
+// equal to esf_max_degree.
+PA_API Expr esf_product(size_t i, size_t j, ExprArgs const& args);
+
+// e_k(args, 1, ..., 1), with ones arguments equal to 1, is the sum of the
+// e_{k-t}(args) such that C(ones, t) is odd
+PA_API Expr esf_with_ones(size_t k, ExprArgs const& args, size_t ones);
+
+} // pa
+
+#endif
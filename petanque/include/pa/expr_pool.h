@@ -0,0 +1,204 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_EXPR_POOL_H
+#define PETANQUE_EXPR_POOL_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+#include <pa/exports.h>
+#include <pa/exprs.h>
+
+namespace pa {
+
+class ExprNode;
+class ExprPool;
+class Vector;
+
+// Handle to an immutable expression interned in an ExprPool. Copying a handle
+// is O(1), and two handles from the same pool are structurally equal iff they
+// point to the same node.
+class ExprRef
+{
+public:
+	ExprRef():
+		_n(nullptr)
+	{ }
+
+	explicit ExprRef(ExprNode const* n):
+		_n(n)
+	{ }
+
+public:
+	inline ExprNode const* node() const { return _n; }
+	inline ExprNode const* operator->() const { return _n; }
+	inline bool valid() const { return _n != nullptr; }
+
+	inline bool operator==(ExprRef const& o) const { return _n == o._n; }
+	inline bool operator!=(ExprRef const& o) const { return _n != o._n; }
+
+	inline uint64_t hash() const;
+
+	ExprRef operator+(ExprRef const& o) const;
+	ExprRef operator*(ExprRef const& o) const;
+	ExprRef operator|(ExprRef const& o) const;
+
+private:
+	ExprNode const* _n;
+};
+
+class PA_API ExprNode
+{
+	friend class ExprPool;
+
+public:
+	typedef std::vector<ExprRef> args_type;
+	typedef ExprSym::idx_type idx_type;
+	typedef ExprESF::degree_type degree_type;
+
+public:
+	inline expr_type_id type() const { return _type; }
+	inline bool has_args() const { return _type < expr_type_id::symbol_type; }
+	inline args_type const& args() const { return _args; }
+	inline size_t nargs() const { return _args.size(); }
+
+	inline idx_type sym_idx() const { assert(_type == expr_type_id::symbol_type); return _value; }
+	inline bool imm_value() const { assert(_type == expr_type_id::imm_type); return _value != 0; }
+	inline degree_type esf_degree() const { assert(_type == expr_type_id::esf_type); return _degree; }
+
+	inline uint64_t hash() const { return _hash; }
+	inline ExprPool* pool() const { return _pool; }
+
+	inline bool is_imm() const { return _type == expr_type_id::imm_type; }
+	inline bool is_zero() const { return is_imm() && (_value == 0); }
+
+private:
+	ExprNode(ExprPool* pool, expr_type_id type, uint32_t value, degree_type degree, args_type&& args);
+
+	bool shallow_equal(ExprNode const& o) const;
+
+private:
+	ExprPool* _pool;
+	args_type _args;
+	uint64_t _hash;
+	uint32_t _value;
+	expr_type_id _type;
+	degree_type _degree;
+};
+
+// Hash-consed expression store. Structurally equal subexpressions are
+// interned once, and every node references its arguments through ExprRef
+// handles, so that shared subterms (like carries in additions) are never
+// duplicated.
+// Arguments of interned nodes are kept sorted following the same order as
+// Expr::operator<, so that converting back to an Expr gives a sorted
+// expression.
+// add, mul and or_ apply the rewrite rules of ops_rules.h, shared with the
+// Expr operators, so that they build the same expressions.
+// This is a standalone building block: MBA doesn't build through it. to_expr
+// and to_vector convert each shared node once, but Expr objects being
+// trees, they still get a copy of it for every use.
+// This object is *not* thread-safe, and handles are only valid during the
+// lifetime of their pool.
+class PA_API ExprPool
+{
+	friend class ExprNode;
+
+public:
+	typedef ExprNode::args_type args_type;
+
+public:
+	ExprPool() { }
+	ExprPool(ExprPool const&) = delete;
+	ExprPool& operator=(ExprPool const&) = delete;
+
+public:
+	ExprRef imm(bool v);
+	ExprRef sym(ExprSym::idx_type idx);
+	ExprRef esf(ExprESF::degree_type degree, args_type args);
+	ExprRef with_args(expr_type_id type, args_type args);
+
+	ExprRef intern(Expr const& e);
+	std::vector<ExprRef> intern(Vector const& v);
+
+	static Expr to_expr(ExprRef r);
+	static Vector to_vector(std::vector<ExprRef> const& v);
+
+public:
+	ExprRef add(ExprRef a, ExprRef b);
+	ExprRef mul(ExprRef a, ExprRef b);
+	ExprRef or_(ExprRef a, ExprRef b);
+
+public:
+	// Compare two handles following Expr::operator< order. Returns <0, 0 or >0.
+	static int compare(ExprRef a, ExprRef b);
+	static bool less(ExprRef a, ExprRef b) { return compare(a, b) < 0; }
+
+public:
+	inline size_t size() const { return _nodes.size(); }
+	void clear();
+
+private:
+	ExprRef get(expr_type_id type, uint32_t value, ExprESF::degree_type degree, args_type&& args);
+	ExprRef from_args(expr_type_id type, args_type&& args);
+	struct Builder;
+	struct ToExprMemo;
+
+	static Expr to_expr(ExprRef r, ToExprMemo& memo);
+
+	struct node_hash
+	{
+		inline size_t operator()(ExprNode const* n) const { return n->hash(); }
+	};
+
+	struct node_equal
+	{
+		inline bool operator()(ExprNode const* a, ExprNode const* b) const { return a->shallow_equal(*b); }
+	};
+
+private:
+	std::deque<ExprNode> _nodes;
+	std::unordered_set<ExprNode const*, node_hash, node_equal> _table;
+};
+
+inline uint64_t ExprRef::hash() const { return _n->hash(); }
+
+} // pa
+
+namespace std {
+
+template <>
+struct hash<pa::ExprRef>
+{
+	inline size_t operator()(pa::ExprRef const& r) const { return r.hash(); }
+};
+
+}
+
+#endif
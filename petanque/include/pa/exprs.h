@@ -35,6 +35,8 @@
 //#include <pector/pector.h>
 //#include <pector/malloc_allocator.h>
 #include <pa/sorted_vector.h>
+#include <pa/arena.h>
+#include <pa/compact_vector.h>
 
 namespace pa {
 class Expr;
@@ -67,7 +69,7 @@ public:
 	//typedef pt::pector<Expr, std::allocator<Expr>, uint32_t, pt::default_recommended_size, false> list;
 	//typedef pt::pector<Expr, pt::malloc_allocator<Expr, true, true>, uint32_t, pt::default_recommended_size, false> list;
 	//typedef std::vector<Expr> list;
-	typedef pa::SortedVector<std::vector<Expr>, 3> list;
+	typedef pa::SortedVector<pa::CompactVector<Expr, 3, pa::ArenaAllocator<Expr>>, 3> list;
 
 	// TODO: make this protected with a proxy for Expr* functions below
 public:
@@ -341,42 +343,44 @@ public:
 
 public:
 	Expr():
-		_type(expr_type_id::imm_type)
+		_type(static_cast<uint8_t>(expr_type_id::imm_type))
 	{ }
 
+	// Copies and moves keep the normalized flag, as the copied expression is
+	// the same.
 	Expr(Expr const& o):
-		_type(o.type())
+		_type(o._type)
 	{
 		if (is_esf()) {
-			new (&storage()) ExprStorage(o.storage().sf);
+			new (&_storage) ExprStorage(o.storage().sf);
 		}
 		else
 		if (has_args()) {
-			new (&storage()) ExprStorage(o.storage().args);
+			new (&_storage) ExprStorage(o.storage().args);
 		}
 		else {
-			storage().copy_immediates(o.storage());
+			_storage.copy_immediates(o.storage());
 		}
 	}
 
 	Expr(Expr&& o):
-		_type(o.type())
+		_type(o._type)
 	{
 		if (is_esf()) {
-			new (&storage()) ExprStorage(std::move(o.storage().sf));
+			new (&_storage) ExprStorage(std::move(o._storage.sf));
 		}
 		else
 		if (has_args()) {
-			new (&storage()) ExprStorage(std::move(o.storage().args));
+			new (&_storage) ExprStorage(std::move(o._storage.args));
 		}
 		else {
-			storage().copy_immediates(o.storage());
+			_storage.copy_immediates(o.storage());
 		}
 	}
 
 	template <class Storage>
 	Expr(expr_type_id type, Storage&& storage):
-		_type(type),
+		_type(static_cast<uint8_t>(type)),
 		_storage(std::forward<Storage>(storage))
 	{ }
 
@@ -393,16 +397,16 @@ public:
 			Expr o_ = o;
 			destruct_args();
 			if (o_.is_esf()) {
-				new (&storage()) ExprStorage(o_.storage().sf);
+				new (&_storage) ExprStorage(o_._storage.sf);
 			}
 			else
 			if (o_.has_args()) {
-				new (&storage()) ExprStorage(o_.storage().args);
+				new (&_storage) ExprStorage(o_._storage.args);
 			}
 			else {
-				storage().copy_immediates(o_.storage());
+				_storage.copy_immediates(o_._storage);
 			}
-			_type = o_.type();
+			_type = o_._type;
 		}
 		return *this;
 	}
@@ -414,16 +418,16 @@ public:
 			Expr o_cp(std::move(o));
 			destruct_args();
 			if (o_cp.is_esf()) {
-				new (&storage()) ExprStorage(std::move(o_cp.storage().sf));
+				new (&_storage) ExprStorage(std::move(o_cp._storage.sf));
 			}
 			else
 			if (o_cp.has_args()) {
-				new (&storage()) ExprStorage(std::move(o_cp.storage().args));
+				new (&_storage) ExprStorage(std::move(o_cp._storage.args));
 			}
 			else {
-				storage().move_immediates(std::move(o_cp.storage()));
+				_storage.move_immediates(std::move(o_cp._storage));
 			}
-			_type = o_cp.type();
+			_type = o_cp._type;
 		}
 		return *this;
 	}
@@ -525,7 +529,18 @@ public:
 	}
 
 public:
-	inline expr_type_id type() const { return _type; }
+	inline expr_type_id type() const { return static_cast<expr_type_id>(_type & type_mask); }
+
+	// An expression is normalized if it is the result of a simplification
+	// and hasn't been modified since, so that simplifying it again can be
+	// skipped. Any non-const access to the storage of an expression (and
+	// thus to its arguments) clears this flag. As the arguments of an
+	// expression can only be modified through it, modifying a sub-expression
+	// also clears the flag of all its parents.
+	// References to arguments obtained before a simplification must not be
+	// used to modify them afterwards.
+	inline bool is_normalized() const { return _type & normalized_flag; }
+	inline void set_normalized() { _type |= normalized_flag; }
 
 	inline bool has_args() const
 	{
@@ -604,7 +619,7 @@ public:
 	bool operator<(Expr const& e) const;
 
 public:
-	inline void set_type(expr_type_id const type) { _type = type; }
+	inline void set_type(expr_type_id const type) { _type = static_cast<uint8_t>(type); }
 
 	void fix_unary()
 	{
@@ -624,12 +639,19 @@ private:
 	}
 
 protected:
-	inline ExprStorage& storage() { return _storage; }
+	inline ExprStorage& storage()
+	{
+		_type &= type_mask;
+		return _storage;
+	}
 	inline ExprStorage const& storage() const { return _storage; }
 
-
 private:
-	expr_type_id _type;
+	// The highest bit of the type is used as the normalized flag
+	static constexpr uint8_t type_mask = 0x7F;
+	static constexpr uint8_t normalized_flag = 0x80;
+
+	uint8_t _type;
 	ExprStorage _storage;
 };
 #pragma pack(pop)
@@ -0,0 +1,114 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_JIT_H
+#define PETANQUE_JIT_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <pa/bitsliced.h>
+#include <pa/exports.h>
+
+namespace pa {
+
+class Vector;
+class App;
+
+// Native code compiled from the instructions of a BitslicedEvaluator.
+//
+// On x86-64, the instructions are translated to straight-line machine code
+// working on 64 evaluations at once (and on 256 with AVX2 if the CPU supports
+// it). On other architectures, evaluation falls back to the interpreter of
+// the BitslicedEvaluator object.
+class PA_API JitFunction
+{
+public:
+	typedef BitslicedEvaluator::word_type word_type;
+
+public:
+	explicit JitFunction(BitslicedEvaluator&& ev);
+	~JitFunction();
+
+	JitFunction(JitFunction const&) = delete;
+	JitFunction& operator=(JitFunction const&) = delete;
+
+public:
+	inline BitslicedEvaluator const& evaluator() const { return _ev; }
+	inline size_t ninputs() const { return _ev.ninputs(); }
+	inline size_t noutputs() const { return _ev.noutputs(); }
+	inline size_t input_row_words() const { return _ev.input_row_words(); }
+	inline size_t output_row_words() const { return _ev.output_row_words(); }
+
+	// Returns true iif native code has been generated
+	inline bool is_native() const { return _code64 != nullptr; }
+	size_t code_size() const;
+
+public:
+	// Evaluates on one input row of input_row_words() words, bit i being the
+	// value of input i. out receives output_row_words() words.
+	void operator()(word_type const* in, word_type* out) const;
+
+	// Same as BitslicedEvaluator::eval_planes and BitslicedEvaluator::eval
+	void eval_planes(word_type const* in, word_type* out, size_t nwords) const;
+	void eval(word_type const* in, word_type* out, size_t n) const;
+	std::vector<word_type> eval(std::vector<word_type> const& values) const;
+
+private:
+	typedef void(*code_type)(word_type*);
+
+	struct Code
+	{
+		void* mem;
+		size_t size;
+	};
+
+	Code generate(unsigned lane_words) const;
+	static void release(Code& c);
+
+	void run(code_type f, unsigned lane_words, word_type const* in, word_type* out, size_t nwords, size_t begin, size_t end) const;
+
+private:
+	BitslicedEvaluator _ev;
+	Code _mem64;
+	Code _mem256;
+	code_type _code64;
+	code_type _code256;
+};
+
+// Returns the native function computing outputs from inputs (see
+// BitslicedEvaluator). Compiled functions are kept in a process-wide cache,
+// keyed by the hash of the expressions, so that compiling the same vectors
+// again is cheap.
+PA_API std::shared_ptr<JitFunction const> jit_compile(Vector const& outputs, Vector const& inputs);
+PA_API std::shared_ptr<JitFunction const> jit_compile(App const& app);
+
+PA_API size_t jit_cache_size();
+PA_API void jit_cache_clear();
+
+} // pa
+
+#endif
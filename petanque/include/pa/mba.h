@@ -0,0 +1,128 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_MBA_H
+#define PETANQUE_MBA_H
+
+#include <pa/exports.h>
+#include <pa/exprs.h>
+#include <pa/vector.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pa {
+
+// Word-level arithmetic over nbits bits words, represented as vectors of
+// nbits boolean expressions (element i being the bit i of the word).
+// Operations taking a constant use its nbits least significant bits.
+// Constants wider than 64 bits are given as Constant, the 64 bits overloads
+// being shortcuts for them. Vector arguments must be nbits long.
+//
+// Results are simplified as the operations go, and additions keep their
+// carries as ESFs if use_esf is set.
+class PA_API MBA
+{
+public:
+	// Unsigned integer of any width, as little-endian 64 bits words
+	typedef std::vector<uint64_t> Constant;
+
+public:
+	MBA(const size_t nbits);
+
+public:
+	inline size_t nbits() const { return _nbits; }
+
+	inline bool use_esf() const { return _use_esf; }
+	inline void set_use_esf(bool v) { _use_esf = v; }
+
+	// Add constants by propagating carries between whole words, instead of
+	// adding bit by bit (only used without ESFs)
+	inline bool use_opt_mba() const { return _use_opt_mba; }
+	inline void set_use_opt_mba(bool v) { _use_opt_mba = v; }
+
+public:
+	Vector cst(Constant const& n) const;
+	inline Vector cst(uint64_t n) const { return cst(Constant{n}); }
+	Vector var_symbols(std::string const& name) const;
+
+public:
+	Vector add_Y(Vector const& X, Vector const& Y) const;
+	void iadd_Y(Vector& X, Vector const& Y) const;
+	Vector add_n(Vector const& X, Constant const& n) const;
+	inline Vector add_n(Vector const& X, uint64_t n) const { return add_n(X, Constant{n}); }
+	void iadd_n(Vector& X, Constant const& n) const;
+	inline void iadd_n(Vector& X, uint64_t n) const { iadd_n(X, Constant{n}); }
+
+	// X += Y<<offset (as integers)
+	void iadd_lshifted_Y(Vector& X, Vector const& Y, const size_t offset) const;
+
+	Vector sub_Y(Vector const& X, Vector const& Y) const;
+	Vector sub_n(Vector const& X, Constant const& n) const;
+	inline Vector sub_n(Vector const& X, uint64_t n) const { return sub_n(X, Constant{n}); }
+
+	Vector mul_Y(Vector const& X, Vector const& Y) const;
+	Vector mul_n(Vector const& X, Constant const& n) const;
+	inline Vector mul_n(Vector const& X, uint64_t n) const { return mul_n(X, Constant{n}); }
+
+	// Unsigned division, as a multiplication by a magic number over 2*nbits+1
+	// bits followed by a right shift (see Hacker's Delight, chapter 10).
+	// Throws errors::DivisionByZero if n is 0.
+	Vector div_n(Vector const& X, Constant const& n) const;
+	inline Vector div_n(Vector const& X, uint64_t n) const { return div_n(X, Constant{n}); }
+
+	Vector not_X(Vector const& X) const;
+	Vector oppose_X(Vector const& X) const;
+
+	Vector and_n(Vector const& X, Constant const& n) const;
+	inline Vector and_n(Vector const& X, uint64_t n) const { return and_n(X, Constant{n}); }
+	Vector xor_n(Vector const& X, Constant const& n) const;
+	inline Vector xor_n(Vector const& X, uint64_t n) const { return xor_n(X, Constant{n}); }
+	Vector or_n(Vector const& X, Constant const& n) const;
+	inline Vector or_n(Vector const& X, uint64_t n) const { return or_n(X, Constant{n}); }
+	Vector or_Y(Vector const& X, Vector const& Y) const;
+
+	// Shifts of the integer X (towards its most significant bits for lshift_n)
+	Vector lshift_n(Vector const& X, const size_t n) const;
+	Vector rshift_n(Vector const& X, const size_t n) const;
+	Vector arshift_n(Vector const& X, const size_t n) const;
+	Vector rol_n(Vector const& X, const size_t n) const;
+	Vector ror_n(Vector const& X, const size_t n) const;
+
+private:
+	void check_size(Vector const& X) const;
+	Constant masked(Constant n) const;
+	void iadd_n_mba(Vector& X, Constant const& n) const;
+
+private:
+	size_t _nbits;
+	bool _use_esf;
+	bool _use_opt_mba;
+};
+
+}
+
+#endif
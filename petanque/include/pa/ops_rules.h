@@ -0,0 +1,132 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_OPS_RULES_H
+#define PETANQUE_OPS_RULES_H
+
+#include <pa/esf.h>
+#include <pa/exprs.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace pa {
+
+namespace __impl {
+
+// Rewrite rules applied when building the sum, product or OR of two
+// expressions. They are shared by the Expr operators and ExprPool, so that
+// both build the same normal forms, and work on any representation through
+// a builder B that provides:
+//  - arg_type and result_type, the types of the operands and the results
+//  - type(x), equal(x, y) and imm_value(x)
+//  - imm(v) and copy(x), to build an immediate or return an operand
+//  - esf_degree(x), nargs(x) and same_args(x, y), on ESFs
+//  - esf_product(x, deg), the product of the ESF x by the ESF of degree deg
+//    of the same arguments
+//  - make(type, x, y), the node (type x y)
+//  - merge(type, x, y), the node of type whose arguments are the ones of x
+//    (which has this type) and y (or y itself if it doesn't), that cancel
+//    each other for additions. It is simplified to an immediate or its only
+//    argument if needed.
+
+template <class B>
+inline void order_by_type(B const& b, typename B::arg_type& x, typename B::arg_type& y)
+{
+	if (b.type(x) > b.type(y)) {
+		std::swap(x, y);
+	}
+}
+
+template <class B>
+typename B::result_type or_(B const& b, typename B::arg_type x, typename B::arg_type y)
+{
+	if (b.equal(x, y)) {
+		return b.copy(x);
+	}
+	order_by_type(b, x, y);
+	if (b.type(y) == expr_type_id::imm_type) {
+		return b.imm_value(y) ? b.imm(true) : b.copy(x);
+	}
+	if (b.type(x) == expr_type_id::or_type) {
+		return b.merge(expr_type_id::or_type, x, y);
+	}
+	return b.make(expr_type_id::or_type, x, y);
+}
+
+template <class B>
+typename B::result_type add(B const& b, typename B::arg_type x, typename B::arg_type y)
+{
+	if (b.equal(x, y)) {
+		return b.imm(false);
+	}
+	order_by_type(b, x, y);
+	if (b.type(y) == expr_type_id::imm_type) {
+		if (b.type(x) == expr_type_id::imm_type) {
+			return b.imm(b.imm_value(x) != b.imm_value(y));
+		}
+		if (!b.imm_value(y)) {
+			return b.copy(x);
+		}
+	}
+	if (b.type(y) == expr_type_id::add_type) {
+		std::swap(x, y);
+	}
+	if (b.type(x) == expr_type_id::add_type) {
+		return b.merge(expr_type_id::add_type, x, y);
+	}
+	return b.make(expr_type_id::add_type, x, y);
+}
+
+template <class B>
+typename B::result_type mul(B const& b, typename B::arg_type x, typename B::arg_type y)
+{
+	if (b.equal(x, y)) {
+		return b.copy(x);
+	}
+	order_by_type(b, x, y);
+	if (b.type(y) == expr_type_id::imm_type) {
+		return b.imm_value(y) ? b.copy(x) : b.imm(false);
+	}
+	// Products of ESFs over the same arguments (additions being the ESFs of
+	// degree 1 of their arguments) are kept as sums of ESFs
+	if ((b.type(x) == expr_type_id::esf_type) &&
+	    ((b.type(y) == expr_type_id::esf_type) || (b.type(y) == expr_type_id::add_type))) {
+		const size_t deg = (b.type(y) == expr_type_id::esf_type) ? b.esf_degree(y) : 1;
+		if ((std::min(b.esf_degree(x)+deg, b.nargs(x)) <= esf_max_degree) && b.same_args(x, y)) {
+			return b.esf_product(x, deg);
+		}
+	}
+	if (b.type(x) == expr_type_id::mul_type) {
+		return b.merge(expr_type_id::mul_type, x, y);
+	}
+	return b.make(expr_type_id::mul_type, x, y);
+}
+
+} // __impl
+
+} // pa
+
+#endif
@@ -0,0 +1,52 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_PRODUCTS_H
+#define PETANQUE_PRODUCTS_H
+
+#include <pa/exports.h>
+#include <pa/exprs.h>
+
+namespace pa {
+
+typedef ExprArgs::vector_type ExprTerms;
+
+// Sorts terms in the order of the arguments of an ExprAdd. If cancel is true,
+// terms that appear an even number of times and null terms are removed, so
+// that the result is the simplified list of arguments of the sum of terms.
+//
+// Terms are first sorted with an LSD radix sort on 128-bit keys that respect
+// the order of expressions (the order of two terms with different keys is
+// the order of their keys), so that full comparisons are only made between
+// terms with the same key.
+PA_API void sort_terms(ExprTerms& terms, bool cancel);
+
+// Sorted and cancelled terms of (a_0 + ... + a_n)*(b_0 + ... + b_m), that
+// is the arguments of the expansion of this product
+PA_API ExprTerms expand_products(ExprArgs const& a, ExprArgs const& b);
+
+} // pa
+
+#endif
@@ -0,0 +1,169 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_SERIALIZE_H
+#define PETANQUE_SERIALIZE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <pa/exports.h>
+#include <pa/exprs.h>
+
+namespace pa {
+
+class Vector;
+class Matrix;
+class AffApp;
+class App;
+
+// Binary serialization of expressions, vectors, matrices and applications.
+//
+// All integers are little-endian. A file is made of:
+//  - a header (magic, version, kind of object, dimensions and the offsets of
+//    the following tables),
+//  - a symbol table, whose entries are either argument symbols or offsets
+//    into a blob of symbol names,
+//  - a node table, where each node refers to its arguments through a range
+//    of an argument table. Structurally equal subexpressions are stored only
+//    once, and arguments always come before the nodes using them,
+//  - the list of root nodes (the elements of the serialized object).
+//
+// Symbols are stored by name, and are mapped to the symbols of the loading
+// process.
+namespace serialize {
+
+enum class Kind: uint8_t {
+	Expr = 0,
+	Vector = 1,
+	Matrix = 2,
+	AffApp = 3,
+	App = 4
+};
+
+constexpr uint16_t version = 1;
+
+PA_API std::vector<uint8_t> dump(pa::Expr const& e);
+PA_API std::vector<uint8_t> dump(pa::Vector const& v);
+PA_API std::vector<uint8_t> dump(pa::Matrix const& m);
+PA_API std::vector<uint8_t> dump(pa::AffApp const& app);
+PA_API std::vector<uint8_t> dump(pa::App const& app);
+
+// Read-only view over serialized data, that is either mapped from a file or
+// owned by the caller. Nodes can be walked directly from the mapped memory,
+// and are only converted to Expr objects on demand.
+class PA_API Reader
+{
+public:
+	struct Node
+	{
+		expr_type_id type;
+		// Immediate value, index in the symbol table or ESF degree
+		uint32_t value;
+		uint32_t args_begin;
+		uint32_t nargs;
+	};
+
+public:
+	// Maps the file at path
+	explicit Reader(std::string const& path);
+	// View on data, which must outlive this object
+	Reader(void const* data, size_t size);
+	~Reader();
+
+	Reader(Reader const&) = delete;
+	Reader& operator=(Reader const&) = delete;
+
+public:
+	Kind kind() const { return _kind; }
+	// Number of lines and columns of matrices, and size of vectors
+	uint32_t nlines() const { return _nlines; }
+	uint32_t ncols() const { return _ncols; }
+
+	uint32_t nnodes() const { return _nnodes; }
+	uint32_t nroots() const { return _nroots; }
+	uint32_t nsymbols() const { return _nsyms; }
+
+	// These throw errors::InvalidFormat on out of bounds or corrupted
+	// entries
+	Node node(uint32_t idx) const;
+	uint32_t arg(Node const& n, uint32_t i) const;
+	uint32_t root(uint32_t i) const;
+	pa::ExprSym const& symbol(uint32_t idx) const;
+
+public:
+	pa::Expr expr(uint32_t node) const;
+
+	pa::Expr to_expr() const;
+	pa::Vector to_vector() const;
+	pa::Matrix to_matrix() const;
+	pa::AffApp to_affapp() const;
+	pa::App to_app() const;
+
+private:
+	void init();
+	void unmap();
+	void check_kind(Kind k) const;
+	pa::Vector roots(uint32_t begin, uint32_t end) const;
+	pa::Expr const& materialize(std::vector<pa::Expr>& memo, std::vector<bool>& done, uint32_t node) const;
+
+private:
+	uint8_t const* _data;
+	size_t _size;
+	void* _map;
+	Kind _kind;
+	uint32_t _nlines;
+	uint32_t _ncols;
+	uint32_t _nsyms;
+	uint32_t _nnodes;
+	uint32_t _nargs;
+	uint32_t _nroots;
+	uint8_t const* _syms;
+	uint8_t const* _nodes;
+	uint8_t const* _args;
+	uint8_t const* _roots;
+	std::vector<pa::ExprSym> _symbols;
+};
+
+PA_API pa::Expr load_expr(std::string const& path);
+PA_API pa::Vector load_vector(std::string const& path);
+PA_API pa::Matrix load_matrix(std::string const& path);
+PA_API pa::AffApp load_affapp(std::string const& path);
+PA_API pa::App load_app(std::string const& path);
+
+PA_API void write_file(std::string const& path, std::vector<uint8_t> const& data);
+
+template <class T>
+void save(std::string const& path, T const& o)
+{
+	write_file(path, dump(o));
+}
+
+} // serialize
+
+} // pa
+
+#endif
@@ -28,6 +28,10 @@
 
 #include <pa/exports.h>
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 namespace pa {
 
 class Expr;
@@ -36,6 +40,81 @@ class Matrix;
 
 namespace simps {
 
+// Global configuration of the simplification algorithms. It should not be
+// modified while a simplification is running.
+struct PA_API Config
+{
+	// Parallelism (only used if petanque has been compiled with TBB).
+	// Maximum number of threads to use (0 means TBB's default)
+	unsigned nthreads = 0;
+	// Minimum number of grand-children of a node for its children to be
+	// simplified in parallel
+	size_t grain_size = 64;
+	// Minimum number of partial products for them to be computed in parallel
+	// during expansion
+	size_t products_grain_size = 4096;
+
+	// Products of additions whose support has at most this number of
+	// symbols can be expanded by evaluating their truth table, if this is
+	// cheaper than computing all the partial products (0 disables it)
+	size_t truth_table_max_symbols = 20;
+
+	// Maximum number of products checked as candidate ORs in an addition by
+	// identify_ors (0 means no limit)
+	size_t identify_ors_max_candidates = 0;
+
+	// Maximum number of results kept by each of the caches of simplify and
+	// expand_esf, which return the cached result when called on the same
+	// expression again (0 disables them). They are cleared when
+	// truth_table_max_symbols or identify_ors_max_candidates change.
+	size_t cache_size = 0;
+
+	// Record the statistics of the rewrite rules and passes (see
+	// rules_stats). Only available if petanque has been compiled with
+	// SIMPS_STATS.
+	bool rules_stats = false;
+};
+
+PA_API Config& config();
+
+// Statistics of each rewrite rule used by simplify, and of the or_to_esf,
+// identify_ors and expand_esf passes, since the last reset. Only recorded
+// when Config::rules_stats is set. rules_stats returns an empty vector if
+// petanque has been compiled without SIMPS_STATS.
+struct RuleStats
+{
+	const char* name;
+	// Number of nodes the rule has been tried on, and has actually
+	// rewritten
+	uint64_t attempts;
+	uint64_t rewrites;
+	// Time spent in the rule, including the failed attempts
+	uint64_t time_ns;
+	// Total number of arguments (monomials for additions) of the rewritten
+	// nodes, before and after their rewrites, and largest rewritten node
+	uint64_t args_before;
+	uint64_t args_after;
+	uint64_t max_args;
+};
+
+PA_API std::vector<RuleStats> rules_stats();
+PA_API void reset_rules_stats();
+
+// Statistics of the caches of simplify and expand_esf (see
+// Config::cache_size)
+struct CacheStats
+{
+	const char* name;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	size_t size;
+};
+
+PA_API std::vector<CacheStats> caches_stats();
+// Removes every cached result, and resets the statistics
+PA_API void clear_caches();
+
 // return true iif changes have been made
 PA_API bool remove_dead_ops_no_rec(Expr& expr);
 PA_API bool remove_dead_ops(Expr& expr);
@@ -58,6 +137,8 @@ PA_API bool identify_ors_no_rec(Expr& e);
 PA_API bool identify_ors(Expr& e);
 
 // ESF
+PA_API bool esf_products_no_rec(Expr& e);
+PA_API bool esf_sums_no_rec(Expr& e);
 PA_API Expr& expand_esf(Expr& e);
 PA_API Vector& expand_esf(Vector& v);
 
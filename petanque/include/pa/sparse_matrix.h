@@ -0,0 +1,116 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_SPARSE_MATRIX_H
+#define PETANQUE_SPARSE_MATRIX_H
+
+#include <pa/exports.h>
+#include <pa/exprs.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace pa {
+
+class Matrix;
+class Vector;
+
+// Matrix of expressions that only stores its non zero entries, line by line
+// (compressed sparse row format). Entries of a line are sorted by column.
+class PA_API SparseMatrix
+{
+public:
+	typedef uint32_t col_type;
+
+public:
+	SparseMatrix():
+		_ncols(0),
+		_lines(1, 0)
+	{ }
+
+	// Zero matrix
+	SparseMatrix(const size_t nlines, const size_t ncols):
+		_ncols(ncols),
+		_lines(nlines+1, 0)
+	{ }
+
+	explicit SparseMatrix(Matrix const& m);
+
+public:
+	static SparseMatrix identity(const size_t n);
+
+	template <class F>
+	static SparseMatrix construct(size_t const nlines, size_t const ncols, F const& f)
+	{
+		SparseMatrix ret(0, ncols);
+		for (size_t i = 0; i < nlines; i++) {
+			for (size_t j = 0; j < ncols; j++) {
+				ret.push(j, f(i, j));
+			}
+			ret.end_line();
+		}
+		return ret;
+	}
+
+	Matrix to_matrix() const;
+
+public:
+	inline size_t nlines() const { return _lines.size()-1; }
+	inline size_t ncols() const { return _ncols; }
+	// Number of stored (non zero) entries
+	inline size_t nnz() const { return _values.size(); }
+
+	Expr at(const size_t line, const size_t col) const;
+
+	// Entries of line i are the ones of index [line_begin(i), line_end(i))
+	inline size_t line_begin(const size_t line) const { return _lines[line]; }
+	inline size_t line_end(const size_t line) const { return _lines[line+1]; }
+	inline size_t col_at(const size_t idx) const { return _cols[idx]; }
+	inline Expr const& value_at(const size_t idx) const { return _values[idx]; }
+
+public:
+	SparseMatrix operator+(SparseMatrix const& o) const;
+	SparseMatrix operator*(SparseMatrix const& o) const;
+	Vector       operator*(Vector const& o) const;
+
+	bool operator==(SparseMatrix const& o) const;
+	bool operator!=(SparseMatrix const& o) const { return !(*this == o); }
+
+private:
+	// Appends an entry to the last line (with columns in increasing order),
+	// if it isn't zero
+	void push(const size_t col, Expr&& e);
+	void end_line() { _lines.push_back(_values.size()); }
+
+private:
+	size_t _ncols;
+	std::vector<size_t> _lines;
+	std::vector<col_type> _cols;
+	std::vector<Expr> _values;
+};
+
+} // pa
+
+#endif
@@ -43,7 +43,7 @@ namespace __impl {
 template <class SC, class VC>
 bool vec_syms_vec_bits_to_bitfields(bitfield& bf_syms, bitfield& bf_values, SC const& syms, VC const& values)
 {
-	if (array_size(syms) != array_size(values)) {
+	if (static_cast<size_t>(array_size(syms)) != static_cast<size_t>(array_size(values))) {
 		return false;
 	}
 	bf_syms.reserve(array_size(syms));
@@ -71,7 +71,7 @@ bool vec_syms_vec_bits_to_bitfields(bitfield& bf_syms, bitfield& bf_values, SC c
 template <class VecC, class ValC>
 bool list_vec_syms_list_values_to_bitfields(bitfield& bf_syms, bitfield& bf_values, VecC const& vecs, ValC const& vec_values)
 {
-	if (array_size(vecs) != array_size(vec_values)) {
+	if (static_cast<size_t>(array_size(vecs)) != static_cast<size_t>(array_size(vec_values))) {
 		return false;
 	}
 	size_t nsyms = 0;
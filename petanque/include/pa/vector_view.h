@@ -0,0 +1,133 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef PETANQUE_VECTOR_VIEW_H
+#define PETANQUE_VECTOR_VIEW_H
+
+#include <pa/exports.h>
+#include <pa/exprs.h>
+#include <pa/vector.h>
+
+#include <cstddef>
+
+namespace pa {
+
+// Read-only view of a Vector whose elements are remapped, without copying
+// them. Element i of the view is element start+i*step of the viewed vector
+// (taken modulo its size for rotations), or a fill expression if this index
+// is out of the viewed vector.
+//
+// The viewed vector must outlive the view. The first write to the view
+// copies its elements into storage owned by the view (copy on write), and the
+// view doesn't reference the viewed vector anymore.
+class PA_API VectorView
+{
+public:
+	VectorView(Vector const& v);
+
+public:
+	// Views with the same elements as v<<n and v>>n, but for the fill
+	// expression which shifted in
+	static VectorView shift_left(Vector const& v, const size_t n, Expr const& fill = ExprImm(0));
+	static VectorView shift_right(Vector const& v, const size_t n, Expr const& fill = ExprImm(0));
+
+	// Element i is v[(i+n)%size] for rotate_left, and v[(i-n)%size] for
+	// rotate_right
+	static VectorView rotate_left(Vector const& v, const size_t n);
+	static VectorView rotate_right(Vector const& v, const size_t n);
+
+	// Elements of v followed by fill up to n elements (or the first n
+	// elements of v)
+	static VectorView extend(Vector const& v, const size_t n, Expr const& fill = ExprImm(0));
+
+	// size elements, from start, by step
+	static VectorView slice(Vector const& v, const size_t start, const size_t size, const ptrdiff_t step = 1);
+
+public:
+	inline size_t size() const { return _size; }
+	inline bool empty() const { return _size == 0; }
+
+	inline Expr const& at(const size_t i) const
+	{
+		assert(i < _size);
+		if (_src == nullptr) {
+			return _own.at(i);
+		}
+		const ptrdiff_t idx = src_idx(i);
+		if (idx < 0) {
+			return _fill;
+		}
+		return _src->at(idx);
+	}
+
+	Expr& at(const size_t i);
+
+	inline Expr const& operator[](const size_t i) const { return at(i); }
+	inline Expr& operator[](const size_t i) { return at(i); }
+
+	// Whether the elements have been copied by a write
+	inline bool copied() const { return _src == nullptr; }
+
+	Vector to_vector() const;
+	operator Vector() const { return to_vector(); }
+
+public:
+	Vector operator+(Vector const& o) const;
+	Vector operator*(Vector const& o) const;
+	Vector operator*(Expr const& e) const;
+
+	bool operator==(Vector const& o) const;
+	bool operator!=(Vector const& o) const { return !(*this == o); }
+
+private:
+	VectorView(Vector const& v, const size_t size, const ptrdiff_t start, const ptrdiff_t step, const bool wrap, Expr const& fill);
+
+	// Index in the viewed vector, or -1 for the fill expression
+	inline ptrdiff_t src_idx(const size_t i) const
+	{
+		const ptrdiff_t n = _src->size();
+		ptrdiff_t ret = _start + (ptrdiff_t)i*_step;
+		if (_wrap) {
+			ret %= n;
+			return ret < 0 ? ret+n : ret;
+		}
+		return (ret >= 0 && ret < n) ? ret : -1;
+	}
+
+	void copy();
+
+private:
+	Vector const* _src;
+	Vector _own;
+	Expr _fill;
+	size_t _size;
+	ptrdiff_t _start;
+	ptrdiff_t _step;
+	bool _wrap;
+};
+
+}
+
+#endif
@@ -23,13 +23,24 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <pa/algos.h>
 #include <pa/analyses.h>
+#include <pa/config.h>
 #include <pa/exprs.h>
+#include <pa/products.h>
 #include <pa/simps.h>
 #include <pa/vector.h>
 #include <pa/prettyprinter.h>
 
+#ifdef PA_USE_TBB
+#include <tbb/parallel_for.h>
+#endif
+
+#include <atomic>
+#include <limits>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 pa::analyses::UnknownSymbol::UnknownSymbol(Expr const& s)
 {
@@ -39,87 +50,95 @@ pa::analyses::UnknownSymbol::UnknownSymbol(Expr const& s)
 	_err = ss.str();
 }
 
-pa::App pa::analyses::vectorial_decomp(Vector const& symbols, Vector const& v)
+pa::analyses::VectorialDecomp pa::analyses::vectorial_decomp_bits(Vector const& symbols, Vector const& v)
 {
 	// Assume vector is sorted and simplified.
-	
-	//const size_t N = symbols.size();
 	const size_t N = v.size();
-	const size_t Ns = symbols.size();
-	pa::Matrix M(N, Ns, ExprImm(0));
-	pa::Vector vimm(N, ExprImm(0));
-	pa::Vector vlin(N, ExprAdd());
-	pa::Vector vnl(N, ExprAdd());
-	size_t i = 0;
-	for (Expr const& e: v) {
+	VectorialDecomp ret{BitMatrix(N, symbols.size()), Vector(N, ExprImm(0)), Vector(N, ExprImm(0))};
+
+	// Columns of the symbols (the first one if a symbol is there several
+	// times)
+	std::unordered_map<ExprSym::idx_type, size_t> columns;
+	columns.reserve(symbols.size());
+	for (size_t j = 0; j < symbols.size(); j++) {
+		if (symbols[j].is_sym()) {
+			columns.emplace(symbols[j].as<ExprSym>().idx(), j);
+		}
+	}
+	auto add_linear = [&ret, &columns](size_t i, Expr const& s) {
+		const auto it = columns.find(s.as<ExprSym>().idx());
+		if (it == columns.end()) {
+			throw UnknownSymbol(s);
+		}
+		ret.matrix.set(i, it->second, true);
+	};
+
+	// Lines only write to their own words of the matrix, and elements of
+	// the vectors, thus they can be processed concurrently
+	auto decomp_line = [&](size_t i) {
+		Expr const& e = v[i];
 		switch (e.type()) {
 		case pa::expr_type_id::imm_type:
-			vimm[i] = e;
+			ret.cst[i] = e;
 			break;
 
 		case pa::expr_type_id::symbol_type:
-			vlin[i].args().insert_dup(e);
+			add_linear(i, e);
 			break;
 
 		case pa::expr_type_id::add_type:
 		{
-			pa::ExprArgs::const_reverse_iterator it = e.args().rbegin();
-			pa::ExprArgs::const_reverse_iterator it_end = e.args().rend();
-			if (it == it_end) {
-				break;
+			// Arguments are sorted: non linear terms first, then symbols and
+			// the immediate
+			ExprTerms nl;
+			for (Expr const& a: e.args()) {
+				switch (a.type()) {
+				case pa::expr_type_id::imm_type:
+					ret.cst[i] = a;
+					break;
+				case pa::expr_type_id::symbol_type:
+					add_linear(i, a);
+					break;
+				default:
+					nl.push_back(a);
+					break;
+				};
 			}
-			if (it->type() == pa::expr_type_id::imm_type) {
-				vimm[i] = *it;
-				it++;
+			if (nl.size() == 1) {
+				ret.nl[i] = std::move(nl[0]);
 			}
-			for (; it != it_end; it++) {
-				if (it->type() == pa::expr_type_id::symbol_type) {
-					vlin[i].args().insert_dup(*it);
-				}
-				else {
-					vnl[i].args().insert_dup(*it);
-				}
+			else
+			if (nl.size() > 1) {
+				ret.nl[i] = ExprAdd(ExprArgs(true, std::move(nl)));
 			}
 			break;
 		}
 
 		case pa::expr_type_id::mul_type:
-		{
-			vnl[i].args() = e.args();
-			vnl[i].set_type(pa::expr_type_id::mul_type);
+			ret.nl[i] = e;
 			break;
-		}
 
 		default:
 			break;
 		};
-		i++;
-	}
+	};
 
-	i = 0;
-	for (Expr const& e: vlin) {
-		for (Expr const& s: e.args()) {
-			const ssize_t j = find_expr_idx(symbols, s);
-			if (j == -1) {
-				throw UnknownSymbol(s);
-			}
-			M.at(i, j) = ExprImm(1);
-		}
-		i++;
+#ifdef PA_USE_TBB
+	tbb::parallel_for(size_t{0}, N, decomp_line);
+#else
+	for (size_t i = 0; i < N; i++) {
+		decomp_line(i);
 	}
+#endif
 
-    for (Expr& e: vnl) {
-        if (e.nargs() == 0) {
-            e = ExprImm(0);
-        }
-        else
-        if (e.nargs() == 1) {
-            e = std::move(e.args()[0]);
-        }
-    }
+	return ret;
+}
 
-	pa::AffApp aff(std::move(M), std::move(vimm));
-	return pa::App(pa::VectorApp(symbols, vnl), std::move(aff));
+pa::App pa::analyses::vectorial_decomp(Vector const& symbols, Vector const& v)
+{
+	VectorialDecomp decomp = vectorial_decomp_bits(symbols, v);
+	pa::AffApp aff(decomp.matrix.to_matrix(), std::move(decomp.cst));
+	return pa::App(pa::VectorApp(symbols, decomp.nl), std::move(aff));
 }
 
 pa::Vector::const_iterator pa::analyses::find_expr(Vector const& v, Expr const& e)
@@ -131,3 +150,300 @@ ssize_t pa::analyses::find_expr_idx(Vector const& v, Expr const& e)
 {
 	return find_expr_idx(v.begin(), v.end(), e);
 }
+
+namespace {
+
+// Products of symbols, as the sorted list of the indexes of their symbols in
+// EsfFinder::_syms
+typedef std::vector<uint32_t> Monomial;
+
+struct MonomialHash
+{
+	size_t operator()(Monomial const& k) const
+	{
+		uint64_t ret = k.size();
+		for (uint32_t v: k) {
+			ret = (ret ^ v)*0x100000001B3ULL;
+		}
+		return ret;
+	}
+};
+
+typedef std::unordered_set<Monomial, MonomialHash> MonomialsSet;
+
+// C(n, k), saturated to the maximum value of uint64_t
+uint64_t binomial(uint64_t n, uint64_t k)
+{
+	if (k > n) {
+		return 0;
+	}
+	k = std::min(k, n-k);
+	uint64_t ret = 1;
+	for (uint64_t i = 1; i <= k; i++) {
+		const uint64_t f = n-k+i;
+		if (ret > std::numeric_limits<uint64_t>::max()/f) {
+			return std::numeric_limits<uint64_t>::max();
+		}
+		ret = (ret*f)/i;
+	}
+	return ret;
+}
+
+// Searches for ESFs in an ANF expression. An ESF of degree d over A symbols
+// is in the expression iif all the products of d of these symbols are. This
+// is a clique in the hypergraph whose edges are the products of d symbols
+// of the expression, which is searched by backtracking. A symbol can only be
+// in such a clique if it appears in at least C(A-1, d-1) products (see
+// SymbolsHist), which prunes most of the candidates.
+class EsfFinder
+{
+public:
+	EsfFinder(pa::Expr const& e)
+	{
+		for (pa::Expr const& a: e.args()) {
+			if (a.is_mul()) {
+				for (pa::Expr const& s: a.args()) {
+					_ids.emplace(s.as<pa::ExprSym>().idx(), 0);
+				}
+			}
+		}
+		// Keep the order of the symbols
+		_syms.reserve(_ids.size());
+		for (auto const& it: _ids) {
+			_syms.push_back(it.first);
+		}
+		std::sort(_syms.begin(), _syms.end());
+		for (uint32_t i = 0; i < _syms.size(); i++) {
+			_ids[_syms[i]] = i;
+		}
+	}
+
+public:
+	// Finds all the ESFs of degree d in e, and removes their monomials from
+	// the index of this degree
+	void find_degree(pa::Expr const& e, const unsigned d, std::vector<pa::Expr>& esfs)
+	{
+		_monos.clear();
+		_counts.assign(_syms.size(), 0);
+		for (pa::Expr const& a: e.args()) {
+			if (a.is_mul() && a.nargs() == d) {
+				Monomial m = monomial(a);
+				for (uint32_t s: m) {
+					_counts[s]++;
+				}
+				_monos.emplace(std::move(m));
+			}
+		}
+
+		Monomial found;
+		while (find_one(d, found)) {
+			pa::ExprArgs args;
+			args.reserve(found.size());
+			for (uint32_t s: found) {
+				args.insert_dup(pa::ExprSym(_syms[s]));
+			}
+			esfs.emplace_back(pa::ExprESF(d, std::move(args)));
+
+			pa::draw_without_replacement<size_t>(d, found.size(),
+				[&](size_t const* idxes, size_t const n)
+				{
+					Monomial m(n);
+					for (size_t i = 0; i < n; i++) {
+						m[i] = found[idxes[i]];
+						_counts[m[i]]--;
+					}
+					_monos.erase(m);
+					_removed.emplace(std::move(m));
+					return true;
+				});
+		}
+	}
+
+	bool removed(pa::Expr const& mul) const
+	{
+		return _removed.count(monomial(mul)) > 0;
+	}
+
+private:
+	Monomial monomial(pa::Expr const& mul) const
+	{
+		Monomial ret;
+		ret.reserve(mul.nargs());
+		for (pa::Expr const& s: mul.args()) {
+			ret.push_back(_ids.at(s.as<pa::ExprSym>().idx()));
+		}
+		// The order of the arguments of a product is the one of the
+		// indexes of their symbols, and thus the one of _syms
+		assert(std::is_sorted(ret.begin(), ret.end()));
+		return ret;
+	}
+
+	// Finds the biggest ESF of degree d
+	bool find_one(const unsigned d, Monomial& ret) const
+	{
+		// The number of symbols A of the ESF is at most the biggest A such
+		// that C(A, d) is lower or equal to the number of products
+		const uint64_t nmonos = _monos.size();
+		size_t max_args = d;
+		while (binomial(max_args+1, d) <= nmonos) {
+			max_args++;
+		}
+		for (size_t A = max_args; A > d; A--) {
+			const uint64_t min_count = binomial(A-1, d-1);
+			std::vector<uint32_t> cands;
+			for (uint32_t s = 0; s < _counts.size(); s++) {
+				if (_counts[s] >= min_count) {
+					cands.push_back(s);
+				}
+			}
+			if (cands.size() < A) {
+				continue;
+			}
+			if (find_clique(d, A, cands, ret)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Finds A symbols among cands whose products of d symbols are all in
+	// the index. The search is split on the first symbol of the clique, and
+	// the clique with the smallest first symbol is returned.
+	bool find_clique(const unsigned d, const size_t A, std::vector<uint32_t> const& cands, Monomial& ret) const
+	{
+		const size_t n = cands.size()-A+1;
+		std::vector<Monomial> found(n);
+		std::atomic<size_t> first(n);
+		auto search_from = [&](size_t i) {
+			if (i > first.load(std::memory_order_relaxed)) {
+				return;
+			}
+			Monomial cur{cands[i]};
+			std::vector<uint32_t> next(cands.begin()+i+1, cands.end());
+			filter(d, cur, next);
+			if (search(d, A, cur, next, [&first, i]() { return first.load(std::memory_order_relaxed) < i; })) {
+				found[i] = std::move(cur);
+				size_t cur_first = first.load();
+				while (i < cur_first && !first.compare_exchange_weak(cur_first, i));
+			}
+		};
+#ifdef PA_USE_TBB
+		tbb::parallel_for(size_t{0}, n, search_from);
+#else
+		for (size_t i = 0; i < n && first.load() == n; i++) {
+			search_from(i);
+		}
+#endif
+		if (first.load() == n) {
+			return false;
+		}
+		ret = std::move(found[first.load()]);
+		return true;
+	}
+
+	// Extends the clique cur up to A symbols, with symbols taken from cands
+	// (which are the symbols that can be added to cur)
+	template <class Stop>
+	bool search(const unsigned d, const size_t A, Monomial& cur, std::vector<uint32_t> const& cands, Stop const& stop) const
+	{
+		if (cur.size() == A) {
+			return true;
+		}
+		for (size_t i = 0; i < cands.size(); i++) {
+			if ((cur.size() + cands.size() - i < A) || stop()) {
+				return false;
+			}
+			cur.push_back(cands[i]);
+			std::vector<uint32_t> next(cands.begin()+i+1, cands.end());
+			filter(d, cur, next);
+			if (search(d, A, cur, next, stop)) {
+				return true;
+			}
+			cur.pop_back();
+		}
+		return false;
+	}
+
+	// Removes from cands the symbols c such that a product of c, of the last
+	// symbol s of cur and of d-2 other symbols of cur isn't in the index.
+	// Products that don't involve s have already been checked before s was
+	// added.
+	void filter(const unsigned d, Monomial const& cur, std::vector<uint32_t>& cands) const
+	{
+		const size_t nprev = cur.size()-1;
+		if (nprev+2 < d) {
+			return;
+		}
+		Monomial key(d);
+		auto it = std::remove_if(cands.begin(), cands.end(),
+			[&](uint32_t c) {
+				if (d == 2) {
+					key[0] = cur.back();
+					key[1] = c;
+					return _monos.count(key) == 0;
+				}
+				bool valid = true;
+				pa::draw_without_replacement<size_t>(d-2, nprev,
+					[&](size_t const* idxes, size_t const n)
+					{
+						for (size_t i = 0; i < n; i++) {
+							key[i] = cur[idxes[i]];
+						}
+						key[n] = cur.back();
+						key[n+1] = c;
+						std::sort(key.begin(), key.end());
+						valid = _monos.count(key) > 0;
+						return valid;
+					});
+				return !valid;
+			});
+		cands.erase(it, cands.end());
+	}
+
+private:
+	std::unordered_map<pa::ExprSym::idx_type, uint32_t> _ids;
+	std::vector<pa::ExprSym::idx_type> _syms;
+	// Products of the degree being searched that are still in the expression
+	MonomialsSet _monos;
+	std::vector<uint64_t> _counts;
+	// Products that are part of the ESFs found
+	MonomialsSet _removed;
+};
+
+} // anonymous
+
+std::vector<pa::Expr> pa::analyses::find_esfs(Expr& e)
+{
+	std::vector<Expr> ret;
+	if (!e.is_anf()) {
+		return ret;
+	}
+
+	EsfFinder finder(e);
+	for (unsigned d = e.anf_esf_max_degree(); d >= 2; d--) {
+		finder.find_degree(e, d, ret);
+	}
+	if (ret.empty()) {
+		return ret;
+	}
+
+	ExprAdd rest;
+	ExprArgs& args = rest.args();
+	args.reserve(e.nargs());
+	for (Expr& a: e.args()) {
+		if (!a.is_mul() || !finder.removed(a)) {
+			args.insert_dup(std::move(a));
+		}
+	}
+	if (args.size() == 0) {
+		e = ExprImm(0);
+	}
+	else {
+		e = std::move(rest);
+		e.fix_unary();
+	}
+	for (Expr const& esf: ret) {
+		e = e + esf;
+	}
+	return ret;
+}
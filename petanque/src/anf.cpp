@@ -0,0 +1,682 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/anf.h>
+#include <pa/bitsliced.h>
+#include <pa/cast.h>
+#include <pa/compat.h>
+#include <pa/config.h>
+#include <pa/simps.h>
+#include <pa/vector.h>
+
+#ifdef PA_USE_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <limits>
+
+constexpr size_t pa::ANF::max_symbols;
+constexpr size_t pa::ANF::max_truth_table_symbols;
+
+namespace {
+
+typedef pa::ANF::word_type word_type;
+
+size_t words_for(size_t nsyms)
+{
+	return std::max(size_t{1}, (nsyms + pa::ANF::word_bits - 1)/pa::ANF::word_bits);
+}
+
+unsigned mono_degree(word_type const* m, size_t nw)
+{
+	unsigned ret = 0;
+	for (size_t i = 0; i < nw; i++) {
+		ret += pa::popcount64(m[i]);
+	}
+	return ret;
+}
+
+// Monomials are sorted like the arguments of an ExprAdd: ExprMul objects
+// first (by degree), then symbols and finally the constant 1.
+inline unsigned mono_rank(unsigned degree)
+{
+	if (degree >= 2) {
+		return degree;
+	}
+	return std::numeric_limits<unsigned>::max() - 1 + (1 - degree);
+}
+
+// Compare two monomials of the same degree. Among the symbols they do not
+// share, the smallest one comes first in the monomial that has it.
+inline bool mono_less_same_rank(word_type const* a, word_type const* b, size_t nw)
+{
+	for (size_t i = 0; i < nw; i++) {
+		const word_type d = a[i] ^ b[i];
+		if (d) {
+			return (a[i] & (d & (~d + 1))) != 0;
+		}
+	}
+	return false;
+}
+
+inline bool mono_equal(word_type const* a, word_type const* b, size_t nw)
+{
+	return std::equal(a, a+nw, b);
+}
+
+inline bool mono_less(word_type const* a, word_type const* b, size_t nw)
+{
+	const unsigned ra = mono_rank(mono_degree(a, nw));
+	const unsigned rb = mono_rank(mono_degree(b, nw));
+	if (ra != rb) {
+		return ra < rb;
+	}
+	return mono_less_same_rank(a, b, nw);
+}
+
+bool strictly_sorted(std::vector<word_type> const& monos, size_t nw)
+{
+	for (size_t i = nw; i < monos.size(); i += nw) {
+		if (!mono_less(&monos[i-nw], &monos[i], nw)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template <class Iterator, class Compare>
+void sort_keys(Iterator begin, Iterator end, Compare const& cmp, bool parallel)
+{
+#ifdef PA_USE_TBB
+	if (parallel) {
+		tbb::parallel_sort(begin, end, cmp);
+		return;
+	}
+#else
+	(void)parallel;
+#endif
+	std::sort(begin, end, cmp);
+}
+
+// Sort monomials (stored consecutively with a stride of nw words) and cancel
+// the ones that appear an even number of times.
+std::vector<word_type> sort_and_cancel(std::vector<word_type> const& monos, size_t nw, bool parallel = false)
+{
+	const size_t n = monos.size()/nw;
+	std::vector<word_type> ret;
+	if (nw == 1) {
+		std::vector<std::pair<unsigned, word_type>> keys;
+		keys.reserve(n);
+		for (word_type m: monos) {
+			keys.emplace_back(mono_rank(pa::popcount64(m)), m);
+		}
+		sort_keys(keys.begin(), keys.end(),
+			[](std::pair<unsigned, word_type> const& a, std::pair<unsigned, word_type> const& b)
+			{
+				if (a.first != b.first) {
+					return a.first < b.first;
+				}
+				return mono_less_same_rank(&a.second, &b.second, 1);
+			}, parallel);
+		ret.reserve(n);
+		for (size_t i = 0; i < n; ) {
+			size_t j = i+1;
+			while (j < n && keys[j].second == keys[i].second) {
+				j++;
+			}
+			if ((j-i) & 1) {
+				ret.push_back(keys[i].second);
+			}
+			i = j;
+		}
+		return ret;
+	}
+
+	std::vector<std::pair<unsigned, uint32_t>> keys;
+	keys.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		keys.emplace_back(mono_rank(mono_degree(&monos[i*nw], nw)), (uint32_t)i);
+	}
+	sort_keys(keys.begin(), keys.end(),
+		[&monos, nw](std::pair<unsigned, uint32_t> const& a, std::pair<unsigned, uint32_t> const& b)
+		{
+			if (a.first != b.first) {
+				return a.first < b.first;
+			}
+			return mono_less_same_rank(&monos[a.second*nw], &monos[b.second*nw], nw);
+		}, parallel);
+	ret.reserve(monos.size());
+	for (size_t i = 0; i < n; ) {
+		word_type const* cur = &monos[keys[i].second*nw];
+		size_t j = i+1;
+		while (j < n && mono_equal(&monos[keys[j].second*nw], cur, nw)) {
+			j++;
+		}
+		if ((j-i) & 1) {
+			ret.insert(ret.end(), cur, cur+nw);
+		}
+		i = j;
+	}
+	return ret;
+}
+
+size_t truth_table_words(size_t nsyms)
+{
+	return nsyms <= 6 ? 1 : size_t{1} << (nsyms-6);
+}
+
+// Bits of a truth table word whose index has bit i set, for i < 6
+const word_type tt_patterns[6] = {
+	0xAAAAAAAAAAAAAAAAULL,
+	0xCCCCCCCCCCCCCCCCULL,
+	0xF0F0F0F0F0F0F0F0ULL,
+	0xFF00FF00FF00FF00ULL,
+	0xFFFF0000FFFF0000ULL,
+	0xFFFFFFFF00000000ULL
+};
+
+// In-place Moebius transform of a truth table of nsyms symbols, which turns
+// the truth table of a function into the coefficients of its ANF (and
+// conversely): coefficient x is the XOR of the values of the function on
+// the subsets of x. The loops are simple enough to be vectorized.
+void moebius(word_type* tt, size_t nsyms)
+{
+	const size_t nw = truth_table_words(nsyms);
+	for (size_t i = 0; i < std::min(nsyms, size_t{6}); i++) {
+		const unsigned shift = 1U << i;
+		const word_type mask = tt_patterns[i];
+		for (size_t w = 0; w < nw; w++) {
+			tt[w] ^= (tt[w] << shift) & mask;
+		}
+	}
+	for (size_t step = 1; step < nw; step <<= 1) {
+		for (size_t base = 0; base < nw; base += 2*step) {
+			word_type* const lo = &tt[base];
+			word_type* const hi = &tt[base+step];
+			for (size_t w = 0; w < step; w++) {
+				hi[w] ^= lo[w];
+			}
+		}
+	}
+}
+
+} // anonymous
+
+pa::ANF::ANF():
+	_nwords(1)
+{ }
+
+pa::ANF::ANF(std::vector<idx_type> syms):
+	_syms(std::move(syms)),
+	_nwords(words_for(_syms.size()))
+{
+	assert(std::is_sorted(_syms.begin(), _syms.end()));
+}
+
+bool pa::ANF::is_anf(Expr const& e)
+{
+	switch (e.type()) {
+		case expr_type_id::imm_type:
+		case expr_type_id::symbol_type:
+			return true;
+		case expr_type_id::mul_type:
+			return std::all_of(e.args().begin(), e.args().end(), [](Expr const& a) { return a.is_sym(); });
+		case expr_type_id::add_type:
+			return e.is_anf();
+		default:
+			break;
+	};
+	return false;
+}
+
+void pa::ANF::support(Expr const& e, std::vector<idx_type>& syms)
+{
+	const size_t org = syms.size();
+	auto add_sym = [&syms](Expr const& s) { syms.push_back(expr_assert_cast<ExprSym const&>(s).idx()); };
+	auto add_mono = [&add_sym](Expr const& m) {
+		if (m.is_sym()) {
+			add_sym(m);
+		}
+		else
+		if (m.is_mul()) {
+			for (Expr const& s: m.args()) {
+				add_sym(s);
+			}
+		}
+	};
+	if (e.is_add()) {
+		for (Expr const& a: e.args()) {
+			add_mono(a);
+		}
+	}
+	else {
+		add_mono(e);
+	}
+	if (syms.size() == org) {
+		return;
+	}
+	std::sort(syms.begin()+org, syms.end());
+	std::inplace_merge(syms.begin(), syms.begin()+org, syms.end());
+	syms.erase(std::unique(syms.begin(), syms.end()), syms.end());
+}
+
+bool pa::ANF::push_monomial(Expr const& e)
+{
+	const size_t off = _monos.size();
+	_monos.resize(off + _nwords, 0);
+	word_type* m = &_monos[off];
+	auto set_sym = [this, m](Expr const& s) {
+		const idx_type idx = expr_assert_cast<ExprSym const&>(s).idx();
+		auto it = std::lower_bound(_syms.begin(), _syms.end(), idx);
+		if (it == _syms.end() || *it != idx) {
+			return false;
+		}
+		const size_t bit = std::distance(_syms.begin(), it);
+		m[bit/word_bits] |= word_type{1} << (bit%word_bits);
+		return true;
+	};
+	switch (e.type()) {
+		case expr_type_id::imm_type:
+			if (!expr_assert_cast<ExprImm const&>(e).value()) {
+				_monos.resize(off);
+			}
+			return true;
+		case expr_type_id::symbol_type:
+			return set_sym(e);
+		case expr_type_id::mul_type:
+			for (Expr const& s: e.args()) {
+				if (!set_sym(s)) {
+					return false;
+				}
+			}
+			return true;
+		default:
+			break;
+	};
+	return false;
+}
+
+bool pa::ANF::from_expr(Expr const& e, ANF& ret)
+{
+	if (!is_anf(e)) {
+		return false;
+	}
+	std::vector<idx_type> syms;
+	support(e, syms);
+	return from_expr(e, syms, ret);
+}
+
+bool pa::ANF::from_expr(Expr const& e, std::vector<idx_type> const& syms, ANF& ret)
+{
+	if (syms.size() > max_symbols || !is_anf(e)) {
+		return false;
+	}
+	ret = ANF{syms};
+	if (e.is_add()) {
+		// Arguments are expected to be sorted, and are already in our order.
+		ret._monos.reserve(e.nargs()*ret._nwords);
+		for (Expr const& a: e.args()) {
+			if (!ret.push_monomial(a)) {
+				return false;
+			}
+		}
+		if (!strictly_sorted(ret._monos, ret._nwords)) {
+			ret._monos = sort_and_cancel(ret._monos, ret._nwords);
+		}
+		return true;
+	}
+	return ret.push_monomial(e);
+}
+
+void pa::ANF::full_support(Expr const& e, std::vector<idx_type>& syms)
+{
+	const size_t org = syms.size();
+	std::vector<Expr const*> stack{&e};
+	while (!stack.empty()) {
+		Expr const& cur = *stack.back();
+		stack.pop_back();
+		if (cur.is_sym()) {
+			syms.push_back(expr_assert_cast<ExprSym const&>(cur).idx());
+		}
+		else
+		if (cur.has_args()) {
+			for (Expr const& a: cur.args()) {
+				stack.push_back(&a);
+			}
+		}
+	}
+	if (syms.size() == org) {
+		return;
+	}
+	std::sort(syms.begin()+org, syms.end());
+	std::inplace_merge(syms.begin(), syms.begin()+org, syms.end());
+	syms.erase(std::unique(syms.begin(), syms.end()), syms.end());
+}
+
+std::vector<pa::ANF::word_type> pa::ANF::truth_table(Expr const* begin, Expr const* end, std::vector<idx_type> const& syms)
+{
+	const size_t nsyms = syms.size();
+	assert(nsyms <= max_truth_table_symbols);
+	const size_t nw = truth_table_words(nsyms);
+	std::vector<word_type> ret(nw, ~word_type{0});
+	const size_t nfactors = std::distance(begin, end);
+	if (nfactors == 0) {
+		return ret;
+	}
+
+	Vector outputs(nfactors);
+	std::copy(begin, end, outputs.begin());
+	Vector inputs(nsyms);
+	std::vector<word_type> in(nsyms*nw);
+	for (size_t i = 0; i < nsyms; i++) {
+		inputs[i] = ExprSym{syms[i]};
+		word_type* plane = &in[i*nw];
+		if (i < 6) {
+			std::fill(plane, plane+nw, tt_patterns[i]);
+		}
+		else {
+			for (size_t w = 0; w < nw; w++) {
+				plane[w] = ((w >> (i-6)) & 1) ? ~word_type{0} : 0;
+			}
+		}
+	}
+
+	BitslicedEvaluator ev(outputs, inputs);
+	std::vector<word_type> out(nfactors*nw);
+	ev.eval_planes(in.data(), &out[0], nw);
+	for (size_t f = 0; f < nfactors; f++) {
+		word_type const* plane = &out[f*nw];
+		for (size_t w = 0; w < nw; w++) {
+			ret[w] &= plane[w];
+		}
+	}
+	return ret;
+}
+
+pa::ANF pa::ANF::from_truth_table(std::vector<idx_type> syms, std::vector<word_type> tt)
+{
+	const size_t nsyms = syms.size();
+	assert(nsyms <= max_truth_table_symbols);
+	assert(tt.size() == truth_table_words(nsyms));
+	moebius(&tt[0], nsyms);
+	if (nsyms < 6) {
+		tt[0] &= (word_type{1} << (size_t{1} << nsyms)) - 1;
+	}
+
+	ANF ret{std::move(syms)};
+	// Monomials are bitmasks over the symbols, that is the indexes of the
+	// non null coefficients
+	for (size_t w = 0; w < tt.size(); w++) {
+		word_type v = tt[w];
+		while (v) {
+			ret._monos.push_back(w*word_bits + ctz64(v));
+			v &= v-1;
+		}
+	}
+	ret._monos = sort_and_cancel(ret._monos, 1);
+	return ret;
+}
+
+bool pa::ANF::from_expr_truth_table(Expr const& e, ANF& ret, size_t max_syms)
+{
+	std::vector<idx_type> syms;
+	full_support(e, syms);
+	if (syms.size() > std::min(max_syms, max_truth_table_symbols)) {
+		return false;
+	}
+	std::vector<word_type> tt = truth_table(&e, &e+1, syms);
+	ret = from_truth_table(std::move(syms), std::move(tt));
+	return true;
+}
+
+pa::Expr pa::ANF::monomial_expr(size_t i) const
+{
+	word_type const* m = monomial(i);
+	ExprArgs::vector_type syms;
+	for (size_t w = 0; w < _nwords; w++) {
+		word_type v = m[w];
+		while (v) {
+			syms.emplace_back(ExprSym{_syms[w*word_bits + ctz64(v)]});
+			v &= v-1;
+		}
+	}
+	switch (syms.size()) {
+		case 0:
+			return ExprImm{1};
+		case 1:
+			return std::move(syms[0]);
+		default:
+			break;
+	};
+	// Symbols are sorted by construction
+	return Expr{expr_type_id::mul_type, Expr::ExprArgsStorage{ExprArgs(true, std::move(syms))}};
+}
+
+pa::Expr pa::ANF::to_expr_add() const
+{
+	const size_t n = nmonomials();
+	ExprArgs::vector_type args;
+	args.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		args.emplace_back(monomial_expr(i));
+	}
+	return Expr{expr_type_id::add_type, Expr::ExprArgsStorage{ExprArgs(true, std::move(args))}};
+}
+
+pa::Expr pa::ANF::to_expr() const
+{
+	switch (nmonomials()) {
+		case 0:
+			return ExprImm{0};
+		case 1:
+			return monomial_expr(0);
+		default:
+			break;
+	};
+	return to_expr_add();
+}
+
+unsigned pa::ANF::degree() const
+{
+	// Products are sorted by degree, and are followed by symbols and the
+	// constant 1.
+	unsigned ret = 0;
+	for (size_t i = nmonomials(); i > 0; i--) {
+		const unsigned d = mono_degree(monomial(i-1), _nwords);
+		if (d >= 2) {
+			return d;
+		}
+		ret = std::max(ret, d);
+	}
+	return ret;
+}
+
+void pa::ANF::rebase(std::vector<idx_type> const& syms)
+{
+	assert(std::is_sorted(syms.begin(), syms.end()));
+	if (syms == _syms) {
+		return;
+	}
+
+	// New position of each of our symbols
+	std::vector<size_t> pos;
+	pos.reserve(_syms.size());
+	for (idx_type s: _syms) {
+		auto it = std::lower_bound(syms.begin(), syms.end(), s);
+		assert(it != syms.end() && *it == s);
+		pos.push_back(std::distance(syms.begin(), it));
+	}
+
+	const size_t nw = words_for(syms.size());
+	const size_t n = nmonomials();
+	std::vector<word_type> monos(n*nw, 0);
+	for (size_t i = 0; i < n; i++) {
+		word_type const* m = monomial(i);
+		word_type* nm = &monos[i*nw];
+		for (size_t w = 0; w < _nwords; w++) {
+			word_type v = m[w];
+			while (v) {
+				const size_t p = pos[w*word_bits + ctz64(v)];
+				nm[p/word_bits] |= word_type{1} << (p%word_bits);
+				v &= v-1;
+			}
+		}
+	}
+
+	// The relative order of our symbols is unchanged, and so is the order of
+	// the monomials.
+	_syms = syms;
+	_nwords = nw;
+	_monos = std::move(monos);
+}
+
+pa::ANF pa::ANF::add_same_support(ANF const& a, ANF const& b)
+{
+	assert(a._syms == b._syms);
+	const size_t nw = a._nwords;
+	const size_t na = a.nmonomials();
+	const size_t nb = b.nmonomials();
+	ANF ret{a._syms};
+	ret._monos.reserve((na+nb)*nw);
+	size_t ia = 0;
+	size_t ib = 0;
+	while (ia < na && ib < nb) {
+		word_type const* ma = a.monomial(ia);
+		word_type const* mb = b.monomial(ib);
+		const unsigned ra = mono_rank(mono_degree(ma, nw));
+		const unsigned rb = mono_rank(mono_degree(mb, nw));
+		if (ra < rb || (ra == rb && mono_less_same_rank(ma, mb, nw))) {
+			ret._monos.insert(ret._monos.end(), ma, ma+nw);
+			ia++;
+		}
+		else
+		if (ra == rb && mono_equal(ma, mb, nw)) {
+			ia++;
+			ib++;
+		}
+		else {
+			ret._monos.insert(ret._monos.end(), mb, mb+nw);
+			ib++;
+		}
+	}
+	ret._monos.insert(ret._monos.end(), a._monos.begin() + ia*nw, a._monos.end());
+	ret._monos.insert(ret._monos.end(), b._monos.begin() + ib*nw, b._monos.end());
+	return ret;
+}
+
+pa::ANF pa::ANF::mul_same_support(ANF const& a, ANF const& b)
+{
+	assert(a._syms == b._syms);
+	const size_t nw = a._nwords;
+	const size_t na = a.nmonomials();
+	const size_t nb = b.nmonomials();
+	std::vector<word_type> prods(na*nb*nw);
+	auto mul_rows = [&](size_t begin, size_t end) {
+		word_type* p = prods.data() + begin*nb*nw;
+		for (size_t ia = begin; ia < end; ia++) {
+			word_type const* ma = a.monomial(ia);
+			for (size_t ib = 0; ib < nb; ib++) {
+				word_type const* mb = b.monomial(ib);
+				for (size_t w = 0; w < nw; w++) {
+					p[w] = ma[w] | mb[w];
+				}
+				p += nw;
+			}
+		}
+	};
+	const bool parallel = na*nb >= simps::config().products_grain_size;
+#ifdef PA_USE_TBB
+	if (parallel) {
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, na),
+			[&mul_rows](tbb::blocked_range<size_t> const& r) { mul_rows(r.begin(), r.end()); });
+	}
+	else
+#endif
+	{
+		mul_rows(0, na);
+	}
+	ANF ret{a._syms};
+	ret._monos = sort_and_cancel(prods, nw, parallel);
+	return ret;
+}
+
+static std::vector<pa::ANF::idx_type> union_support(std::vector<pa::ANF::idx_type> const& a, std::vector<pa::ANF::idx_type> const& b)
+{
+	std::vector<pa::ANF::idx_type> ret;
+	ret.reserve(a.size() + b.size());
+	std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(ret));
+	return ret;
+}
+
+pa::ANF pa::ANF::operator+(ANF const& o) const
+{
+	if (_syms == o._syms) {
+		return add_same_support(*this, o);
+	}
+	const auto syms = union_support(_syms, o._syms);
+	ANF a{*this};
+	ANF b{o};
+	a.rebase(syms);
+	b.rebase(syms);
+	return add_same_support(a, b);
+}
+
+pa::ANF pa::ANF::operator*(ANF const& o) const
+{
+	if (_syms == o._syms) {
+		return mul_same_support(*this, o);
+	}
+	const auto syms = union_support(_syms, o._syms);
+	ANF a{*this};
+	ANF b{o};
+	a.rebase(syms);
+	b.rebase(syms);
+	return mul_same_support(a, b);
+}
+
+pa::ANF& pa::ANF::operator+=(ANF const& o)
+{
+	*this = *this + o;
+	return *this;
+}
+
+pa::ANF& pa::ANF::operator*=(ANF const& o)
+{
+	*this = *this * o;
+	return *this;
+}
+
+bool pa::ANF::operator==(ANF const& o) const
+{
+	if (_syms == o._syms) {
+		return _monos == o._monos;
+	}
+	return (*this + o).is_zero();
+}
@@ -0,0 +1,161 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/arena.h>
+#include <pa/exprs.h>
+#include <pa/vector.h>
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+// Every allocation is prefixed by the arena it comes from (or nullptr if it
+// comes from the heap).
+static constexpr size_t header_size = sizeof(pa::Arena*);
+
+static thread_local pa::Arena* g_cur_arena = nullptr;
+
+constexpr size_t pa::ArenaScope::default_chunk_size;
+
+pa::Arena::Arena(size_t chunk_size):
+	_cur(nullptr),
+	_end(nullptr),
+	_chunk_size(chunk_size),
+	_allocated(0),
+	_refs(1)
+{ }
+
+pa::Arena::~Arena()
+{
+	for (char* c: _chunks) {
+		::operator delete(c);
+	}
+}
+
+void* pa::Arena::allocate(size_t bytes)
+{
+	// Keep every allocation aligned on pointers
+	bytes = (bytes + header_size - 1) & ~(header_size - 1);
+	if ((size_t)(_end - _cur) < bytes) {
+		const size_t size = std::max(bytes, _chunk_size);
+		char* chunk = static_cast<char*>(::operator new(size));
+		_chunks.push_back(chunk);
+		_cur = chunk;
+		_end = chunk + size;
+	}
+	void* ret = _cur;
+	_cur += bytes;
+	_allocated += bytes;
+	acquire();
+	return ret;
+}
+
+void pa::Arena::release()
+{
+	if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete this;
+	}
+}
+
+pa::ArenaScope::ArenaScope(size_t chunk_size):
+	_arena(new Arena(chunk_size)),
+	_prev(g_cur_arena)
+{
+	g_cur_arena = _arena;
+}
+
+pa::ArenaScope::~ArenaScope()
+{
+	assert(g_cur_arena == _arena);
+	g_cur_arena = _prev;
+	_arena->release();
+}
+
+pa::Arena* pa::ArenaScope::current()
+{
+	return g_cur_arena;
+}
+
+namespace {
+
+struct SuspendArena
+{
+	SuspendArena():
+		_prev(g_cur_arena)
+	{
+		g_cur_arena = nullptr;
+	}
+
+	~SuspendArena()
+	{
+		g_cur_arena = _prev;
+	}
+
+private:
+	pa::Arena* _prev;
+};
+
+} // anonymous
+
+pa::Expr pa::ArenaScope::export_expr(Expr const& e)
+{
+	SuspendArena s;
+	return Expr{e};
+}
+
+pa::Vector pa::ArenaScope::export_vector(Vector const& v)
+{
+	SuspendArena s;
+	return Vector{v};
+}
+
+void* pa::arena_allocate(size_t bytes)
+{
+	Arena* arena = g_cur_arena;
+	char* ret;
+	if (arena) {
+		ret = static_cast<char*>(arena->allocate(bytes + header_size));
+	}
+	else {
+		ret = static_cast<char*>(::operator new(bytes + header_size));
+	}
+	*reinterpret_cast<Arena**>(ret) = arena;
+	return ret + header_size;
+}
+
+void pa::arena_deallocate(void* p) noexcept
+{
+	if (p == nullptr) {
+		return;
+	}
+	char* base = static_cast<char*>(p) - header_size;
+	Arena* arena = *reinterpret_cast<Arena**>(base);
+	if (arena) {
+		arena->release();
+	}
+	else {
+		::operator delete(base);
+	}
+}
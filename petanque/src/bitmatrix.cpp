@@ -0,0 +1,435 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/bitmatrix.h>
+#include <pa/compat.h>
+#include <pa/config.h>
+#include <pa/errors.h>
+#include <pa/matrix.h>
+#include <pa/products.h>
+
+#ifdef PA_USE_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif
+
+#include <algorithm>
+
+constexpr size_t pa::BitMatrix::word_bits;
+constexpr size_t pa::BitMatrix::table_bits;
+
+namespace {
+
+typedef pa::BitMatrix::word_type word_type;
+
+// dst ^= src on n words. This is simple enough for compilers to vectorize
+// it.
+inline void xor_words(word_type* __restrict dst, word_type const* __restrict src, const size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		dst[i] ^= src[i];
+	}
+}
+
+// Calls f with the index of each bit set in the n words
+template <class F>
+inline void for_each_bit(word_type const* words, const size_t n, F const& f)
+{
+	for (size_t w = 0; w < n; w++) {
+		word_type cur = words[w];
+		while (cur != 0) {
+			f(w*pa::BitMatrix::word_bits + pa::ctz64(cur));
+			cur &= cur-1;
+		}
+	}
+}
+
+// Minimum number of words updated for the lines to be processed in parallel
+constexpr size_t parallel_words = 1 << 15;
+
+// Calls f on each line in [begin, end), in parallel if there are enough
+// words to update
+template <class F>
+void for_each_line(const size_t begin, const size_t end, const size_t words, F const& f)
+{
+#ifdef PA_USE_TBB
+	if ((end-begin)*words >= parallel_words) {
+		tbb::parallel_for(tbb::blocked_range<size_t>(begin, end),
+			[&f](tbb::blocked_range<size_t> const& r) {
+				for (size_t i = r.begin(); i != r.end(); ++i) {
+					f(i);
+				}
+			});
+		return;
+	}
+#else
+	(void)words;
+#endif
+	for (size_t i = begin; i < end; i++) {
+		f(i);
+	}
+}
+
+// Fills table (of (1<<n) entries of stride words) with all the sums of the n
+// lines given by line(b)
+template <class F>
+void build_table(std::vector<word_type>& table, const size_t n, const size_t stride, F const& line)
+{
+	table.resize(stride << n);
+	std::fill(table.begin(), table.begin()+stride, 0);
+	for (size_t idx = 1; idx < (size_t{1} << n); idx++) {
+		word_type* const dst = &table[idx*stride];
+		word_type const* const prev = &table[(idx & (idx-1))*stride];
+		std::copy(prev, prev+stride, dst);
+		line(pa::ctz64(idx), dst);
+	}
+}
+
+} // anonymous
+
+pa::BitMatrix::BitMatrix(const size_t nlines, const size_t ncols):
+	_nlines(nlines),
+	_ncols(ncols),
+	_nwords((ncols+word_bits-1)/word_bits),
+	_words(nlines*_nwords, 0)
+{ }
+
+pa::BitMatrix pa::BitMatrix::identity(const size_t n)
+{
+	BitMatrix ret(n, n);
+	for (size_t i = 0; i < n; i++) {
+		ret.set(i, i, true);
+	}
+	return ret;
+}
+
+bool pa::BitMatrix::from_matrix(Matrix const& m, BitMatrix& ret)
+{
+	const size_t nlines = m.nlines();
+	const size_t ncols = m.ncols();
+	for (size_t i = 0; i < m.nelts(); i++) {
+		if (!m.elt_at(i).is_imm()) {
+			return false;
+		}
+	}
+	ret = BitMatrix(nlines, ncols);
+	for (size_t i = 0; i < nlines; i++) {
+		for (size_t j = 0; j < ncols; j++) {
+			if (m.at(i, j).as<ExprImm>().value()) {
+				ret.set(i, j, true);
+			}
+		}
+	}
+	return true;
+}
+
+pa::Matrix pa::BitMatrix::to_matrix() const
+{
+	Matrix ret(_nlines, _ncols, ExprImm(0));
+	for (size_t i = 0; i < _nlines; i++) {
+		for_each_bit(line_words(i), _nwords, [&ret, i](size_t j) { ret.at(i, j) = ExprImm(1); });
+	}
+	return ret;
+}
+
+void pa::BitMatrix::add_lines(const size_t a, const size_t b)
+{
+	xor_words(line_words(a), line_words(b), _nwords);
+}
+
+void pa::BitMatrix::swap_lines(const size_t a, const size_t b)
+{
+	std::swap_ranges(line_words(a), line_words(a)+_nwords, line_words(b));
+}
+
+void pa::BitMatrix::swap_cols(const size_t a, const size_t b)
+{
+	for (size_t i = 0; i < _nlines; i++) {
+		const bool va = at(i, a);
+		set(i, a, at(i, b));
+		set(i, b, va);
+	}
+}
+
+size_t pa::BitMatrix::first_set(const size_t line, const size_t col) const
+{
+	if (col >= _ncols) {
+		return _ncols;
+	}
+	word_type const* const words = line_words(line);
+	size_t w = col/word_bits;
+	word_type cur = words[w] & (~word_type{0} << (col%word_bits));
+	while (cur == 0) {
+		if (++w == _nwords) {
+			return _ncols;
+		}
+		cur = words[w];
+	}
+	return w*word_bits + ctz64(cur);
+}
+
+size_t pa::BitMatrix::T_fact(BitMatrix& T, BitMatrix& U, std::vector<size_t>& perm) const
+{
+	T = identity(_nlines);
+	U = *this;
+	perm.resize(_ncols);
+	for (size_t i = 0; i < _ncols; i++) {
+		perm[i] = i;
+	}
+
+	for (size_t j = 0; j < _nlines; j++) {
+		size_t i1;
+		size_t j1 = _ncols;
+		for (i1 = j; i1 < _nlines; i1++) {
+			j1 = U.first_set(i1, j);
+			if (j1 < _ncols) {
+				break;
+			}
+		}
+		if (j1 >= _ncols) {
+			return j;
+		}
+
+		U.swap_lines(i1, j);
+		T.swap_lines(i1, j);
+		U.swap_cols(j1, j);
+		std::swap(perm[j], perm[j1]);
+
+		// Lines of U below j only have zeros before column j
+		const size_t w = j/word_bits;
+		const word_type mask = word_type{1} << (j%word_bits);
+		word_type const* const pivot = U.line_words(j);
+		for_each_line(j+1, _nlines, _nwords-w + T._nwords, [&](size_t i) {
+			if (U.line_words(i)[w] & mask) {
+				xor_words(U.line_words(i)+w, pivot+w, _nwords-w);
+				T.add_lines(i, j);
+			}
+		});
+	}
+	return _nlines;
+}
+
+size_t pa::BitMatrix::eliminate(BitMatrix* B, std::vector<size_t>& pivots)
+{
+	pivots.clear();
+	const size_t nb = B ? B->_nwords : 0;
+	std::vector<word_type> table;
+	std::vector<size_t> block;
+	size_t rank = 0;
+	size_t col = 0;
+	while (col < _ncols && rank < _nlines) {
+		// Lines from start only have zeros before col
+		const size_t start = rank;
+		const size_t w0 = col/word_bits;
+		const size_t na = _nwords-w0;
+
+		// Adds the pivot line start+j to line i
+		auto add_pivot = [&](size_t i, size_t j) {
+			xor_words(line_words(i)+w0, line_words(start+j)+w0, na);
+			if (B) {
+				B->add_lines(i, start+j);
+			}
+		};
+
+		// Find the pivots of the block. Pivot lines are kept reduced by the
+		// other pivots of the block, so that the entry at column c of a line
+		// reduced by them can be computed directly.
+		block.clear();
+		for (; col < _ncols && rank < _nlines && block.size() < table_bits; col++) {
+			size_t p;
+			for (p = rank; p < _nlines; p++) {
+				bool v = at(p, col);
+				for (size_t j = 0; j < block.size(); j++) {
+					v ^= at(p, block[j]) && at(start+j, col);
+				}
+				if (v) {
+					break;
+				}
+			}
+			if (p == _nlines) {
+				continue;
+			}
+			for (size_t j = 0; j < block.size(); j++) {
+				if (at(p, block[j])) {
+					add_pivot(p, j);
+				}
+			}
+			if (p != rank) {
+				swap_lines(p, rank);
+				if (B) {
+					B->swap_lines(p, rank);
+				}
+			}
+			for (size_t j = 0; j < block.size(); j++) {
+				if (at(start+j, col)) {
+					add_pivot(start+j, block.size());
+				}
+			}
+			block.push_back(col);
+			rank++;
+		}
+		if (block.empty()) {
+			break;
+		}
+
+		// Reduce all the other lines by the pivots of the block at once
+		const size_t stride = na + nb;
+		build_table(table, block.size(), stride, [&](size_t j, word_type* dst) {
+			xor_words(dst, line_words(start+j)+w0, na);
+			if (B) {
+				xor_words(dst+na, B->line_words(start+j), nb);
+			}
+		});
+		for_each_line(0, _nlines, stride, [&](size_t i) {
+			if (i >= start && i < rank) {
+				return;
+			}
+			size_t idx = 0;
+			for (size_t j = 0; j < block.size(); j++) {
+				idx |= static_cast<size_t>(at(i, block[j])) << j;
+			}
+			if (idx != 0) {
+				word_type const* const src = &table[idx*stride];
+				xor_words(line_words(i)+w0, src, na);
+				if (B) {
+					xor_words(B->line_words(i), src+na, nb);
+				}
+			}
+		});
+		pivots.insert(pivots.end(), block.begin(), block.end());
+	}
+	return rank;
+}
+
+size_t pa::BitMatrix::rank() const
+{
+	BitMatrix tmp = *this;
+	std::vector<size_t> pivots;
+	return tmp.eliminate(nullptr, pivots);
+}
+
+pa::BitMatrix pa::BitMatrix::inverse() const
+{
+	if (_nlines != _ncols) {
+		return BitMatrix();
+	}
+	BitMatrix tmp = *this;
+	BitMatrix ret = identity(_nlines);
+	std::vector<size_t> pivots;
+	if (tmp.eliminate(&ret, pivots) != _nlines) {
+		return BitMatrix();
+	}
+	return ret;
+}
+
+bool pa::BitMatrix::solve(BitMatrix const& B, BitMatrix& X) const
+{
+	if (B.nlines() != _nlines) {
+		throw errors::SizeMismatch();
+	}
+	BitMatrix tmp = *this;
+	BitMatrix R = B;
+	std::vector<size_t> pivots;
+	const size_t rank = tmp.eliminate(&R, pivots);
+	for (size_t i = rank; i < _nlines; i++) {
+		word_type const* const line = R.line_words(i);
+		if (std::any_of(line, line+R._nwords, [](word_type w) { return w != 0; })) {
+			return false;
+		}
+	}
+	X = BitMatrix(_ncols, B.ncols());
+	for (size_t k = 0; k < rank; k++) {
+		std::copy(R.line_words(k), R.line_words(k)+R._nwords, X.line_words(pivots[k]));
+	}
+	return true;
+}
+
+pa::BitMatrix& pa::BitMatrix::operator+=(BitMatrix const& o)
+{
+	if (_nlines != o._nlines || _ncols != o._ncols) {
+		throw errors::SizeMismatch();
+	}
+	xor_words(_words.data(), o._words.data(), _words.size());
+	return *this;
+}
+
+pa::BitMatrix pa::BitMatrix::operator+(BitMatrix const& o) const
+{
+	BitMatrix ret = *this;
+	ret += o;
+	return ret;
+}
+
+pa::BitMatrix pa::BitMatrix::operator*(BitMatrix const& o) const
+{
+	if (_ncols != o._nlines) {
+		throw errors::SizeMismatch();
+	}
+	// Lines of o are processed by groups of table_bits, which are in the
+	// same word of the lines of this matrix. All the sums of the lines of
+	// a group are computed once, and each line of the result gets the one
+	// selected by its line in this matrix.
+	static_assert(word_bits % table_bits == 0, "groups of lines must not overlap words");
+	BitMatrix ret(_nlines, o._ncols);
+	std::vector<word_type> table;
+	for (size_t g = 0; g < _ncols; g += table_bits) {
+		const size_t n = std::min(table_bits, _ncols-g);
+		build_table(table, n, o._nwords, [&o, g](size_t b, word_type* dst) {
+			xor_words(dst, o.line_words(g+b), o._nwords);
+		});
+		const size_t w = g/word_bits;
+		const unsigned shift = g%word_bits;
+		const word_type mask = (word_type{1} << n) - 1;
+		for_each_line(0, _nlines, o._nwords, [&](size_t i) {
+			const size_t idx = (line_words(i)[w] >> shift) & mask;
+			if (idx != 0) {
+				xor_words(ret.line_words(i), &table[idx*o._nwords], o._nwords);
+			}
+		});
+	}
+	return ret;
+}
+
+pa::Vector pa::BitMatrix::operator*(Vector const& o) const
+{
+	if (o.size() != _ncols) {
+		throw errors::SizeMismatch();
+	}
+	Vector ret;
+	Vector::storage_type& ret_args = ret.args();
+	ret_args.reserve(_nlines);
+	for (size_t i = 0; i < _nlines; i++) {
+		ExprTerms terms;
+		for_each_bit(line_words(i), _nwords, [&terms, &o](size_t j) { terms.emplace_back(o.at(j)); });
+		sort_terms(terms, false);
+		ret_args.emplace_back(ExprAdd(ExprArgs(true, std::move(terms))));
+	}
+	return ret;
+}
+
+bool pa::BitMatrix::operator==(BitMatrix const& o) const
+{
+	return _nlines == o._nlines && _ncols == o._ncols && _words == o._words;
+}
@@ -0,0 +1,555 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/app.h>
+#include <pa/bitsliced.h>
+#include <pa/config.h>
+#include <pa/errors.h>
+#include <pa/matrix.h>
+#include <pa/symbols.h>
+#include <pa/vector.h>
+
+#ifdef PA_USE_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PA_BITSLICED_X86_DISPATCH
+#endif
+
+#if defined(__GNUC__)
+#define PA_BITSLICED_INLINE inline __attribute__((always_inline))
+#else
+#define PA_BITSLICED_INLINE inline
+#endif
+
+constexpr size_t pa::BitslicedEvaluator::word_bits;
+constexpr uint32_t pa::BitslicedEvaluator::reg_zero;
+constexpr uint32_t pa::BitslicedEvaluator::reg_one;
+constexpr uint32_t pa::BitslicedEvaluator::reg_inputs;
+
+namespace {
+
+typedef pa::BitslicedEvaluator::word_type word_type;
+
+// Lanes of several words. With GCC and clang, vector extensions are used so
+// that the code generated for them depends on the target of the function
+// they are inlined into (SSE2, AVX2 or AVX-512).
+#if defined(__GNUC__)
+typedef word_type lanes256 __attribute__((vector_size(32)));
+typedef word_type lanes512 __attribute__((vector_size(64)));
+#else
+template <size_t N>
+struct lanes
+{
+	word_type w[N];
+
+	lanes& operator^=(lanes const& o) { for (size_t i = 0; i < N; i++) w[i] ^= o.w[i]; return *this; }
+	lanes& operator&=(lanes const& o) { for (size_t i = 0; i < N; i++) w[i] &= o.w[i]; return *this; }
+	lanes& operator|=(lanes const& o) { for (size_t i = 0; i < N; i++) w[i] |= o.w[i]; return *this; }
+	lanes operator&(lanes const& o) const { lanes ret = *this; ret &= o; return ret; }
+};
+typedef lanes<4> lanes256;
+typedef lanes<8> lanes512;
+#endif
+
+// Transposes a 64x64 bit matrix: bit j of a[i] is swapped with bit i of a[j]
+void transpose64(word_type* a)
+{
+	word_type m = 0x00000000FFFFFFFFULL;
+	for (unsigned j = 32; j != 0; j >>= 1, m ^= (m << j)) {
+		for (unsigned k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+			const word_type t = ((a[k] >> j) ^ a[k | j]) & m;
+			a[k | j] ^= t;
+			a[k] ^= t << j;
+		}
+	}
+}
+
+struct InstrKeyHash
+{
+	size_t operator()(std::vector<uint32_t> const& k) const
+	{
+		uint64_t ret = k.size();
+		for (uint32_t v: k) {
+			ret = (ret ^ v)*0x100000001B3ULL;
+		}
+		return ret;
+	}
+};
+
+} // anonymous
+
+struct pa::BitslicedEvaluator::Compiler
+{
+	Compiler(BitslicedEvaluator& ev):
+		_ev(ev),
+		_next_reg(reg_inputs + ev._ninputs)
+	{ }
+
+	void add_input(ExprSym::idx_type idx, uint32_t reg)
+	{
+		_inputs.insert(std::make_pair(idx, reg));
+	}
+
+	uint32_t compile(Expr const& e)
+	{
+		switch (e.type()) {
+			case expr_type_id::imm_type:
+				return e.as<ExprImm>().value() ? reg_one : reg_zero;
+			case expr_type_id::symbol_type:
+			{
+				auto it = _inputs.find(e.as<ExprSym>().idx());
+				if (it == _inputs.end()) {
+					throw UnknownSymbol{};
+				}
+				return it->second;
+			}
+			case expr_type_id::add_type:
+				return compile_args(Op::Xor, 0, e, reg_zero);
+			case expr_type_id::mul_type:
+				return compile_args(Op::And, 0, e, reg_one);
+			case expr_type_id::or_type:
+				return compile_args(Op::Or, 0, e, reg_zero);
+			case expr_type_id::esf_type:
+			{
+				const uint32_t degree = e.as<ExprESF>().degree();
+				if (degree == 0) {
+					return reg_one;
+				}
+				if (degree > e.nargs()) {
+					return reg_zero;
+				}
+				if (degree == 1) {
+					return compile_args(Op::Xor, 0, e, reg_zero);
+				}
+				return compile_args(Op::ESF, degree, e, reg_zero);
+			}
+		};
+		assert(false);
+		return reg_zero;
+	}
+
+private:
+	uint32_t compile_args(Op op, uint32_t degree, Expr const& e, uint32_t empty_reg)
+	{
+		if (e.nargs() == 0) {
+			return empty_reg;
+		}
+		if (e.nargs() == 1 && op != Op::ESF) {
+			return compile(e.args()[0]);
+		}
+
+		// Instructions are hash-consed on their (sorted) argument registers,
+		// as all the operations are commutative.
+		std::vector<uint32_t> key;
+		key.reserve(e.nargs() + 2);
+		key.push_back((uint32_t)op);
+		key.push_back(degree);
+		for (Expr const& a: e.args()) {
+			key.push_back(compile(a));
+		}
+		std::sort(key.begin() + 2, key.end());
+		auto it = _cse.find(key);
+		if (it != _cse.end()) {
+			return it->second;
+		}
+
+		Instr instr;
+		instr.op = op;
+		instr.degree = degree;
+		instr.dst = _next_reg++;
+		instr.args_begin = _ev._args.size();
+		_ev._args.insert(_ev._args.end(), key.begin() + 2, key.end());
+		instr.args_end = _ev._args.size();
+		_ev._instrs.push_back(instr);
+		_ev._max_degree = std::max(_ev._max_degree, degree);
+		_cse.insert(std::make_pair(std::move(key), instr.dst));
+		return instr.dst;
+	}
+
+private:
+	BitslicedEvaluator& _ev;
+	std::unordered_map<ExprSym::idx_type, uint32_t> _inputs;
+	std::unordered_map<std::vector<uint32_t>, uint32_t, InstrKeyHash> _cse;
+	uint32_t _next_reg;
+};
+
+struct pa::BitslicedEvaluator::Runner
+{
+	// Evaluates the words [begin, end) of each plane, end-begin being a
+	// multiple of the number of words in V
+	template <class V>
+	static PA_BITSLICED_INLINE void run(BitslicedEvaluator const& ev, word_type const* in, word_type* out, size_t nwords, size_t begin, size_t end)
+	{
+		constexpr size_t W = sizeof(V)/sizeof(word_type);
+		assert((end-begin) % W == 0);
+
+		std::vector<word_type> regs(ev._nregs*W, 0);
+		std::vector<word_type> esf(ev._max_degree*W);
+		std::fill(&regs[reg_one*W], &regs[(reg_one+1)*W], ~word_type{0});
+		word_type* const R = &regs[0];
+		word_type* const E = esf.empty() ? nullptr : &esf[0];
+		uint32_t const* const args = ev._args.empty() ? nullptr : &ev._args[0];
+
+		for (size_t b = begin; b < end; b += W) {
+			for (size_t i = 0; i < ev._ninputs; i++) {
+				memcpy(&R[(reg_inputs+i)*W], &in[i*nwords + b], sizeof(V));
+			}
+			for (Instr const& instr: ev._instrs) {
+				uint32_t const* a = &args[instr.args_begin];
+				uint32_t const* const a_end = &args[instr.args_end];
+				// Instructions have at least one argument
+				V acc;
+				V v;
+				memcpy(&acc, &R[(*a)*W], sizeof(V));
+				switch (instr.op) {
+					case Op::Xor:
+						for (++a; a != a_end; ++a) {
+							memcpy(&v, &R[(*a)*W], sizeof(V));
+							acc ^= v;
+						}
+						break;
+					case Op::And:
+						for (++a; a != a_end; ++a) {
+							memcpy(&v, &R[(*a)*W], sizeof(V));
+							acc &= v;
+						}
+						break;
+					case Op::Or:
+						for (++a; a != a_end; ++a) {
+							memcpy(&v, &R[(*a)*W], sizeof(V));
+							acc |= v;
+						}
+						break;
+					case Op::ESF:
+					{
+						// E[j] is the elementary symmetric function of degree
+						// j+1 of the arguments processed so far
+						const uint32_t degree = instr.degree;
+						memset(E, 0, degree*sizeof(V));
+						for (; a != a_end; ++a) {
+							memcpy(&v, &R[(*a)*W], sizeof(V));
+							for (uint32_t j = degree-1; j > 0; j--) {
+								V ej;
+								V prev;
+								memcpy(&ej, &E[j*W], sizeof(V));
+								memcpy(&prev, &E[(j-1)*W], sizeof(V));
+								ej ^= prev & v;
+								memcpy(&E[j*W], &ej, sizeof(V));
+							}
+							V e0;
+							memcpy(&e0, &E[0], sizeof(V));
+							e0 ^= v;
+							memcpy(&E[0], &e0, sizeof(V));
+						}
+						memcpy(&acc, &E[(degree-1)*W], sizeof(V));
+						break;
+					}
+				};
+				memcpy(&R[instr.dst*W], &acc, sizeof(V));
+			}
+			for (size_t i = 0; i < ev._outputs.size(); i++) {
+				memcpy(&out[i*nwords + b], &R[ev._outputs[i]*W], sizeof(V));
+			}
+		}
+	}
+
+#ifdef PA_BITSLICED_X86_DISPATCH
+	__attribute__((target("avx2")))
+	static void run_avx2(BitslicedEvaluator const& ev, word_type const* in, word_type* out, size_t nwords, size_t begin, size_t end)
+	{
+		run<lanes256>(ev, in, out, nwords, begin, end);
+	}
+
+	__attribute__((target("avx512f")))
+	static void run_avx512(BitslicedEvaluator const& ev, word_type const* in, word_type* out, size_t nwords, size_t begin, size_t end)
+	{
+		run<lanes512>(ev, in, out, nwords, begin, end);
+	}
+
+	static bool has_avx2()
+	{
+		static const bool ret = __builtin_cpu_supports("avx2");
+		return ret;
+	}
+
+	static bool has_avx512()
+	{
+		static const bool ret = __builtin_cpu_supports("avx512f");
+		return ret;
+	}
+#endif
+
+	static void run_width(BitslicedEvaluator const& ev, word_type const* in, word_type* out, size_t nwords, size_t begin, size_t end, Width width)
+	{
+		switch (width) {
+			case Width::W512:
+#ifdef PA_BITSLICED_X86_DISPATCH
+				if (has_avx512()) {
+					run_avx512(ev, in, out, nwords, begin, end);
+					return;
+				}
+#endif
+				run<lanes512>(ev, in, out, nwords, begin, end);
+				return;
+			case Width::W256:
+#ifdef PA_BITSLICED_X86_DISPATCH
+				if (has_avx2()) {
+					run_avx2(ev, in, out, nwords, begin, end);
+					return;
+				}
+#endif
+				run<lanes256>(ev, in, out, nwords, begin, end);
+				return;
+			default:
+				run<word_type>(ev, in, out, nwords, begin, end);
+				return;
+		};
+	}
+};
+
+pa::BitslicedEvaluator::BitslicedEvaluator(Vector const& outputs, Vector const& inputs)
+{
+	compile(outputs, inputs);
+}
+
+pa::BitslicedEvaluator::BitslicedEvaluator(App const& app)
+{
+	Vector outputs;
+	Vector inputs;
+	app_vectors(app, outputs, inputs);
+	compile(outputs, inputs);
+}
+
+void pa::BitslicedEvaluator::app_vectors(App const& app, Vector& outputs, Vector& inputs)
+{
+	// App(X) = NL(X) + M*X + V
+	Matrix const& M = app.matrix();
+	Vector const& NL = app.nl().vector();
+	Vector const& V = app.cst();
+
+	inputs = Vector(M.ncols());
+	for (size_t i = 0; i < M.ncols(); i++) {
+		inputs[i] = Symbols::arg_symbol(i);
+	}
+	outputs = Vector(M.nlines());
+	for (size_t i = 0; i < M.nlines(); i++) {
+		std::vector<Expr> line{V[i]};
+		if (i < NL.size()) {
+			line.push_back(NL[i]);
+		}
+		for (size_t j = 0; j < M.ncols(); j++) {
+			Expr const& m = M.at(i, j);
+			if (m.is_imm()) {
+				if (m.as<ExprImm>().value()) {
+					line.push_back(inputs[j]);
+				}
+			}
+			else {
+				line.push_back(ExprMul({m, inputs[j]}));
+			}
+		}
+		outputs[i] = ExprAdd(line.begin(), line.end());
+	}
+}
+
+void pa::BitslicedEvaluator::compile(Vector const& outputs, Vector const& inputs)
+{
+	_ninputs = inputs.size();
+	_max_degree = 0;
+
+	Compiler c(*this);
+	for (size_t i = 0; i < inputs.size(); i++) {
+		if (!inputs[i].is_sym()) {
+			throw UnknownSymbol{};
+		}
+		c.add_input(inputs[i].as<ExprSym>().idx(), reg_inputs + i);
+	}
+	_outputs.reserve(outputs.size());
+	for (Expr const& e: outputs) {
+		_outputs.push_back(c.compile(e));
+	}
+	allocate_registers();
+}
+
+void pa::BitslicedEvaluator::allocate_registers()
+{
+	// Temporaries are in SSA form after compilation. Reuse the register of a
+	// temporary after its last use, so that the register file stays small
+	// enough to fit in cache.
+	const uint32_t first_tmp = reg_inputs + _ninputs;
+	const uint32_t end_ssa = first_tmp + _instrs.size();
+	const uint32_t never = std::numeric_limits<uint32_t>::max();
+
+	std::vector<uint32_t> last_use(end_ssa - first_tmp, 0);
+	for (size_t i = 0; i < _instrs.size(); i++) {
+		Instr const& instr = _instrs[i];
+		for (uint32_t a = instr.args_begin; a < instr.args_end; a++) {
+			if (_args[a] >= first_tmp) {
+				last_use[_args[a] - first_tmp] = i;
+			}
+		}
+	}
+	for (uint32_t r: _outputs) {
+		if (r >= first_tmp) {
+			last_use[r - first_tmp] = never;
+		}
+	}
+
+	std::vector<uint32_t> phys(end_ssa - first_tmp);
+	std::vector<uint32_t> free_regs;
+	uint32_t nregs = first_tmp;
+	auto map_reg = [&](uint32_t r) { return r < first_tmp ? r : phys[r - first_tmp]; };
+	for (size_t i = 0; i < _instrs.size(); i++) {
+		Instr& instr = _instrs[i];
+		uint32_t dst;
+		if (free_regs.empty()) {
+			dst = nregs++;
+		}
+		else {
+			dst = free_regs.back();
+			free_regs.pop_back();
+		}
+		phys[instr.dst - first_tmp] = dst;
+		instr.dst = dst;
+		for (uint32_t a = instr.args_begin; a < instr.args_end; a++) {
+			const uint32_t r = _args[a];
+			_args[a] = map_reg(r);
+			// Arguments are sorted, so duplicates are contiguous
+			if (r >= first_tmp && last_use[r - first_tmp] == i && (a+1 == instr.args_end || _args[a+1] != r)) {
+				free_regs.push_back(_args[a]);
+			}
+		}
+	}
+	for (uint32_t& r: _outputs) {
+		r = map_reg(r);
+	}
+	_nregs = nregs;
+}
+
+pa::BitslicedEvaluator::Width pa::BitslicedEvaluator::native_width()
+{
+#ifdef PA_BITSLICED_X86_DISPATCH
+	if (Runner::has_avx512()) {
+		return Width::W512;
+	}
+#endif
+	return Width::W256;
+}
+
+void pa::BitslicedEvaluator::eval_planes(word_type const* in, word_type* out, size_t nwords, Width width) const
+{
+	if (width == Width::Auto) {
+		width = native_width();
+	}
+	const size_t W = (size_t)width;
+	const size_t nblocks = nwords/W;
+#ifdef PA_USE_TBB
+	const size_t grain = std::max(size_t{1}, (size_t{1} << 14)/(W*(_instrs.size()+1)));
+	if (nblocks > grain) {
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, nblocks, grain),
+			[&](tbb::blocked_range<size_t> const& r) {
+				Runner::run_width(*this, in, out, nwords, r.begin()*W, r.end()*W, width);
+			});
+	}
+	else
+#endif
+	{
+		Runner::run_width(*this, in, out, nwords, 0, nblocks*W, width);
+	}
+	if (nblocks*W < nwords) {
+		Runner::run_width(*this, in, out, nwords, nblocks*W, nwords, Width::W64);
+	}
+}
+
+void pa::BitslicedEvaluator::rows_to_planes(word_type const* rows, size_t n, size_t nbits, word_type* planes)
+{
+	const size_t nwords = words_for(n);
+	const size_t row_words = words_for(nbits);
+	word_type block[word_bits];
+	for (size_t c = 0; c < nwords; c++) {
+		const size_t nrows = std::min(word_bits, n - c*word_bits);
+		for (size_t g = 0; g < row_words; g++) {
+			for (size_t r = 0; r < word_bits; r++) {
+				block[r] = r < nrows ? rows[(c*word_bits + r)*row_words + g] : 0;
+			}
+			transpose64(block);
+			const size_t nb = std::min(word_bits, nbits - g*word_bits);
+			for (size_t b = 0; b < nb; b++) {
+				planes[(g*word_bits + b)*nwords + c] = block[b];
+			}
+		}
+	}
+}
+
+void pa::BitslicedEvaluator::planes_to_rows(word_type const* planes, size_t n, size_t nbits, word_type* rows)
+{
+	const size_t nwords = words_for(n);
+	const size_t row_words = words_for(nbits);
+	word_type block[word_bits];
+	for (size_t c = 0; c < nwords; c++) {
+		const size_t nrows = std::min(word_bits, n - c*word_bits);
+		for (size_t g = 0; g < row_words; g++) {
+			const size_t nb = std::min(word_bits, nbits - g*word_bits);
+			for (size_t b = 0; b < word_bits; b++) {
+				block[b] = b < nb ? planes[(g*word_bits + b)*nwords + c] : 0;
+			}
+			transpose64(block);
+			for (size_t r = 0; r < nrows; r++) {
+				rows[(c*word_bits + r)*row_words + g] = block[r];
+			}
+		}
+	}
+}
+
+void pa::BitslicedEvaluator::eval(word_type const* in, word_type* out, size_t n, Width width) const
+{
+	const size_t nwords = words_for(n);
+	std::vector<word_type> in_planes(ninputs()*nwords);
+	std::vector<word_type> out_planes(noutputs()*nwords);
+	rows_to_planes(in, n, ninputs(), in_planes.data());
+	eval_planes(in_planes.data(), out_planes.data(), nwords, width);
+	planes_to_rows(out_planes.data(), n, noutputs(), out);
+}
+
+std::vector<pa::BitslicedEvaluator::word_type> pa::BitslicedEvaluator::eval(std::vector<word_type> const& values, Width width) const
+{
+	const size_t in_row = input_row_words();
+	if ((in_row == 0 && !values.empty()) || (in_row > 0 && values.size() % in_row != 0)) {
+		throw errors::SizeMismatch{};
+	}
+	const size_t n = in_row == 0 ? 0 : values.size()/in_row;
+	std::vector<word_type> ret(n*output_row_words());
+	eval(values.data(), ret.data(), n, width);
+	return ret;
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/budget.h>
+#include <pa/errors.h>
+
+#include <cassert>
+#include <limits>
+
+namespace {
+
+// Adds n to counter, saturating, and returns the new value
+uint64_t add_saturated(std::atomic<uint64_t>& counter, uint64_t n)
+{
+	uint64_t cur = counter.load(std::memory_order_relaxed);
+	uint64_t next;
+	do {
+		next = (cur > std::numeric_limits<uint64_t>::max()-n) ? std::numeric_limits<uint64_t>::max() : cur+n;
+	}
+	while (!counter.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+	return next;
+}
+
+} // anonymous
+
+static thread_local pa::Budget* g_cur_budget = nullptr;
+
+pa::Budget::Budget():
+	_max_nodes(0),
+	_max_monomials(0),
+	_has_deadline(false),
+	_cancelled(false),
+	_nodes(0),
+	_monomials(0)
+{ }
+
+void pa::Budget::set_timeout(double seconds)
+{
+	_has_deadline = seconds > 0;
+	if (_has_deadline) {
+		_deadline = clock_type::now() + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(seconds));
+	}
+}
+
+void pa::Budget::reset()
+{
+	_cancelled = false;
+	_nodes = 0;
+	_monomials = 0;
+}
+
+void pa::Budget::check() const
+{
+	if (_cancelled.load(std::memory_order_relaxed)) {
+		throw errors::BudgetExceeded(errors::BudgetExceeded::cancelled);
+	}
+	if (_has_deadline && clock_type::now() >= _deadline) {
+		throw errors::BudgetExceeded(errors::BudgetExceeded::deadline);
+	}
+}
+
+void pa::Budget::consume_nodes(uint64_t n)
+{
+	check();
+	const uint64_t nodes = add_saturated(_nodes, n);
+	if (_max_nodes != 0 && nodes > _max_nodes) {
+		throw errors::BudgetExceeded(errors::BudgetExceeded::nodes);
+	}
+}
+
+void pa::Budget::consume_monomials(uint64_t n)
+{
+	check();
+	const uint64_t monomials = add_saturated(_monomials, n);
+	if (_max_monomials != 0 && monomials > _max_monomials) {
+		throw errors::BudgetExceeded(errors::BudgetExceeded::monomials);
+	}
+}
+
+pa::BudgetScope::BudgetScope(Budget* budget):
+	_budget(budget),
+	_prev(g_cur_budget)
+{
+	g_cur_budget = budget;
+}
+
+pa::BudgetScope::~BudgetScope()
+{
+	assert(g_cur_budget == _budget);
+	g_cur_budget = _prev;
+}
+
+pa::Budget* pa::BudgetScope::current()
+{
+	return g_cur_budget;
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/arena.h>
+#include <pa/cache.h>
+
+pa::ExprCache::ExprCache(size_t capacity):
+	_capacity(capacity),
+	_stats{0, 0, 0, 0}
+{ }
+
+uint64_t pa::ExprCache::hash(Expr const& e)
+{
+	// The hash of an expression with arguments only depends on its
+	// arguments
+	return (e.hash()*0x100000001B3ULL) ^ static_cast<uint64_t>(e.type());
+}
+
+bool pa::ExprCache::lookup(Expr const& in, Expr& out)
+{
+	const uint64_t h = hash(in);
+	std::lock_guard<std::mutex> lock(_mutex);
+	const auto range = _index.equal_range(h);
+	for (auto it = range.first; it != range.second; ++it) {
+		lru_type::iterator entry = it->second;
+		if (entry->in == in) {
+			_lru.splice(_lru.begin(), _lru, entry);
+			out = entry->out;
+			_stats.hits++;
+			return true;
+		}
+	}
+	_stats.misses++;
+	return false;
+}
+
+void pa::ExprCache::insert(Expr const& in, Expr const& out)
+{
+	const uint64_t h = hash(in);
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_capacity == 0) {
+		return;
+	}
+	const auto range = _index.equal_range(h);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second->in == in) {
+			// Computed concurrently by another thread
+			return;
+		}
+	}
+	evict(_capacity-1);
+	// Entries outlive the arena scope they have been computed in, and must not
+	// keep its arena alive
+	_lru.push_front(Entry{h, ArenaScope::export_expr(in), ArenaScope::export_expr(out)});
+	_index.emplace(h, _lru.begin());
+}
+
+void pa::ExprCache::evict(size_t size)
+{
+	while (_lru.size() > size) {
+		Entry const& last = _lru.back();
+		auto range = _index.equal_range(last.hash);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (&*it->second == &last) {
+				_index.erase(it);
+				break;
+			}
+		}
+		_lru.pop_back();
+		_stats.evictions++;
+	}
+}
+
+size_t pa::ExprCache::capacity() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _capacity;
+}
+
+void pa::ExprCache::set_capacity(size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_capacity = capacity;
+	evict(capacity);
+}
+
+void pa::ExprCache::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_lru.clear();
+	_index.clear();
+	_stats = Stats{0, 0, 0, 0};
+}
+
+pa::ExprCache::Stats pa::ExprCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Stats ret = _stats;
+	ret.size = _lru.size();
+	return ret;
+}
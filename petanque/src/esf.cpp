@@ -0,0 +1,89 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/esf.h>
+
+#include <algorithm>
+
+namespace {
+
+// Lucas' theorem: C(n, k) is odd iff the bits of k are a subset of the ones
+// of n
+inline bool binomial_odd(size_t n, size_t k)
+{
+	return (k & ~n) == 0;
+}
+
+} // anonymous
+
+pa::Expr pa::esf(size_t k, ExprArgs const& args)
+{
+	if (k == 0) {
+		return ExprImm(1);
+	}
+	if (k > args.size()) {
+		return ExprImm(0);
+	}
+	assert(k <= esf_max_degree);
+	if (args.size() == 1) {
+		return args[0];
+	}
+	// The constructor of ExprESF transforms the degree 1 and args.size()
+	// cases into an addition and a multiplication
+	return ExprESF(k, args);
+}
+
+pa::Expr pa::esf_product(size_t i, size_t j, ExprArgs const& args)
+{
+	if (i > j) {
+		std::swap(i, j);
+	}
+	// The monomials of e_i*e_j are the products of the sets S and T of
+	// sizes i and j. For a set U of size k, there are C(k, i) ways to choose
+	// S, and T must then contain the k-i elements of U\S and i+j-k elements
+	// of S.
+	const size_t end = std::min(i+j, args.size());
+	Expr ret = ExprImm(0);
+	for (size_t k = j; k <= end; k++) {
+		if (binomial_odd(k, i) && binomial_odd(i, i+j-k)) {
+			ret = ret + esf(k, args);
+		}
+	}
+	return ret;
+}
+
+pa::Expr pa::esf_with_ones(size_t k, ExprArgs const& args, size_t ones)
+{
+	// e_k(X, 1) = e_k(X) + e_{k-1}(X), thus by induction e_k(X, 1, ..., 1)
+	// = sum of C(ones, t)*e_{k-t}(X)
+	const size_t end = std::min(k, ones);
+	Expr ret = ExprImm(0);
+	for (size_t t = 0; t <= end; t++) {
+		if (binomial_odd(ones, t)) {
+			ret = ret + esf(k-t, args);
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,392 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/cast.h>
+#include <pa/esf.h>
+#include <pa/expr_pool.h>
+#include <pa/ops_rules.h>
+#include <pa/products.h>
+#include <pa/vector.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+static inline uint64_t hash_combine(uint64_t h, uint64_t v)
+{
+	return (h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)))*0x5555555555555555ULL;
+}
+
+pa::ExprNode::ExprNode(ExprPool* pool, expr_type_id type, uint32_t value, degree_type degree, args_type&& args):
+	_pool(pool),
+	_args(std::move(args)),
+	_value(value),
+	_type(type),
+	_degree(degree)
+{
+	uint64_t h = hash_combine((uint64_t)type, ((uint64_t)degree << 32) | value);
+	for (ExprRef const& a: _args) {
+		h = hash_combine(h, a.hash());
+	}
+	_hash = h;
+}
+
+bool pa::ExprNode::shallow_equal(ExprNode const& o) const
+{
+	// Arguments are already interned, so that comparing pointers is enough.
+	return (_type == o._type) &&
+	       (_value == o._value) &&
+	       (_degree == o._degree) &&
+	       (_args == o._args);
+}
+
+int pa::ExprPool::compare(ExprRef a, ExprRef b)
+{
+	if (a == b) {
+		return 0;
+	}
+	ExprNode const& na = *a.node();
+	ExprNode const& nb = *b.node();
+	if (na.type() != nb.type()) {
+		return (na.type() < nb.type()) ? -1 : 1;
+	}
+	if (!na.has_args()) {
+		// Symbols and immediates
+		if (na._value == nb._value) {
+			return 0;
+		}
+		return (na._value < nb._value) ? -1 : 1;
+	}
+	if (na._degree != nb._degree) {
+		return (na._degree < nb._degree) ? -1 : 1;
+	}
+	if (na.nargs() != nb.nargs()) {
+		return (na.nargs() < nb.nargs()) ? -1 : 1;
+	}
+	const size_t n = na.nargs();
+	for (size_t i = 0; i < n; i++) {
+		const int c = compare(na.args()[i], nb.args()[i]);
+		if (c != 0) {
+			return c;
+		}
+	}
+	return 0;
+}
+
+pa::ExprRef pa::ExprPool::get(expr_type_id type, uint32_t value, ExprESF::degree_type degree, args_type&& args)
+{
+	ExprNode probe(this, type, value, degree, std::move(args));
+	auto it = _table.find(&probe);
+	if (it != _table.end()) {
+		return ExprRef{*it};
+	}
+	_nodes.push_back(std::move(probe));
+	ExprNode const* n = &_nodes.back();
+	_table.insert(n);
+	return ExprRef{n};
+}
+
+pa::ExprRef pa::ExprPool::imm(bool v)
+{
+	return get(expr_type_id::imm_type, v, 0, args_type{});
+}
+
+pa::ExprRef pa::ExprPool::sym(ExprSym::idx_type idx)
+{
+	return get(expr_type_id::symbol_type, idx, 0, args_type{});
+}
+
+pa::ExprRef pa::ExprPool::esf(ExprESF::degree_type degree, args_type args)
+{
+	std::sort(args.begin(), args.end(), less);
+	// Follow what ExprESF does with these trivial degrees
+	if (degree == 1) {
+		return from_args(expr_type_id::add_type, std::move(args));
+	}
+	if (degree == args.size()) {
+		return from_args(expr_type_id::mul_type, std::move(args));
+	}
+	return get(expr_type_id::esf_type, 0, degree, std::move(args));
+}
+
+pa::ExprRef pa::ExprPool::with_args(expr_type_id type, args_type args)
+{
+	assert(type < expr_type_id::symbol_type && type != expr_type_id::esf_type);
+	std::sort(args.begin(), args.end(), less);
+	return from_args(type, std::move(args));
+}
+
+pa::ExprRef pa::ExprPool::from_args(expr_type_id type, args_type&& args)
+{
+	return get(type, 0, 0, std::move(args));
+}
+
+pa::ExprRef pa::ExprPool::intern(Expr const& e)
+{
+	switch (e.type()) {
+		case expr_type_id::imm_type:
+			return imm(e.as<ExprImm>().value());
+		case expr_type_id::symbol_type:
+			return sym(e.as<ExprSym>().idx());
+		default:
+			break;
+	};
+
+	args_type args;
+	args.reserve(e.nargs());
+	for (Expr const& a: e.args()) {
+		args.push_back(intern(a));
+	}
+	// Interned arguments follow the order of their Expr counterparts, so
+	// that sorted expressions stay sorted.
+	if (!std::is_sorted(args.begin(), args.end(), less)) {
+		std::sort(args.begin(), args.end(), less);
+	}
+	if (e.is_esf()) {
+		return get(expr_type_id::esf_type, 0, e.as<ExprESF>().degree(), std::move(args));
+	}
+	return from_args(e.type(), std::move(args));
+}
+
+std::vector<pa::ExprRef> pa::ExprPool::intern(Vector const& v)
+{
+	std::vector<ExprRef> ret;
+	ret.reserve(v.size());
+	for (Expr const& e: v) {
+		ret.push_back(intern(e));
+	}
+	return ret;
+}
+
+// Expressions of the nodes used more than once while converting handles
+// back to Expr objects. Each of them is built once, and copied for its other
+// uses (the last one taking it).
+struct pa::ExprPool::ToExprMemo
+{
+	std::unordered_map<ExprNode const*, size_t> uses;
+	std::unordered_map<ExprNode const*, Expr> exprs;
+
+	void count_uses(ExprRef r)
+	{
+		if (!r->has_args() || (uses[r.node()]++ > 0)) {
+			return;
+		}
+		for (ExprRef const& a: r->args()) {
+			count_uses(a);
+		}
+	}
+};
+
+pa::Expr pa::ExprPool::to_expr(ExprRef r)
+{
+	ToExprMemo memo;
+	memo.count_uses(r);
+	return to_expr(r, memo);
+}
+
+pa::Expr pa::ExprPool::to_expr(ExprRef r, ToExprMemo& memo)
+{
+	ExprNode const& n = *r.node();
+	switch (n.type()) {
+		case expr_type_id::imm_type:
+			return ExprImm(n.imm_value());
+		case expr_type_id::symbol_type:
+			return ExprSym(n.sym_idx());
+		default:
+			break;
+	};
+
+	size_t& uses = memo.uses[&n];
+	auto it = memo.exprs.find(&n);
+	if (it != memo.exprs.end()) {
+		if (--uses > 0) {
+			return it->second;
+		}
+		Expr ret = std::move(it->second);
+		memo.exprs.erase(it);
+		return ret;
+	}
+
+	// Arguments are already sorted, so just push them at the end.
+	ExprArgs::vector_type sorted_args;
+	sorted_args.reserve(n.nargs());
+	for (ExprRef const& a: n.args()) {
+		sorted_args.emplace_back(to_expr(a, memo));
+	}
+	ExprArgs args(true, std::move(sorted_args));
+	Expr ret;
+	if (n.type() == expr_type_id::esf_type) {
+		Expr::ExprESFStorage storage(std::move(args));
+		storage.degree() = n.esf_degree();
+		ret = Expr{expr_type_id::esf_type, std::move(storage)};
+	}
+	else {
+		ret = Expr{n.type(), Expr::ExprArgsStorage{std::move(args)}};
+	}
+	// The reference to the number of uses is still valid, as rehashing
+	// doesn't invalidate references to the elements of an unordered_map
+	if (--uses > 0) {
+		memo.exprs.emplace(&n, ret);
+	}
+	return ret;
+}
+
+pa::Vector pa::ExprPool::to_vector(std::vector<ExprRef> const& v)
+{
+	ToExprMemo memo;
+	for (ExprRef const& r: v) {
+		memo.count_uses(r);
+	}
+	Vector ret;
+	auto& args = ret.args();
+	args.reserve(v.size());
+	for (ExprRef const& r: v) {
+		args.emplace_back(to_expr(r, memo));
+	}
+	return ret;
+}
+
+void pa::ExprPool::clear()
+{
+	_table.clear();
+	_nodes.clear();
+}
+
+namespace {
+
+// Merge two sorted lists of arguments. If cancel is true, arguments that are
+// present in both lists are removed (XOR semantic), otherwise only one of them
+// is kept (AND/OR semantic).
+pa::ExprPool::args_type merge_args(pa::ExprPool::args_type const& a, pa::ExprPool::args_type const& b, bool cancel)
+{
+	pa::ExprPool::args_type ret;
+	ret.reserve(a.size() + b.size());
+	auto ita = a.begin();
+	auto itb = b.begin();
+	while ((ita != a.end()) && (itb != b.end())) {
+		const int c = pa::ExprPool::compare(*ita, *itb);
+		if (c < 0) {
+			ret.push_back(*ita++);
+		}
+		else
+		if (c > 0) {
+			ret.push_back(*itb++);
+		}
+		else {
+			if (!cancel) {
+				ret.push_back(*ita);
+			}
+			++ita; ++itb;
+		}
+	}
+	ret.insert(ret.end(), ita, a.end());
+	ret.insert(ret.end(), itb, b.end());
+	return ret;
+}
+
+} // anonymous
+
+// Builds interned nodes for the rules of ops_rules.h
+struct pa::ExprPool::Builder
+{
+	typedef ExprRef arg_type;
+	typedef ExprRef result_type;
+
+	ExprPool& pool;
+
+	expr_type_id type(ExprRef r) const { return r->type(); }
+	bool equal(ExprRef a, ExprRef b) const { return a == b; }
+	bool imm_value(ExprRef r) const { return r->imm_value(); }
+
+	ExprRef imm(bool v) const { return pool.imm(v); }
+	ExprRef copy(ExprRef r) const { return r; }
+
+	size_t esf_degree(ExprRef r) const { return r->esf_degree(); }
+	size_t nargs(ExprRef r) const { return r->nargs(); }
+	bool same_args(ExprRef a, ExprRef b) const { return a->args() == b->args(); }
+
+	ExprRef esf_product(ExprRef r, size_t deg) const
+	{
+		ExprTerms terms;
+		terms.reserve(r->nargs());
+		for (ExprRef const& arg: r->args()) {
+			terms.emplace_back(to_expr(arg));
+		}
+		return pool.intern(pa::esf_product(r->esf_degree(), deg, ExprArgs(true, std::move(terms))));
+	}
+
+	ExprRef make(expr_type_id type, ExprRef a, ExprRef b) const
+	{
+		args_type args = less(a, b) ? args_type{a, b} : args_type{b, a};
+		return pool.from_args(type, std::move(args));
+	}
+
+	ExprRef merge(expr_type_id type, ExprRef a, ExprRef b) const
+	{
+		const bool cancel = (type == expr_type_id::add_type);
+		args_type args = (b->type() == type) ?
+			merge_args(a->args(), b->args(), cancel) :
+			merge_args(a->args(), args_type{b}, cancel);
+		if (args.size() == 0) {
+			return pool.imm(false);
+		}
+		if (args.size() == 1) {
+			return args[0];
+		}
+		return pool.from_args(type, std::move(args));
+	}
+};
+
+pa::ExprRef pa::ExprPool::add(ExprRef a, ExprRef b)
+{
+	return __impl::add(Builder{*this}, a, b);
+}
+
+pa::ExprRef pa::ExprPool::mul(ExprRef a, ExprRef b)
+{
+	return __impl::mul(Builder{*this}, a, b);
+}
+
+pa::ExprRef pa::ExprPool::or_(ExprRef a, ExprRef b)
+{
+	return __impl::or_(Builder{*this}, a, b);
+}
+
+pa::ExprRef pa::ExprRef::operator+(ExprRef const& o) const
+{
+	assert(_n->pool() == o->pool());
+	return _n->pool()->add(*this, o);
+}
+
+pa::ExprRef pa::ExprRef::operator*(ExprRef const& o) const
+{
+	assert(_n->pool() == o->pool());
+	return _n->pool()->mul(*this, o);
+}
+
+pa::ExprRef pa::ExprRef::operator|(ExprRef const& o) const
+{
+	assert(_n->pool() == o->pool());
+	return _n->pool()->or_(*this, o);
+}
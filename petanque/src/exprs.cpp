@@ -24,8 +24,10 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
+#include <limits>
 
 #include <pa/algos.h>
+#include <pa/budget.h>
 #include <pa/exprs.h>
 #include <pa/cast.h>
 #include <pa/simps.h>
@@ -151,15 +153,36 @@ void pa::ExprESF::expand()
 		set_type(expr_type_id::add_type);
 		return;
 	}
+	// The number of monomials (C(nargs, degree)) is accounted upfront, and
+	// the deadline and the cancellation are checked while they are created,
+	// so that the ESF is left untouched if the budget is exceeded.
+	Budget* const budget = BudgetScope::current();
+	if (budget) {
+		uint64_t nmonomials = 1;
+		for (size_t i = 0; i < degree(); i++) {
+			const uint64_t m = nargs()-i;
+			if (nmonomials > std::numeric_limits<uint64_t>::max()/m) {
+				nmonomials = std::numeric_limits<uint64_t>::max();
+				break;
+			}
+			nmonomials = (nmonomials*m)/(i+1);
+		}
+		budget->consume_monomials(nmonomials);
+	}
+
 	ExprAdd ret;
 	ExprArgs& args_ret = ret.args();
 	ExprArgs const& args_ = args();
+	size_t count = 0;
 	draw_without_replacement<size_t>(degree(), nargs(), 
-		[&args_ret,&args_](size_t const* idxes, size_t const n)
+		[&args_ret,&args_,budget,&count](size_t const* idxes, size_t const n)
 		{
 			if (n == 0) {
 				return true;
 			}
+			if (budget && ((++count % 4096) == 0)) {
+				budget->check();
+			}
 			Expr tmp = args_[idxes[0]];
 			for (size_t i = 1; i < n; i++) {
 				Expr const& cur_a = args_[idxes[i]];
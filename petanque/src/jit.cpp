@@ -0,0 +1,523 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/bitsliced.h>
+#include <pa/config.h>
+#include <pa/errors.h>
+#include <pa/jit.h>
+#include <pa/vector.h>
+
+#ifdef PA_USE_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PA_JIT_X86_64
+#endif
+
+#ifdef PA_JIT_X86_64
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+typedef pa::JitFunction::word_type word_type;
+
+#ifdef PA_JIT_X86_64
+// Minimal x86-64 encoder. Memory operands are always [base+disp32], base
+// being the register holding the first argument of the generated function.
+class X64Emitter
+{
+public:
+	enum: uint8_t {
+		rax = 0,
+		rcx = 1,
+		rdx = 2,
+		rdi = 7
+	};
+
+	// Opcodes of the "op r64, r/m64" and "op r/m64, r64" forms
+	enum: uint8_t {
+		op_xor = 0x33,
+		op_and = 0x23,
+		op_or = 0x0B,
+		op_xor_to_mem = 0x31,
+		op_and_to_reg = 0x21
+	};
+
+	// Opcodes of the VEX.256.66.0F AVX2 operations
+	enum: uint8_t {
+		vop_xor = 0xEF,
+		vop_and = 0xDB,
+		vop_or = 0xEB
+	};
+
+public:
+	X64Emitter(uint8_t base):
+		_base(base)
+	{ }
+
+	std::vector<uint8_t> const& code() const { return _code; }
+
+public:
+	void load(uint8_t reg, int32_t disp) { rex_w(); byte(0x8B); mem(reg, disp); }
+	void store(uint8_t reg, int32_t disp) { rex_w(); byte(0x89); mem(reg, disp); }
+	void op_mem(uint8_t opcode, uint8_t reg, int32_t disp) { rex_w(); byte(opcode); mem(reg, disp); }
+	void and_reg(uint8_t dst, uint8_t src) { rex_w(); byte(op_and_to_reg); byte(0xC0 | (src << 3) | dst); }
+	void store_zero(int32_t disp) { rex_w(); byte(0xC7); mem(0, disp); dword(0); }
+
+	void vload(uint8_t ymm, int32_t disp) { vex(0, 2); byte(0x6F); mem(ymm, disp); }
+	void vstore(uint8_t ymm, int32_t disp) { vex(0, 2); byte(0x7F); mem(ymm, disp); }
+	void vop_mem(uint8_t opcode, uint8_t dst, uint8_t src1, int32_t disp) { vex(src1, 1); byte(opcode); mem(dst, disp); }
+	void vop_reg(uint8_t opcode, uint8_t dst, uint8_t src1, uint8_t src2) { vex(src1, 1); byte(opcode); byte(0xC0 | (dst << 3) | src2); }
+	void vzeroupper() { byte(0xC5); byte(0xF8); byte(0x77); }
+
+	void ret() { byte(0xC3); }
+
+private:
+	void byte(uint8_t b) { _code.push_back(b); }
+	void dword(int32_t v)
+	{
+		const uint32_t u = v;
+		for (unsigned i = 0; i < 4; i++) {
+			byte((u >> (i*8)) & 0xFF);
+		}
+	}
+	void rex_w() { byte(0x48); }
+	void mem(uint8_t reg, int32_t disp) { byte(0x80 | (reg << 3) | _base); dword(disp); }
+	// Two-byte VEX prefix (map 0F, 256 bits, no register extension)
+	void vex(uint8_t vvvv, uint8_t pp) { byte(0xC5); byte(0x80 | ((~vvvv & 0xF) << 3) | 0x04 | pp); }
+
+private:
+	std::vector<uint8_t> _code;
+	uint8_t _base;
+};
+
+bool has_avx2()
+{
+#if defined(__GNUC__)
+	static const bool ret = __builtin_cpu_supports("avx2");
+	return ret;
+#else
+	return false;
+#endif
+}
+#endif
+
+} // anonymous
+
+pa::JitFunction::JitFunction(BitslicedEvaluator&& ev):
+	_ev(std::move(ev)),
+	_mem64{nullptr, 0},
+	_mem256{nullptr, 0},
+	_code64(nullptr),
+	_code256(nullptr)
+{
+#ifdef PA_JIT_X86_64
+	_mem64 = generate(1);
+	_code64 = reinterpret_cast<code_type>(_mem64.mem);
+	if (_code64 && has_avx2()) {
+		_mem256 = generate(4);
+		_code256 = reinterpret_cast<code_type>(_mem256.mem);
+	}
+#endif
+}
+
+pa::JitFunction::~JitFunction()
+{
+	release(_mem64);
+	release(_mem256);
+}
+
+size_t pa::JitFunction::code_size() const
+{
+	return _mem64.size + _mem256.size;
+}
+
+pa::JitFunction::Code pa::JitFunction::generate(unsigned lane_words) const
+{
+	Code ret{nullptr, 0};
+#ifdef PA_JIT_X86_64
+	typedef BitslicedEvaluator::Op Op;
+	typedef X64Emitter E;
+
+	// Registers of the evaluator are followed by the accumulators of the
+	// ESF instructions
+	const size_t slot_bytes = lane_words*sizeof(word_type);
+	const uint32_t esf_base = _ev._nregs;
+	if ((_ev._nregs + _ev._max_degree)*slot_bytes > (size_t)std::numeric_limits<int32_t>::max()) {
+		return ret;
+	}
+	auto disp = [slot_bytes](uint32_t slot) { return (int32_t)(slot*slot_bytes); };
+
+#ifdef _WIN32
+	E e(E::rcx);
+#else
+	E e(E::rdi);
+#endif
+	for (BitslicedEvaluator::Instr const& instr: _ev._instrs) {
+		uint32_t const* a = &_ev._args[instr.args_begin];
+		uint32_t const* const a_end = &_ev._args[instr.args_end];
+		const uint32_t degree = instr.degree;
+		if (lane_words == 1) {
+			switch (instr.op) {
+				case Op::Xor:
+				case Op::And:
+				case Op::Or:
+				{
+					const uint8_t opcode = instr.op == Op::Xor ? E::op_xor : (instr.op == Op::And ? E::op_and : E::op_or);
+					e.load(E::rax, disp(*a++));
+					for (; a != a_end; ++a) {
+						e.op_mem(opcode, E::rax, disp(*a));
+					}
+					break;
+				}
+				case Op::ESF:
+					for (uint32_t j = 0; j < degree; j++) {
+						e.store_zero(disp(esf_base + j));
+					}
+					for (; a != a_end; ++a) {
+						e.load(E::rdx, disp(*a));
+						for (uint32_t j = degree-1; j > 0; j--) {
+							e.load(E::rax, disp(esf_base + j-1));
+							e.and_reg(E::rax, E::rdx);
+							e.op_mem(E::op_xor_to_mem, E::rax, disp(esf_base + j));
+						}
+						e.op_mem(E::op_xor_to_mem, E::rdx, disp(esf_base));
+					}
+					e.load(E::rax, disp(esf_base + degree-1));
+					break;
+			};
+			e.store(E::rax, disp(instr.dst));
+		}
+		else {
+			switch (instr.op) {
+				case Op::Xor:
+				case Op::And:
+				case Op::Or:
+				{
+					const uint8_t opcode = instr.op == Op::Xor ? E::vop_xor : (instr.op == Op::And ? E::vop_and : E::vop_or);
+					e.vload(0, disp(*a++));
+					for (; a != a_end; ++a) {
+						e.vop_mem(opcode, 0, 0, disp(*a));
+					}
+					break;
+				}
+				case Op::ESF:
+					e.vop_reg(E::vop_xor, 2, 2, 2);
+					for (uint32_t j = 0; j < degree; j++) {
+						e.vstore(2, disp(esf_base + j));
+					}
+					for (; a != a_end; ++a) {
+						e.vload(1, disp(*a));
+						for (uint32_t j = degree-1; j > 0; j--) {
+							e.vop_mem(E::vop_and, 2, 1, disp(esf_base + j-1));
+							e.vop_mem(E::vop_xor, 2, 2, disp(esf_base + j));
+							e.vstore(2, disp(esf_base + j));
+						}
+						e.vop_mem(E::vop_xor, 2, 1, disp(esf_base));
+						e.vstore(2, disp(esf_base));
+					}
+					e.vload(0, disp(esf_base + degree-1));
+					break;
+			};
+			e.vstore(0, disp(instr.dst));
+		}
+	}
+	if (lane_words > 1) {
+		e.vzeroupper();
+	}
+	e.ret();
+
+	std::vector<uint8_t> const& code = e.code();
+	void* mem;
+#ifdef _WIN32
+	mem = VirtualAlloc(nullptr, code.size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (mem == nullptr) {
+		return ret;
+	}
+	memcpy(mem, &code[0], code.size());
+	DWORD old;
+	if (!VirtualProtect(mem, code.size(), PAGE_EXECUTE_READ, &old)) {
+		VirtualFree(mem, 0, MEM_RELEASE);
+		return ret;
+	}
+#else
+	mem = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		return ret;
+	}
+	memcpy(mem, &code[0], code.size());
+	if (mprotect(mem, code.size(), PROT_READ | PROT_EXEC) != 0) {
+		munmap(mem, code.size());
+		return ret;
+	}
+#endif
+	ret.mem = mem;
+	ret.size = code.size();
+#else
+	(void)lane_words;
+#endif
+	return ret;
+}
+
+void pa::JitFunction::release(Code& c)
+{
+	if (c.mem == nullptr) {
+		return;
+	}
+#ifdef PA_JIT_X86_64
+#ifdef _WIN32
+	VirtualFree(c.mem, 0, MEM_RELEASE);
+#else
+	munmap(c.mem, c.size);
+#endif
+#endif
+	c.mem = nullptr;
+	c.size = 0;
+}
+
+void pa::JitFunction::operator()(word_type const* in, word_type* out) const
+{
+	if (!is_native()) {
+		_ev.eval(in, out, 1);
+		return;
+	}
+
+	// Each bit is broadcasted to a full word, so that the 64 evaluations done
+	// by the native code are the same
+	static thread_local std::vector<word_type> regs;
+	regs.resize(_ev._nregs + _ev._max_degree);
+	word_type* const R = &regs[0];
+	R[BitslicedEvaluator::reg_zero] = 0;
+	R[BitslicedEvaluator::reg_one] = ~word_type{0};
+	for (size_t i = 0; i < ninputs(); i++) {
+		R[BitslicedEvaluator::reg_inputs + i] = -((in[i/BitslicedEvaluator::word_bits] >> (i%BitslicedEvaluator::word_bits)) & 1);
+	}
+	_code64(R);
+	std::fill(out, out + output_row_words(), 0);
+	for (size_t i = 0; i < noutputs(); i++) {
+		out[i/BitslicedEvaluator::word_bits] |= (R[_ev._outputs[i]] & 1) << (i%BitslicedEvaluator::word_bits);
+	}
+}
+
+void pa::JitFunction::run(code_type f, unsigned lane_words, word_type const* in, word_type* out, size_t nwords, size_t begin, size_t end) const
+{
+	const size_t L = lane_words;
+	std::vector<word_type> regs((_ev._nregs + _ev._max_degree)*L, 0);
+	std::fill(&regs[BitslicedEvaluator::reg_one*L], &regs[(BitslicedEvaluator::reg_one+1)*L], ~word_type{0});
+	word_type* const R = &regs[0];
+	for (size_t b = begin; b < end; b += L) {
+		for (size_t i = 0; i < ninputs(); i++) {
+			memcpy(&R[(BitslicedEvaluator::reg_inputs+i)*L], &in[i*nwords + b], L*sizeof(word_type));
+		}
+		f(R);
+		for (size_t i = 0; i < noutputs(); i++) {
+			memcpy(&out[i*nwords + b], &R[_ev._outputs[i]*L], L*sizeof(word_type));
+		}
+	}
+}
+
+void pa::JitFunction::eval_planes(word_type const* in, word_type* out, size_t nwords) const
+{
+	if (!is_native()) {
+		_ev.eval_planes(in, out, nwords);
+		return;
+	}
+
+	const unsigned L = _code256 ? 4 : 1;
+	code_type const f = _code256 ? _code256 : _code64;
+	const size_t nblocks = nwords/L;
+#ifdef PA_USE_TBB
+	const size_t grain = std::max(size_t{1}, (size_t{1} << 14)/(L*(_ev.ninstructions()+1)));
+	if (nblocks > grain) {
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, nblocks, grain),
+			[&](tbb::blocked_range<size_t> const& r) {
+				run(f, L, in, out, nwords, r.begin()*L, r.end()*L);
+			});
+	}
+	else
+#endif
+	{
+		run(f, L, in, out, nwords, 0, nblocks*L);
+	}
+	if (nblocks*L < nwords) {
+		run(_code64, 1, in, out, nwords, nblocks*L, nwords);
+	}
+}
+
+void pa::JitFunction::eval(word_type const* in, word_type* out, size_t n) const
+{
+	const size_t nwords = BitslicedEvaluator::words_for(n);
+	std::vector<word_type> in_planes(ninputs()*nwords);
+	std::vector<word_type> out_planes(noutputs()*nwords);
+	BitslicedEvaluator::rows_to_planes(in, n, ninputs(), in_planes.data());
+	eval_planes(in_planes.data(), out_planes.data(), nwords);
+	BitslicedEvaluator::planes_to_rows(out_planes.data(), n, noutputs(), out);
+}
+
+std::vector<pa::JitFunction::word_type> pa::JitFunction::eval(std::vector<word_type> const& values) const
+{
+	const size_t in_row = input_row_words();
+	if ((in_row == 0 && !values.empty()) || (in_row > 0 && values.size() % in_row != 0)) {
+		throw errors::SizeMismatch{};
+	}
+	const size_t n = in_row == 0 ? 0 : values.size()/in_row;
+	std::vector<word_type> ret(n*output_row_words());
+	eval(values.data(), ret.data(), n);
+	return ret;
+}
+
+namespace {
+
+struct JitCacheEntry
+{
+	pa::Vector outputs;
+	pa::Vector inputs;
+	std::shared_ptr<pa::JitFunction const> f;
+};
+
+// Process-wide cache of compiled functions. The oldest entries are evicted
+// once the cache is full.
+struct JitCache
+{
+	static constexpr size_t capacity = 256;
+
+	std::mutex mutex;
+	std::unordered_multimap<uint64_t, JitCacheEntry> entries;
+	std::deque<std::pair<uint64_t, pa::JitFunction const*>> order;
+};
+
+constexpr size_t JitCache::capacity;
+
+JitCache& jit_cache()
+{
+	static JitCache cache;
+	return cache;
+}
+
+inline uint64_t hash_combine(uint64_t h, uint64_t v)
+{
+	return (h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)))*0x5555555555555555ULL;
+}
+
+uint64_t hash_vectors(pa::Vector const& outputs, pa::Vector const& inputs)
+{
+	uint64_t h = hash_combine(outputs.size(), inputs.size());
+	for (pa::Expr const& e: outputs) {
+		h = hash_combine(h, e.hash());
+	}
+	for (pa::Expr const& e: inputs) {
+		h = hash_combine(h, e.hash());
+	}
+	return h;
+}
+
+std::shared_ptr<pa::JitFunction const> cache_find(JitCache& cache, uint64_t h, pa::Vector const& outputs, pa::Vector const& inputs)
+{
+	auto range = cache.entries.equal_range(h);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second.outputs == outputs && it->second.inputs == inputs) {
+			return it->second.f;
+		}
+	}
+	return nullptr;
+}
+
+} // anonymous
+
+std::shared_ptr<pa::JitFunction const> pa::jit_compile(Vector const& outputs, Vector const& inputs)
+{
+	JitCache& cache = jit_cache();
+	const uint64_t h = hash_vectors(outputs, inputs);
+	{
+		std::lock_guard<std::mutex> lock(cache.mutex);
+		auto ret = cache_find(cache, h, outputs, inputs);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	// Compile without holding the lock
+	std::shared_ptr<JitFunction const> f = std::make_shared<JitFunction>(BitslicedEvaluator(outputs, inputs));
+
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	auto ret = cache_find(cache, h, outputs, inputs);
+	if (ret) {
+		return ret;
+	}
+	if (cache.order.size() >= JitCache::capacity) {
+		auto const& oldest = cache.order.front();
+		auto range = cache.entries.equal_range(oldest.first);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second.f.get() == oldest.second) {
+				cache.entries.erase(it);
+				break;
+			}
+		}
+		cache.order.pop_front();
+	}
+	cache.entries.insert(std::make_pair(h, JitCacheEntry{outputs, inputs, f}));
+	cache.order.emplace_back(h, f.get());
+	return f;
+}
+
+std::shared_ptr<pa::JitFunction const> pa::jit_compile(App const& app)
+{
+	Vector outputs;
+	Vector inputs;
+	BitslicedEvaluator::app_vectors(app, outputs, inputs);
+	return jit_compile(outputs, inputs);
+}
+
+size_t pa::jit_cache_size()
+{
+	JitCache& cache = jit_cache();
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	return cache.entries.size();
+}
+
+void pa::jit_cache_clear()
+{
+	JitCache& cache = jit_cache();
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	cache.entries.clear();
+	cache.order.clear();
+}
@@ -23,9 +23,11 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <pa/bitmatrix.h>
 #include <pa/compat.h>
 #include <pa/errors.h>
 #include <pa/matrix.h>
+#include <pa/products.h>
 
 pa::Matrix::Matrix(size_t const ncols, std::initializer_list<Expr> const& args):
 	Vector(),
@@ -81,18 +83,25 @@ pa::Vector pa::Matrix::operator*(Vector const& o) const
 		throw errors::SizeMismatch();
 	}
 
+	// Matrices of immediates only select elements of o
+	BitMatrix bits;
+	if (BitMatrix::from_matrix(*this, bits)) {
+		return bits*o;
+	}
+
 	pa::Vector ret;
 	pa::Vector::storage_type& ret_args = ret.args();
 	ret_args.reserve(o.size());
 
 	const size_t nlines_ = nlines();
 	for (size_t i = 0; i < nlines_; i++) {
-		pa::Expr add = pa::ExprAdd();
-		pa::ExprArgs& add_args = add.args();
+		ExprTerms terms;
+		terms.reserve(ncols_);
 		for (size_t j = 0; j < ncols_; j++) {
-			add_args.insert_dup(at(i, j) * o.at(j));
+			terms.emplace_back(at(i, j) * o.at(j));
 		}
-		ret_args.emplace_back(std::move(add));
+		sort_terms(terms, false);
+		ret_args.emplace_back(pa::ExprAdd(pa::ExprArgs(true, std::move(terms))));
 	}
 
 	return ret;
@@ -112,16 +121,20 @@ pa::Matrix pa::Matrix::operator*(Matrix const& o) const
 	if (size() != o.size() || o.ncols() != nlines()) {
 		throw errors::SizeMismatch();
 	}
+	BitMatrix a, b;
+	if (BitMatrix::from_matrix(*this, a) && BitMatrix::from_matrix(o, b)) {
+		return (a*b).to_matrix();
+	}
 	pa::Matrix ret(nlines(), o.ncols());
 	for (size_t i = 0; i < nlines(); i++) {
 		for (size_t j = 0; j < o.ncols(); j++) {
-			pa::Expr add = pa::ExprAdd();
-			pa::ExprArgs& add_args = add.args();
-			add_args.reserve(ncols());
+			ExprTerms terms;
+			terms.reserve(ncols());
 			for (size_t k = 0; k < ncols(); k++) {
-				add_args.insert_dup(at(i,k) * o.at(k, j));
+				terms.emplace_back(at(i,k) * o.at(k, j));
 			}
-			ret.at(i, j) = std::move(add);
+			sort_terms(terms, false);
+			ret.at(i, j) = pa::ExprAdd(pa::ExprArgs(true, std::move(terms)));
 		}	
 	}
 
@@ -149,6 +162,15 @@ bool pa::Matrix::operator!=(Matrix const& o) const
 // Mainly inspired by http://itpp.sourceforge.net/4.3.1/gf2mat_8cpp_source.html#l00561
 size_t pa::Matrix::T_fact(Matrix& T, Matrix& U, std::vector<size_t>& perm) const
 {
+	BitMatrix bits;
+	if (BitMatrix::from_matrix(*this, bits)) {
+		BitMatrix T_bits, U_bits;
+		const size_t ret = bits.T_fact(T_bits, U_bits, perm);
+		T = T_bits.to_matrix();
+		U = U_bits.to_matrix();
+		return ret;
+	}
+
 	T = identity(nlines());
 	U = *this;
 
@@ -220,6 +242,12 @@ pa::Matrix pa::Matrix::inverse() const
 		return pa::Matrix();
 	}
 
+	BitMatrix bits;
+	if (BitMatrix::from_matrix(*this, bits)) {
+		BitMatrix inv = bits.inverse();
+		return inv.empty() ? pa::Matrix() : inv.to_matrix();
+	}
+
 	// first compute the T-factorization
 	pa::Matrix T, U;
 	std::vector<size_t> perm;
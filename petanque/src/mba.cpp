@@ -0,0 +1,578 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/errors.h>
+#include <pa/mba.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+#include <pa/vector_view.h>
+
+#include <cassert>
+#include <string>
+
+namespace {
+
+pa::Expr simplified(pa::Expr e)
+{
+	pa::simps::simplify(e);
+	return e;
+}
+
+// Helpers over pa::MBA::Constant. The arithmetic ones (used to compute
+// magic numbers) expect operands of the same number of words, and drop the
+// bits that do not fit.
+typedef pa::MBA::Constant Constant;
+
+bool bit(Constant const& n, const size_t i)
+{
+	return (i/64 < n.size()) && ((n[i/64] >> (i%64)) & 1);
+}
+
+void set_bit(Constant& n, const size_t i)
+{
+	n[i/64] |= uint64_t{1} << (i%64);
+}
+
+// Index of the most significant bit of n plus one (0 if n is 0)
+size_t bit_length(Constant const& n)
+{
+	for (size_t w = n.size(); w > 0; w--) {
+		uint64_t v = n[w-1];
+		if (v == 0) {
+			continue;
+		}
+		size_t ret = (w-1)*64;
+		while (v != 0) {
+			v >>= 1;
+			ret++;
+		}
+		return ret;
+	}
+	return 0;
+}
+
+int compare(Constant const& a, Constant const& b)
+{
+	assert(a.size() == b.size());
+	for (size_t w = a.size(); w > 0; w--) {
+		if (a[w-1] != b[w-1]) {
+			return (a[w-1] < b[w-1]) ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+void add(Constant& a, Constant const& b)
+{
+	assert(a.size() == b.size());
+	uint64_t carry = 0;
+	for (size_t w = 0; w < a.size(); w++) {
+		const uint64_t v = a[w] + carry;
+		carry = (v < carry);
+		a[w] = v + b[w];
+		carry += (a[w] < v);
+	}
+}
+
+void sub(Constant& a, Constant const& b)
+{
+	assert(a.size() == b.size());
+	uint64_t borrow = 0;
+	for (size_t w = 0; w < a.size(); w++) {
+		const uint64_t v = a[w] - borrow;
+		borrow = (a[w] < borrow);
+		borrow += (v < b[w]);
+		a[w] = v - b[w];
+	}
+}
+
+// a = 2*a + low
+void shl1(Constant& a, const bool low)
+{
+	uint64_t carry = low;
+	for (uint64_t& v: a) {
+		const uint64_t new_carry = v >> 63;
+		v = (v << 1) | carry;
+		carry = new_carry;
+	}
+}
+
+// Clears the bits of a from nbits
+void truncate(Constant& a, const size_t nbits)
+{
+	for (size_t w = 0; w < a.size(); w++) {
+		if (w*64 >= nbits) {
+			a[w] = 0;
+		}
+		else
+		if (nbits - w*64 < 64) {
+			a[w] &= (uint64_t{1} << (nbits - w*64)) - 1;
+		}
+	}
+}
+
+// Magic number m and shift p such that x/d == (x*m)>>p for every nbits bits
+// unsigned integer x, with p the smallest such shift in [nbits, 2*nbits].
+// m has nbits+1 bits: it is returned as its nbits least significant bits,
+// and its most significant one (Hacker's Delight, figure 10-2, generalized
+// to nbits bits words). d must be in [1, 2**nbits-1].
+struct Magic
+{
+	Constant m;
+	bool m_high;
+	size_t p;
+};
+
+Magic magicu(Constant d, const size_t nbits)
+{
+	// Intermediate values need up to nbits+1 bits
+	const size_t nwords = nbits/64 + 1;
+	d.resize(nwords, 0);
+	Constant one(nwords, 0);
+	one[0] = 1;
+	Constant half(nwords, 0);
+	set_bit(half, nbits-1);
+	Constant half_1 = half;
+	sub(half_1, one);
+
+	Magic ret{Constant{}, false, nbits-1};
+	// q, r = divmod(half-1, d)
+	Constant q(nwords, 0);
+	Constant r(nwords, 0);
+	for (size_t i = nbits-1; i > 0; i--) {
+		shl1(r, bit(half_1, i-1));
+		shl1(q, false);
+		if (compare(r, d) >= 0) {
+			sub(r, d);
+			q[0] |= 1;
+		}
+	}
+	// 2**(p-nbits)
+	Constant p2(nwords, 0);
+	Constant delta;
+	do {
+		ret.p++;
+		if (ret.p == nbits) {
+			p2 = one;
+		}
+		else {
+			shl1(p2, false);
+		}
+		Constant r_1 = r;
+		add(r_1, one);
+		Constant d_r = d;
+		sub(d_r, r);
+		if (compare(r_1, d_r) >= 0) {
+			if (compare(q, half_1) >= 0) {
+				ret.m_high = true;
+			}
+			shl1(q, true);
+			shl1(r, true);
+			sub(r, d);
+		}
+		else {
+			if (compare(q, half) >= 0) {
+				ret.m_high = true;
+			}
+			shl1(q, false);
+			shl1(r, true);
+		}
+		truncate(q, nbits);
+		delta = d;
+		sub(delta, one);
+		sub(delta, r);
+	} while (ret.p < 2*nbits && compare(p2, delta) < 0);
+	add(q, one);
+	truncate(q, nbits);
+	ret.m = std::move(q);
+	return ret;
+}
+
+} // anonymous
+
+pa::MBA::MBA(const size_t nbits):
+	_nbits(nbits),
+	_use_esf(false),
+	_use_opt_mba(true)
+{ }
+
+void pa::MBA::check_size(Vector const& X) const
+{
+	if (X.size() != _nbits) {
+		throw errors::SizeMismatch();
+	}
+}
+
+pa::MBA::Constant pa::MBA::masked(Constant n) const
+{
+	n.resize((_nbits+63)/64, 0);
+	truncate(n, _nbits);
+	return n;
+}
+
+pa::Vector pa::MBA::cst(Constant const& n) const
+{
+	Vector ret(_nbits);
+	for (size_t i = 0; i < _nbits; i++) {
+		if (bit(n, i)) {
+			ret[i] = ExprImm(1);
+		}
+	}
+	return ret;
+}
+
+pa::Vector pa::MBA::var_symbols(std::string const& name) const
+{
+	Vector ret(_nbits);
+	for (size_t i = 0; i < _nbits; i++) {
+		ret[i] = symbol((name + std::to_string(i)).c_str());
+	}
+	return ret;
+}
+
+pa::Vector pa::MBA::add_Y(Vector const& X, Vector const& Y) const
+{
+	check_size(X);
+	check_size(Y);
+	Vector ret(_nbits);
+	Expr carry = ExprImm(0);
+	if (_use_esf) {
+		for (size_t i = 0; i < _nbits; i++) {
+			ret[i] = simplified(X[i] + Y[i] + carry);
+			carry = ExprESF(2, {X[i], Y[i], carry});
+		}
+	}
+	else {
+		for (size_t i = 0; i < _nbits; i++) {
+			const Expr sum_XY = simplified(X[i] + Y[i]);
+			ret[i] = simplified(sum_XY + carry);
+			carry = simplified(X[i]*Y[i] + carry*sum_XY);
+		}
+	}
+	return ret;
+}
+
+void pa::MBA::iadd_Y(Vector& X, Vector const& Y) const
+{
+	check_size(X);
+	check_size(Y);
+	Expr carry = ExprImm(0);
+	if (_use_esf) {
+		for (size_t i = 0; i < _nbits; i++) {
+			Expr new_carry = ExprESF(2, {X[i], Y[i], carry});
+			X[i] += simplified(Y[i] + carry);
+			carry = std::move(new_carry);
+		}
+	}
+	else {
+		for (size_t i = 0; i < _nbits; i++) {
+			const Expr sum_XY = simplified(X[i] + Y[i]);
+			Expr new_carry = simplified(X[i]*Y[i] + carry*sum_XY);
+			X[i] = sum_XY + carry;
+			carry = std::move(new_carry);
+		}
+	}
+}
+
+pa::Vector pa::MBA::add_n(Vector const& X, Constant const& n) const
+{
+	Vector ret = X;
+	iadd_n(ret, n);
+	return ret;
+}
+
+void pa::MBA::iadd_n(Vector& X, Constant const& n) const
+{
+	check_size(X);
+	if (_use_esf || !_use_opt_mba) {
+		iadd_Y(X, cst(n));
+		return;
+	}
+	iadd_n_mba(X, n);
+}
+
+void pa::MBA::iadd_n_mba(Vector& X, Constant const& n) const
+{
+	// The carries are shifted out after at most nbits iterations
+	const Vector null(_nbits);
+	Vector N = cst(n);
+	while (N != null) {
+		Vector carry = X*N;
+		simps::simplify(carry);
+		X += N;
+		simps::simplify(X);
+		N = carry >> 1;
+	}
+}
+
+void pa::MBA::iadd_lshifted_Y(Vector& X, Vector const& Y, const size_t offset) const
+{
+	check_size(X);
+	check_size(Y);
+	if (_use_esf) {
+		iadd_Y(X, VectorView::shift_right(Y, offset));
+		simps::simplify(X);
+		return;
+	}
+	Expr carry = ExprImm(0);
+	for (size_t i = offset; i < _nbits; i++) {
+		Expr const& Yi = Y[i-offset];
+		Expr& Xi = X[i];
+		const Expr mul_XY = simplified(Xi*Yi);
+		Xi += Yi;
+		simps::simplify(Xi);
+		Expr new_carry = simplified(mul_XY + carry*Xi);
+		Xi += carry;
+		simps::simplify(Xi);
+		carry = std::move(new_carry);
+	}
+}
+
+pa::Vector pa::MBA::sub_Y(Vector const& X, Vector const& Y) const
+{
+	check_size(X);
+	check_size(Y);
+	Vector ret(_nbits);
+	Expr carry = ExprImm(0);
+	if (_use_esf) {
+		for (size_t i = 0; i < _nbits; i++) {
+			ret[i] = simplified(X[i] + Y[i] + carry);
+			carry = ExprESF(2, {X[i] + ExprImm(1), Y[i], carry});
+		}
+	}
+	else {
+		for (size_t i = 0; i < _nbits; i++) {
+			const Expr sum_XY = simplified(X[i] + Y[i]);
+			ret[i] = simplified(sum_XY + carry);
+			carry = simplified((X[i] + ExprImm(1))*Y[i] + carry*(sum_XY + ExprImm(1)));
+		}
+	}
+	return ret;
+}
+
+pa::Vector pa::MBA::sub_n(Vector const& X, Constant const& n) const
+{
+	return sub_Y(X, cst(n));
+}
+
+pa::Vector pa::MBA::mul_Y(Vector const& X, Vector const& Y) const
+{
+	check_size(X);
+	check_size(Y);
+	Vector ret(_nbits);
+	for (size_t i = 0; i < _nbits; i++) {
+		iadd_Y(ret, VectorView::shift_right(X, i) * Y[i]);
+	}
+	return ret;
+}
+
+pa::Vector pa::MBA::mul_n(Vector const& X, Constant const& n) const
+{
+	check_size(X);
+	const Constant N = masked(n);
+	const size_t nlen = bit_length(N);
+	if (nlen == 1) {
+		return X;
+	}
+	Vector ret(_nbits);
+	if (nlen == 0) {
+		return ret;
+	}
+
+	// Optimisations from the Hacker's delight: runs of ones in n are
+	// computed as differences, with the help of ~X
+	Vector not_x;
+	auto compute_not_x = [&]() {
+		if (not_x.empty()) {
+			not_x = not_X(X);
+		}
+	};
+	Constant final_sum(N.size(), 0);
+	bool has_final_sum = false;
+	size_t i = 0;
+	while (i < nlen) {
+		size_t nz = 0;
+		while (bit(N, i+nz)) {
+			nz++;
+		}
+		if (nz >= 3) {
+			compute_not_x();
+			iadd_lshifted_Y(ret, X, nz+i);
+			iadd_lshifted_Y(ret, not_x, i);
+			set_bit(final_sum, i);
+			has_final_sum = true;
+			i += nz;
+			continue;
+		}
+		const unsigned bits4 = bit(N, i) | (bit(N, i+1) << 1) | (bit(N, i+2) << 2) | (bit(N, i+3) << 3);
+		if (bits4 == 0xB || bits4 == 0xD) {
+			// 0b1011 = 0b10000 - 0b100 - 0b1, and 0b1101 = 0b10000 - 0b10
+			// - 0b1
+			const size_t j = (bits4 == 0xB) ? 2 : 1;
+			compute_not_x();
+			iadd_lshifted_Y(ret, X, 4+i);
+			iadd_lshifted_Y(ret, not_x, j+i);
+			iadd_lshifted_Y(ret, not_x, i);
+			set_bit(final_sum, i+j);
+			set_bit(final_sum, i);
+			has_final_sum = true;
+			i += 4;
+			continue;
+		}
+		if (bit(N, i)) {
+			iadd_lshifted_Y(ret, X, i);
+		}
+		i++;
+	}
+	if (has_final_sum) {
+		iadd_n(ret, final_sum);
+	}
+	return ret;
+}
+
+pa::Vector pa::MBA::div_n(Vector const& X, Constant const& n) const
+{
+	check_size(X);
+	const size_t nlen = bit_length(n);
+	if (nlen == 0) {
+		throw errors::DivisionByZero();
+	}
+	if (_nbits == 0) {
+		return X;
+	}
+	if (nlen > _nbits) {
+		return Vector(_nbits);
+	}
+	const Magic magic = magicu(n, _nbits);
+
+	MBA wide(2*_nbits+1);
+	wide.set_use_esf(_use_esf);
+	wide.set_use_opt_mba(_use_opt_mba);
+	const Vector wide_X = VectorView::extend(X, wide.nbits());
+	Vector ret = wide.mul_n(wide_X, magic.m);
+	if (magic.m_high) {
+		wide.iadd_lshifted_Y(ret, wide_X, _nbits);
+	}
+	return VectorView::extend(wide.rshift_n(ret, magic.p), _nbits);
+}
+
+pa::Vector pa::MBA::not_X(Vector const& X) const
+{
+	check_size(X);
+	Vector ret;
+	ret.args().reserve(_nbits);
+	for (Expr const& e: X) {
+		ret.args().emplace_back(e + ExprImm(1));
+	}
+	return ret;
+}
+
+pa::Vector pa::MBA::oppose_X(Vector const& X) const
+{
+	return add_n(not_X(X), 1);
+}
+
+pa::Vector pa::MBA::and_n(Vector const& X, Constant const& n) const
+{
+	check_size(X);
+	Vector ret(_nbits);
+	for (size_t i = 0; i < _nbits; i++) {
+		if (bit(n, i)) {
+			ret[i] = X[i];
+		}
+	}
+	return ret;
+}
+
+pa::Vector pa::MBA::xor_n(Vector const& X, Constant const& n) const
+{
+	check_size(X);
+	Vector ret = X;
+	for (size_t i = 0; i < _nbits; i++) {
+		if (bit(n, i)) {
+			ret[i] += ExprImm(1);
+		}
+	}
+	return ret;
+}
+
+pa::Vector pa::MBA::or_n(Vector const& X, Constant const& n) const
+{
+	check_size(X);
+	Vector ret = X;
+	for (size_t i = 0; i < _nbits; i++) {
+		if (bit(n, i)) {
+			ret[i] = ExprImm(1);
+		}
+	}
+	return ret;
+}
+
+pa::Vector pa::MBA::or_Y(Vector const& X, Vector const& Y) const
+{
+	check_size(X);
+	check_size(Y);
+	if (_use_esf) {
+		Vector ret(_nbits);
+		for (size_t i = 0; i < _nbits; i++) {
+			ret[i] = ExprESF(2, {X[i], Y[i]}) + ExprESF(1, {X[i], Y[i]});
+		}
+		return ret;
+	}
+	return X*Y + (X + Y);
+}
+
+pa::Vector pa::MBA::lshift_n(Vector const& X, const size_t n) const
+{
+	check_size(X);
+	return X >> n;
+}
+
+pa::Vector pa::MBA::rshift_n(Vector const& X, const size_t n) const
+{
+	check_size(X);
+	return X << n;
+}
+
+pa::Vector pa::MBA::arshift_n(Vector const& X, const size_t n) const
+{
+	check_size(X);
+	if (_nbits == 0) {
+		return X;
+	}
+	return VectorView::shift_left(X, n, X[_nbits-1]);
+}
+
+pa::Vector pa::MBA::rol_n(Vector const& X, const size_t n) const
+{
+	check_size(X);
+	return VectorView::rotate_right(X, n);
+}
+
+pa::Vector pa::MBA::ror_n(Vector const& X, const size_t n) const
+{
+	check_size(X);
+	return VectorView::rotate_left(X, n);
+}
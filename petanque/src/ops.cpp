@@ -25,197 +25,100 @@
 
 #include <pa/exprs.h>
 #include <pa/cast.h>
+#include <pa/esf.h>
+#include <pa/ops_rules.h>
+
+#include <algorithm>
 
 namespace pa {
 
 namespace ops {
 
-// Or
-
-static Expr or_(Expr const& a, Expr const& b)
+// Appends e to the arguments of ret, or the arguments of e if it has the
+// same type. Arguments of additions cancel each other.
+static void append_arg(ExprAdd& ret, Expr const& e)
 {
-	expr_type_id ta = a.type();
-	expr_type_id tb = b.type();
-	if ((&a == &b) || (a == b)) {
-		return a;
-	}
-
-	Expr const* ea = &a;
-	Expr const* eb = &b;
-	if (ta > tb) {
-		std::swap(ta, tb);
-		std::swap(ea, eb);
+	if (e.is_add()) {
+		ret.extend_args(e.args());
 	}
-
-	if (tb == expr_type_id::imm_type) {
-		ExprImm const& b_ = expr_static_cast<ExprImm const&>(*eb);
-		if (b_.value() == 1) {
-			return ExprImm(1);
-		}
-		else {
-			return *ea;
-		}
+	else {
+		ret.emplace_arg(e);
 	}
+}
 
-	if (ta == expr_type_id::or_type) {
-		ExprOr const& a_ = expr_static_cast<ExprOr const&>(*ea);
-		ExprOr ret;
-		if (tb == expr_type_id::or_type) {
-			ExprOr const& b_ = expr_static_cast<ExprOr const&>(*eb);
-			ret.reserve_args(a_.nargs() + b_.nargs());
-			ret.extend_args(a_.args());
-			ret.extend_args_no_dup(b_.args());
-		}
-		else {
-			ret.reserve_args(a_.nargs() + 1);
-			ret.extend_args_no_dup(a_.args());
-			ret.emplace_arg_no_dup(*eb);
-		}
-		if (ret.nargs() == 1) {
-			return std::move(ret.args()[0]);
-		}
-		return std::move(ret);
+template <class E>
+static void append_arg(E& ret, Expr const& e)
+{
+	if (e.type() == E::type_id) {
+		ret.extend_args_no_dup(e.args());
 	}
-
-	return ExprOr({*ea, *eb});
-}
-
-// Additions
-
-static Expr add(Expr const& a, Expr const& b)
-{
-	expr_type_id ta = a.type();
-	expr_type_id tb = b.type();
-	if (ta == tb) {
-		if ((&a == &b) || (a == b)) {
-			return ExprImm(0);
-		}
-		switch (ta) {
-			case expr_type_id::add_type:
-			{
-				ExprAdd const& a_ = expr_static_cast<ExprAdd const&>(a);
-				ExprAdd const& b_ = expr_static_cast<ExprAdd const&>(b);
-				ExprAdd ret;
-				// Just one allocation done here
-				ret.reserve_args(a.nargs() + b.nargs());
-				ret.extend_args(a_.args());
-				ret.extend_args(b_.args());
-				assert(std::is_sorted(ret.args().begin(), ret.args().end()));
-				if (ret.nargs() == 0) {
-					return ExprImm{false};
-				}
-				if (ret.nargs() == 1) {
-					return std::move(ret.args()[0]);
-				}
-				return std::move(ret);
-			}
-			case expr_type_id::imm_type:
-			{
-				ExprImm const& a_ = expr_static_cast<ExprImm const&>(a);
-				ExprImm const& b_ = expr_static_cast<ExprImm const&>(b);
-				return ExprImm(a_.value() ^ b_.value());
-			}
-			case expr_type_id::symbol_type:
-			{
-				ExprSym const& a_ = expr_static_cast<ExprSym const&>(a);
-				ExprSym const& b_ = expr_static_cast<ExprSym const&>(b);
-				if (a_.idx() == b_.idx()) {
-					return ExprImm(0);
-				}
-				return ExprAdd({a_, b_});
-			}
-			default:
-				break;
-		};
-		return ExprAdd({a, b});
+	else {
+		ret.emplace_arg_no_dup(e);
 	}
+}
 
-	Expr const* ea = &a;
-	Expr const* eb = &b;
-	if (ta > tb) {
-		std::swap(ta, tb);
-		std::swap(ea, eb);
-	}
-	if (tb == expr_type_id::imm_type) {
-		ExprImm const& b_ = expr_static_cast<ExprImm const&>(*eb);
-		if (b_.value() == 0) {
-			return *ea;
-		}
+template <class E>
+static Expr merge_args(Expr const& a, Expr const& b)
+{
+	E ret;
+	// Just one allocation done here
+	ret.reserve_args(a.nargs() + ((b.type() == E::type_id) ? b.nargs() : 1));
+	append_arg(ret, a);
+	append_arg(ret, b);
+	assert(std::is_sorted(ret.args().begin(), ret.args().end()));
+	if (ret.nargs() == 0) {
+		return ExprImm{false};
 	}
-
-	if (tb == expr_type_id::add_type) {
-		std::swap(ta, tb);
-		std::swap(ea, eb);
+	if (ret.nargs() == 1) {
+		return std::move(ret.args()[0]);
 	}
+	return std::move(ret);
+}
 
-	if (ta == expr_type_id::add_type) {
-		ExprAdd const& a_ = expr_static_cast<ExprAdd const&>(*ea);
-		ExprAdd ret;
-		ret.reserve_args(a_.nargs() + 1);
-		ret.extend_args(a_.args());
-		ret.emplace_arg(*eb);
-		assert(std::is_sorted(ret.args().begin(), ret.args().end()));
-		if (ret.nargs() == 0) {
-			return ExprImm{false};
-		}
-		if (ret.nargs() == 1) {
-			return std::move(ret.args()[0]);
-		}
-		return std::move(ret);
-	}
+// Builds Expr objects for the rules of ops_rules.h
+struct ExprBuilder
+{
+	typedef Expr const* arg_type;
+	typedef Expr result_type;
 
-	return ExprAdd({a, b});
-}
+	expr_type_id type(Expr const* e) const { return e->type(); }
+	bool equal(Expr const* a, Expr const* b) const { return (a == b) || (*a == *b); }
+	bool imm_value(Expr const* e) const { return expr_static_cast<ExprImm const&>(*e).value(); }
 
-// Multiplications
+	Expr imm(bool v) const { return ExprImm(v); }
+	Expr copy(Expr const* e) const { return *e; }
 
-static Expr mul(Expr const& a, Expr const& b)
-{
-	expr_type_id ta = a.type();
-	expr_type_id tb = b.type();
-	if ((&a == &b) || (a == b)) {
-		return a;
-	}
+	size_t esf_degree(Expr const* e) const { return expr_static_cast<ExprESF const&>(*e).degree(); }
+	size_t nargs(Expr const* e) const { return e->nargs(); }
+	bool same_args(Expr const* a, Expr const* b) const { return a->args() == b->args(); }
+	Expr esf_product(Expr const* e, size_t deg) const { return pa::esf_product(esf_degree(e), deg, e->args()); }
 
-	Expr const* ea = &a;
-	Expr const* eb = &b;
-	if (ta > tb) {
-		std::swap(ta, tb);
-		std::swap(ea, eb);
-	}
-	if (tb == expr_type_id::imm_type) {
-		ExprImm const& b_ = expr_static_cast<ExprImm const&>(*eb);
-		if (b_.value() == 0) {
-			return ExprImm(0);
-		}
-		else {
-			return *ea;
-		}
+	Expr make(expr_type_id type, Expr const* a, Expr const* b) const
+	{
+		switch (type) {
+			case expr_type_id::or_type:
+				return ExprOr({*a, *b});
+			case expr_type_id::mul_type:
+				return ExprMul({*a, *b});
+			default:
+				assert(type == expr_type_id::add_type);
+				return ExprAdd({*a, *b});
+		};
 	}
 
-	if (ta == expr_type_id::mul_type) {
-		ExprMul const& a_ = expr_static_cast<ExprMul const&>(*ea);
-		ExprMul ret;
-		if (tb == expr_type_id::mul_type) {
-			ExprMul const& b_ = expr_static_cast<ExprMul const&>(*eb);
-			ret.reserve_args(a_.nargs() + b_.nargs());
-			ret.extend_args(a_.args());
-			ret.extend_args_no_dup(b_.args());
-		}
-		else {
-			ret.reserve_args(a_.nargs() + 1);
-			ret.extend_args(a_.args());
-			ret.emplace_arg_no_dup(*eb);
-		}
-		assert(std::is_sorted(ret.args().begin(), ret.args().end()));
-		if (ret.nargs() == 1) {
-			return std::move(ret.args()[0]);
-		}
-		return std::move(ret);
+	Expr merge(expr_type_id type, Expr const* a, Expr const* b) const
+	{
+		switch (type) {
+			case expr_type_id::or_type:
+				return merge_args<ExprOr>(*a, *b);
+			case expr_type_id::mul_type:
+				return merge_args<ExprMul>(*a, *b);
+			default:
+				assert(type == expr_type_id::add_type);
+				return merge_args<ExprAdd>(*a, *b);
+		};
 	}
-
-	return ExprMul({*ea, *eb});
-}
+};
 
 } // ops
 
@@ -223,17 +126,17 @@ static Expr mul(Expr const& a, Expr const& b)
 
 pa::Expr pa::Expr::operator|(Expr const& o) const
 {
-	return ops::or_(*this, o);
+	return __impl::or_(ops::ExprBuilder{}, this, &o);
 }
 
 pa::Expr pa::Expr::operator+(Expr const& o) const
 {
-	return ops::add(*this, o);
+	return __impl::add(ops::ExprBuilder{}, this, &o);
 }
 
 pa::Expr pa::Expr::operator*(Expr const& o) const
 {
-	return ops::mul(*this, o);
+	return __impl::mul(ops::ExprBuilder{}, this, &o);
 }
 
 // Generic expr
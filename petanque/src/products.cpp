@@ -0,0 +1,232 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/config.h>
+#include <pa/products.h>
+#include <pa/simps.h>
+
+#ifdef PA_USE_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif
+
+#include <algorithm>
+
+namespace {
+
+// Keys are made of the type of the expression (3 bits) followed by a 61-bit
+// payload that is non decreasing with the order of expressions of this type.
+// Expressions with arguments are first ordered by number of arguments, and
+// then by their first arguments. A second word holds the key of the second
+// argument, if the first one is fully described by its key.
+struct SortKey
+{
+	uint64_t hi;
+	uint64_t lo;
+	uint32_t idx;
+};
+
+constexpr unsigned type_shift = 61;
+constexpr unsigned nargs_bits = 21;
+constexpr unsigned arg_bits = 40;
+
+inline uint64_t capped(uint64_t v, unsigned bits)
+{
+	const uint64_t max = (uint64_t{1} << bits) - 1;
+	return v < max ? v : max;
+}
+
+// Non decreasing key of at most bits bits (which must be at least 32) of an
+// expression of a given type
+uint64_t payload_key(pa::Expr const& e, unsigned bits)
+{
+	switch (e.type()) {
+		case pa::expr_type_id::imm_type:
+			return e.as<pa::ExprImm>().value();
+		case pa::expr_type_id::symbol_type:
+			return e.as<pa::ExprSym>().idx();
+		case pa::expr_type_id::esf_type:
+			return capped(e.as<pa::ExprESF>().degree(), bits);
+		default:
+			break;
+	};
+	return capped(e.nargs(), bits);
+}
+
+inline uint64_t arg_key(pa::Expr const& e)
+{
+	return (static_cast<uint64_t>(e.type()) << (arg_bits-3)) | payload_key(e, arg_bits-3);
+}
+
+SortKey sort_key(pa::Expr const& e, uint32_t idx)
+{
+	SortKey ret{static_cast<uint64_t>(e.type()) << type_shift, 0, idx};
+	if (!e.has_args() || e.is_esf()) {
+		ret.hi |= payload_key(e, type_shift);
+		return ret;
+	}
+	pa::ExprArgs const& args = e.args();
+	const uint64_t nargs = capped(args.size(), nargs_bits);
+	ret.hi |= nargs << arg_bits;
+	// Arguments only matter if the number of arguments is exact
+	if (args.size() == 0 || nargs != args.size()) {
+		return ret;
+	}
+	ret.hi |= arg_key(args[0]);
+	if (args.size() > 1 && !args[0].has_args()) {
+		ret.lo = arg_key(args[1]);
+	}
+	return ret;
+}
+
+inline bool same_key(SortKey const& a, SortKey const& b)
+{
+	return a.hi == b.hi && a.lo == b.lo;
+}
+
+// Stable LSD radix sort of keys, by bytes (lo first). Bytes that are the same
+// in all the keys are skipped.
+void radix_sort(std::vector<SortKey>& keys)
+{
+	const size_t n = keys.size();
+	auto byte = [](SortKey const& k, unsigned b) -> unsigned {
+		return ((b < 8 ? k.lo : k.hi) >> ((b%8)*8)) & 0xFF;
+	};
+	std::vector<size_t> counts(16*256, 0);
+	for (SortKey const& k: keys) {
+		for (unsigned b = 0; b < 16; b++) {
+			counts[b*256 + byte(k, b)]++;
+		}
+	}
+	std::vector<SortKey> tmp(n);
+	for (unsigned b = 0; b < 16; b++) {
+		size_t* const c = &counts[b*256];
+		if (c[byte(keys[0], b)] == n) {
+			continue;
+		}
+		size_t pos = 0;
+		for (unsigned d = 0; d < 256; d++) {
+			const size_t cnt = c[d];
+			c[d] = pos;
+			pos += cnt;
+		}
+		for (SortKey const& k: keys) {
+			tmp[c[byte(k, b)]++] = k;
+		}
+		keys.swap(tmp);
+	}
+}
+
+// Moves the terms [begin, end) (which are sorted) to ret, cancelling them if
+// asked
+template <class Iterator, class Get>
+void emit_terms(Iterator begin, Iterator end, Get const& get, bool cancel, pa::ExprTerms& ret)
+{
+	if (!cancel) {
+		for (; begin != end; ++begin) {
+			ret.emplace_back(std::move(get(*begin)));
+		}
+		return;
+	}
+	while (begin != end) {
+		pa::Expr& cur = get(*begin);
+		Iterator it = begin;
+		size_t count = 0;
+		for (; it != end && get(*it) == cur; ++it) {
+			count++;
+		}
+		if ((count & 1) && !cur.is_zero()) {
+			ret.emplace_back(std::move(cur));
+		}
+		begin = it;
+	}
+}
+
+} // anonymous
+
+void pa::sort_terms(ExprTerms& terms, bool cancel)
+{
+	const size_t n = terms.size();
+	ExprTerms ret;
+	ret.reserve(n);
+	if (n < 64) {
+		std::sort(terms.begin(), terms.end());
+		emit_terms(terms.begin(), terms.end(), [](Expr& e) -> Expr& { return e; }, cancel, ret);
+		terms = std::move(ret);
+		return;
+	}
+
+	std::vector<SortKey> keys;
+	keys.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		keys.emplace_back(sort_key(terms[i], (uint32_t)i));
+	}
+	radix_sort(keys);
+
+	// Full comparisons between terms that have the same key
+	for (size_t i = 0; i < n; ) {
+		size_t j = i+1;
+		while (j < n && same_key(keys[j], keys[i])) {
+			j++;
+		}
+		if (j-i > 1) {
+			std::sort(keys.begin()+i, keys.begin()+j,
+				[&terms](SortKey const& a, SortKey const& b) { return terms[a.idx] < terms[b.idx]; });
+		}
+		i = j;
+	}
+
+	emit_terms(keys.begin(), keys.end(), [&terms](SortKey const& k) -> Expr& { return terms[k.idx]; }, cancel, ret);
+	terms = std::move(ret);
+}
+
+pa::ExprTerms pa::expand_products(ExprArgs const& a, ExprArgs const& b)
+{
+	const size_t na = a.size();
+	const size_t nb = b.size();
+	ExprTerms prods(na*nb);
+#ifdef PA_USE_TBB
+	if (na*nb >= simps::config().products_grain_size) {
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, na),
+			[&](tbb::blocked_range<size_t> const& r) {
+				for (size_t i = r.begin(); i != r.end(); ++i) {
+					for (size_t j = 0; j < nb; j++) {
+						prods[i*nb+j] = a[i]*b[j];
+					}
+				}
+			});
+	}
+	else
+#endif
+	{
+		for (size_t i = 0; i < na; i++) {
+			for (size_t j = 0; j < nb; j++) {
+				prods[i*nb+j] = a[i]*b[j];
+			}
+		}
+	}
+	sort_terms(prods, true);
+	return prods;
+}
@@ -0,0 +1,700 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/app.h>
+#include <pa/errors.h>
+#include <pa/matrix.h>
+#include <pa/serialize.h>
+#include <pa/symbols.h>
+#include <pa/vector.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+namespace {
+
+const char magic[4] = {'P', 'A', 'Q', 'S'};
+
+// Layout of the header
+enum: size_t {
+	off_magic = 0,
+	off_version = 4,
+	off_kind = 6,
+	off_nlines = 8,
+	off_ncols = 12,
+	off_nsyms = 16,
+	off_nnodes = 20,
+	off_nargs = 24,
+	off_nroots = 28,
+	off_syms = 32,
+	off_nodes = 40,
+	off_args = 48,
+	off_roots = 56,
+	off_names = 64,
+	off_names_size = 72,
+	header_size = 80
+};
+
+enum: size_t {
+	sym_entry_size = 12,
+	node_entry_size = 16
+};
+
+enum: uint32_t {
+	sym_flag_arg = 1
+};
+
+inline uint32_t get32(uint8_t const* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline uint64_t get64(uint8_t const* p)
+{
+	return (uint64_t)get32(p) | ((uint64_t)get32(p+4) << 32);
+}
+
+inline void put32(uint8_t* p, uint32_t v)
+{
+	for (unsigned i = 0; i < 4; i++) {
+		p[i] = (v >> (i*8)) & 0xFF;
+	}
+}
+
+inline void put64(uint8_t* p, uint64_t v)
+{
+	put32(p, (uint32_t)v);
+	put32(p+4, (uint32_t)(v >> 32));
+}
+
+inline void push32(std::vector<uint8_t>& buf, uint32_t v)
+{
+	const size_t off = buf.size();
+	buf.resize(off + 4);
+	put32(&buf[off], v);
+}
+
+struct NodeKeyHash
+{
+	size_t operator()(std::vector<uint32_t> const& k) const
+	{
+		uint64_t ret = k.size();
+		for (uint32_t v: k) {
+			ret = (ret ^ v)*0x100000001B3ULL;
+		}
+		return ret;
+	}
+};
+
+class Writer
+{
+public:
+	void add_root(pa::Expr const& e)
+	{
+		_roots.push_back(add(e));
+	}
+
+	template <class Container>
+	void add_roots(Container const& c)
+	{
+		for (pa::Expr const& e: c) {
+			add_root(e);
+		}
+	}
+
+	std::vector<uint8_t> finish(pa::serialize::Kind kind, uint32_t nlines, uint32_t ncols) const
+	{
+		const uint32_t nnodes = _nodes.size()/node_entry_size;
+		const uint32_t nargs = _args.size()/4;
+		const uint32_t nsyms = _syms.size()/sym_entry_size;
+
+		const size_t syms_off = header_size;
+		const size_t nodes_off = syms_off + _syms.size();
+		const size_t args_off = nodes_off + _nodes.size();
+		const size_t roots_off = args_off + _args.size();
+		const size_t names_off = roots_off + _roots.size()*4;
+
+		std::vector<uint8_t> ret(names_off + _names.size());
+		uint8_t* const p = &ret[0];
+		memcpy(p + off_magic, magic, sizeof(magic));
+		p[off_version] = pa::serialize::version & 0xFF;
+		p[off_version+1] = pa::serialize::version >> 8;
+		p[off_kind] = (uint8_t)kind;
+		put32(p + off_nlines, nlines);
+		put32(p + off_ncols, ncols);
+		put32(p + off_nsyms, nsyms);
+		put32(p + off_nnodes, nnodes);
+		put32(p + off_nargs, nargs);
+		put32(p + off_nroots, _roots.size());
+		put64(p + off_syms, syms_off);
+		put64(p + off_nodes, nodes_off);
+		put64(p + off_args, args_off);
+		put64(p + off_roots, roots_off);
+		put64(p + off_names, names_off);
+		put64(p + off_names_size, _names.size());
+
+		std::copy(_syms.begin(), _syms.end(), p + syms_off);
+		std::copy(_nodes.begin(), _nodes.end(), p + nodes_off);
+		std::copy(_args.begin(), _args.end(), p + args_off);
+		for (size_t i = 0; i < _roots.size(); i++) {
+			put32(p + roots_off + i*4, _roots[i]);
+		}
+		std::copy(_names.begin(), _names.end(), p + names_off);
+		return ret;
+	}
+
+private:
+	uint32_t add(pa::Expr const& e)
+	{
+		std::vector<uint32_t> key;
+		key.push_back((uint32_t)e.type());
+		switch (e.type()) {
+			case pa::expr_type_id::imm_type:
+				key.push_back(e.as<pa::ExprImm>().value());
+				break;
+			case pa::expr_type_id::symbol_type:
+				key.push_back(add_symbol(e.as<pa::ExprSym>()));
+				break;
+			case pa::expr_type_id::esf_type:
+				key.push_back(e.as<pa::ExprESF>().degree());
+				break;
+			default:
+				key.push_back(0);
+				break;
+		};
+		if (e.has_args()) {
+			key.reserve(e.nargs() + 2);
+			for (pa::Expr const& a: e.args()) {
+				key.push_back(add(a));
+			}
+		}
+
+		auto it = _cse.find(key);
+		if (it != _cse.end()) {
+			return it->second;
+		}
+
+		const uint32_t ret = _nodes.size()/node_entry_size;
+		const size_t off = _nodes.size();
+		_nodes.resize(off + node_entry_size, 0);
+		_nodes[off] = key[0];
+		put32(&_nodes[off+4], key[1]);
+		put32(&_nodes[off+8], _args.size()/4);
+		put32(&_nodes[off+12], key.size()-2);
+		for (size_t i = 2; i < key.size(); i++) {
+			push32(_args, key[i]);
+		}
+		_cse.insert(std::make_pair(std::move(key), ret));
+		return ret;
+	}
+
+	uint32_t add_symbol(pa::ExprSym const& s)
+	{
+		auto it = _sym_idxes.find(s.idx());
+		if (it != _sym_idxes.end()) {
+			return it->second;
+		}
+		const uint32_t ret = _syms.size()/sym_entry_size;
+		const pa::Symbols::idx_type arg_mask = pa::arg_symbol(0).idx();
+		if ((s.idx() & arg_mask) == arg_mask) {
+			push32(_syms, sym_flag_arg);
+			push32(_syms, s.idx() & ~arg_mask);
+			push32(_syms, 0);
+		}
+		else {
+			const char* name = pa::symbols()->name(s);
+			if (name == nullptr) {
+				throw pa::errors::InvalidFormat{};
+			}
+			const size_t len = strlen(name);
+			push32(_syms, 0);
+			push32(_syms, _names.size());
+			push32(_syms, len);
+			_names.insert(_names.end(), name, name + len);
+		}
+		_sym_idxes.insert(std::make_pair(s.idx(), ret));
+		return ret;
+	}
+
+private:
+	std::vector<uint8_t> _syms;
+	std::vector<uint8_t> _nodes;
+	std::vector<uint8_t> _args;
+	std::vector<uint8_t> _names;
+	std::vector<uint32_t> _roots;
+	std::unordered_map<pa::Symbols::idx_type, uint32_t> _sym_idxes;
+	std::unordered_map<std::vector<uint32_t>, uint32_t, NodeKeyHash> _cse;
+};
+
+// Returns true iif [off, off+count*entry_size) is within [0, size)
+bool in_bounds(uint64_t off, uint64_t count, uint64_t entry_size, uint64_t size)
+{
+	if (off > size) {
+		return false;
+	}
+	return count <= (size - off)/entry_size;
+}
+
+} // anonymous
+
+std::vector<uint8_t> pa::serialize::dump(pa::Expr const& e)
+{
+	Writer w;
+	w.add_root(e);
+	return w.finish(Kind::Expr, 1, 1);
+}
+
+std::vector<uint8_t> pa::serialize::dump(pa::Vector const& v)
+{
+	Writer w;
+	w.add_roots(v);
+	return w.finish(Kind::Vector, v.size(), 1);
+}
+
+std::vector<uint8_t> pa::serialize::dump(pa::Matrix const& m)
+{
+	Writer w;
+	w.add_roots(m);
+	return w.finish(Kind::Matrix, m.nlines(), m.ncols());
+}
+
+std::vector<uint8_t> pa::serialize::dump(pa::AffApp const& app)
+{
+	// Roots are M (line by line) and then V
+	Writer w;
+	w.add_roots(app.matrix());
+	w.add_roots(app.cst());
+	return w.finish(Kind::AffApp, app.matrix().nlines(), app.matrix().ncols());
+}
+
+std::vector<uint8_t> pa::serialize::dump(pa::App const& app)
+{
+	// Roots are M, V and then NL, whose expressions use argument symbols
+	Writer w;
+	w.add_roots(app.matrix());
+	w.add_roots(app.cst());
+	w.add_roots(app.nl().vector());
+	return w.finish(Kind::App, app.matrix().nlines(), app.matrix().ncols());
+}
+
+void pa::serialize::write_file(std::string const& path, std::vector<uint8_t> const& data)
+{
+	std::ofstream f(path, std::ios::binary | std::ios::trunc);
+	if (!f) {
+		throw errors::IOError{};
+	}
+	f.write((const char*)data.data(), data.size());
+	if (!f) {
+		throw errors::IOError{};
+	}
+}
+
+pa::serialize::Reader::Reader(std::string const& path):
+	_data(nullptr),
+	_size(0),
+	_map(nullptr)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw errors::IOError{};
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		throw errors::InvalidFormat{};
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr) {
+		throw errors::IOError{};
+	}
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		throw errors::IOError{};
+	}
+	_map = mapping;
+	_data = (uint8_t const*)data;
+	_size = size.QuadPart;
+#else
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw errors::IOError{};
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		throw errors::InvalidFormat{};
+	}
+	void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		throw errors::IOError{};
+	}
+	_map = data;
+	_data = (uint8_t const*)data;
+	_size = st.st_size;
+#endif
+	try {
+		init();
+	}
+	catch (...) {
+		unmap();
+		throw;
+	}
+}
+
+pa::serialize::Reader::Reader(void const* data, size_t size):
+	_data((uint8_t const*)data),
+	_size(size),
+	_map(nullptr)
+{
+	init();
+}
+
+pa::serialize::Reader::~Reader()
+{
+	unmap();
+}
+
+void pa::serialize::Reader::unmap()
+{
+	if (_map == nullptr) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(_data);
+	CloseHandle((HANDLE)_map);
+#else
+	munmap(_map, _size);
+#endif
+	_map = nullptr;
+}
+
+void pa::serialize::Reader::init()
+{
+	if (_size < header_size || memcmp(_data + off_magic, magic, sizeof(magic)) != 0) {
+		throw errors::InvalidFormat{};
+	}
+	const uint16_t v = (uint16_t)_data[off_version] | ((uint16_t)_data[off_version+1] << 8);
+	if (v != version || _data[off_kind] > (uint8_t)Kind::App) {
+		throw errors::InvalidFormat{};
+	}
+	_kind = (Kind)_data[off_kind];
+	_nlines = get32(_data + off_nlines);
+	_ncols = get32(_data + off_ncols);
+	_nsyms = get32(_data + off_nsyms);
+	_nnodes = get32(_data + off_nnodes);
+	_nargs = get32(_data + off_nargs);
+	_nroots = get32(_data + off_nroots);
+
+	const uint64_t syms_off = get64(_data + off_syms);
+	const uint64_t nodes_off = get64(_data + off_nodes);
+	const uint64_t args_off = get64(_data + off_args);
+	const uint64_t roots_off = get64(_data + off_roots);
+	const uint64_t names_off = get64(_data + off_names);
+	const uint64_t names_size = get64(_data + off_names_size);
+	if (!in_bounds(syms_off, _nsyms, sym_entry_size, _size) ||
+	    !in_bounds(nodes_off, _nnodes, node_entry_size, _size) ||
+	    !in_bounds(args_off, _nargs, 4, _size) ||
+	    !in_bounds(roots_off, _nroots, 4, _size) ||
+	    !in_bounds(names_off, names_size, 1, _size)) {
+		throw errors::InvalidFormat{};
+	}
+	_nodes = _data + nodes_off;
+	_args = _data + args_off;
+	_roots = _data + roots_off;
+
+	// Map the symbols to the ones of this process
+	const char* const names = (const char*)(_data + names_off);
+	_symbols.reserve(_nsyms);
+	for (uint32_t i = 0; i < _nsyms; i++) {
+		uint8_t const* const e = _data + syms_off + i*sym_entry_size;
+		const uint32_t flags = get32(e);
+		const uint32_t value = get32(e+4);
+		const uint32_t len = get32(e+8);
+		if (flags & sym_flag_arg) {
+			_symbols.push_back(pa::arg_symbol(value));
+		}
+		else {
+			if (!in_bounds(value, len, 1, names_size)) {
+				throw errors::InvalidFormat{};
+			}
+			_symbols.push_back(pa::symbol(std::string{names + value, len}.c_str()));
+		}
+	}
+}
+
+pa::serialize::Reader::Node pa::serialize::Reader::node(uint32_t idx) const
+{
+	if (idx >= _nnodes) {
+		throw errors::InvalidFormat{};
+	}
+	uint8_t const* const e = _nodes + (size_t)idx*node_entry_size;
+	Node ret;
+	if (e[0] > (uint8_t)expr_type_id::imm_type) {
+		throw errors::InvalidFormat{};
+	}
+	ret.type = (expr_type_id)e[0];
+	ret.value = get32(e+4);
+	ret.args_begin = get32(e+8);
+	ret.nargs = get32(e+12);
+	if (!in_bounds(ret.args_begin, ret.nargs, 1, _nargs)) {
+		throw errors::InvalidFormat{};
+	}
+	return ret;
+}
+
+uint32_t pa::serialize::Reader::arg(Node const& n, uint32_t i) const
+{
+	if (i >= n.nargs) {
+		throw errors::InvalidFormat{};
+	}
+	const uint32_t ret = get32(_args + ((size_t)n.args_begin + i)*4);
+	if (ret >= _nnodes) {
+		throw errors::InvalidFormat{};
+	}
+	return ret;
+}
+
+uint32_t pa::serialize::Reader::root(uint32_t i) const
+{
+	if (i >= _nroots) {
+		throw errors::InvalidFormat{};
+	}
+	return get32(_roots + (size_t)i*4);
+}
+
+pa::ExprSym const& pa::serialize::Reader::symbol(uint32_t idx) const
+{
+	if (idx >= _symbols.size()) {
+		throw errors::InvalidFormat{};
+	}
+	return _symbols[idx];
+}
+
+pa::Expr const& pa::serialize::Reader::materialize(std::vector<pa::Expr>& memo, std::vector<bool>& done, uint32_t idx) const
+{
+	if (done[idx]) {
+		return memo[idx];
+	}
+	Node const n = node(idx);
+	Expr e;
+	switch (n.type) {
+		case expr_type_id::imm_type:
+			e = ExprImm(n.value != 0);
+			break;
+		case expr_type_id::symbol_type:
+			e = symbol(n.value);
+			break;
+		default:
+		{
+			std::vector<Expr> args;
+			args.reserve(n.nargs);
+			for (uint32_t i = 0; i < n.nargs; i++) {
+				// Arguments are stored before the nodes using them, which also
+				// prevents cycles in corrupted files
+				const uint32_t a = arg(n, i);
+				if (a >= idx) {
+					throw errors::InvalidFormat{};
+				}
+				args.push_back(materialize(memo, done, a));
+			}
+			switch (n.type) {
+				case expr_type_id::add_type:
+					e = ExprAdd(args.begin(), args.end());
+					break;
+				case expr_type_id::mul_type:
+					e = ExprMul(args.begin(), args.end());
+					break;
+				case expr_type_id::or_type:
+					e = ExprOr(args.begin(), args.end());
+					break;
+				default:
+					// ESFs must have a degree in [1, nargs]
+					if (n.value == 0 || n.value > n.nargs || n.value > std::numeric_limits<ExprESF::degree_type>::max()) {
+						throw errors::InvalidFormat{};
+					}
+					e = ExprESF(n.value, args.begin(), args.end());
+					break;
+			};
+		}
+	};
+	memo[idx] = std::move(e);
+	done[idx] = true;
+	return memo[idx];
+}
+
+pa::Expr pa::serialize::Reader::expr(uint32_t node) const
+{
+	std::vector<Expr> memo(_nnodes);
+	std::vector<bool> done(_nnodes, false);
+	if (node >= _nnodes) {
+		throw errors::InvalidFormat{};
+	}
+	return materialize(memo, done, node);
+}
+
+pa::Vector pa::serialize::Reader::roots(uint32_t begin, uint32_t end) const
+{
+	std::vector<Expr> memo(_nnodes);
+	std::vector<bool> done(_nnodes, false);
+	Vector ret(end-begin);
+	for (uint32_t i = begin; i < end; i++) {
+		const uint32_t r = root(i);
+		if (r >= _nnodes) {
+			throw errors::InvalidFormat{};
+		}
+		ret[i-begin] = materialize(memo, done, r);
+	}
+	return ret;
+}
+
+void pa::serialize::Reader::check_kind(Kind k) const
+{
+	if (_kind != k) {
+		throw errors::InvalidFormat{};
+	}
+}
+
+pa::Expr pa::serialize::Reader::to_expr() const
+{
+	check_kind(Kind::Expr);
+	if (_nroots != 1) {
+		throw errors::InvalidFormat{};
+	}
+	return expr(root(0));
+}
+
+pa::Vector pa::serialize::Reader::to_vector() const
+{
+	check_kind(Kind::Vector);
+	if (_nroots != _nlines) {
+		throw errors::InvalidFormat{};
+	}
+	return roots(0, _nroots);
+}
+
+pa::Matrix pa::serialize::Reader::to_matrix() const
+{
+	check_kind(Kind::Matrix);
+	if ((uint64_t)_nlines*_ncols != _nroots) {
+		throw errors::InvalidFormat{};
+	}
+	Vector elts = roots(0, _nroots);
+	Matrix ret(_nlines, _ncols);
+	for (uint32_t i = 0; i < _nroots; i++) {
+		ret.elt_at(i) = std::move(elts[i]);
+	}
+	return ret;
+}
+
+pa::AffApp pa::serialize::Reader::to_affapp() const
+{
+	check_kind(Kind::AffApp);
+	const uint64_t nm = (uint64_t)_nlines*_ncols;
+	if (nm + _nlines != _nroots) {
+		throw errors::InvalidFormat{};
+	}
+	Vector elts = roots(0, _nroots);
+	Matrix M(_nlines, _ncols);
+	Vector V(_nlines);
+	for (uint32_t i = 0; i < nm; i++) {
+		M.elt_at(i) = std::move(elts[i]);
+	}
+	for (uint32_t i = 0; i < _nlines; i++) {
+		V[i] = std::move(elts[nm + i]);
+	}
+	return AffApp(std::move(M), std::move(V));
+}
+
+pa::App pa::serialize::Reader::to_app() const
+{
+	check_kind(Kind::App);
+	const uint64_t nm = (uint64_t)_nlines*_ncols;
+	if (nm + _nlines > _nroots) {
+		throw errors::InvalidFormat{};
+	}
+	Vector elts = roots(0, _nroots);
+	Matrix M(_nlines, _ncols);
+	Vector V(_nlines);
+	Vector NL(_nroots - nm - _nlines);
+	for (uint32_t i = 0; i < nm; i++) {
+		M.elt_at(i) = std::move(elts[i]);
+	}
+	for (uint32_t i = 0; i < _nlines; i++) {
+		V[i] = std::move(elts[nm + i]);
+	}
+	for (uint32_t i = 0; i < NL.size(); i++) {
+		NL[i] = std::move(elts[nm + _nlines + i]);
+	}
+
+	// NL already uses argument symbols, so substitute them with themselves
+	Vector args(_ncols);
+	for (uint32_t i = 0; i < _ncols; i++) {
+		args[i] = pa::arg_symbol(i);
+	}
+	return App(VectorApp(args, NL), std::move(M), std::move(V));
+}
+
+pa::Expr pa::serialize::load_expr(std::string const& path)
+{
+	return Reader(path).to_expr();
+}
+
+pa::Vector pa::serialize::load_vector(std::string const& path)
+{
+	return Reader(path).to_vector();
+}
+
+pa::Matrix pa::serialize::load_matrix(std::string const& path)
+{
+	return Reader(path).to_matrix();
+}
+
+pa::AffApp pa::serialize::load_affapp(std::string const& path)
+{
+	return Reader(path).to_affapp();
+}
+
+pa::App pa::serialize::load_app(std::string const& path)
+{
+	return Reader(path).to_app();
+}
@@ -24,22 +24,137 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <pa/algos.h>
+#include <pa/anf.h>
 #include <pa/bitfield.h>
+#include <pa/budget.h>
+#include <pa/cache.h>
 #include <pa/cast.h>
 #include <pa/compat.h>
+#include <pa/errors.h>
+#include <pa/esf.h>
 #include <pa/exprs.h>
 #include <pa/simps.h>
 #include <pa/vector.h>
 #include <pa/matrix.h>
 #include <pa/prettyprinter.h>
+#include <pa/products.h>
 #include <pa/config.h>
 
 #ifdef PA_USE_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 #include <tbb/parallel_sort.h>
+#include <tbb/task_arena.h>
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+pa::simps::Config& pa::simps::config()
+{
+	static Config config;
+	return config;
+}
+
+static bool simplify_rec(pa::Expr& e);
+
+// Resources accounting (see pa::BudgetScope)
+static inline void consume_nodes(uint64_t n)
+{
+	pa::Budget* const budget = pa::BudgetScope::current();
+	if (budget) {
+		budget->consume_nodes(n);
+	}
+}
+
+static inline void consume_monomials(uint64_t n)
+{
+	pa::Budget* const budget = pa::BudgetScope::current();
+	if (budget) {
+		budget->consume_monomials(n);
+	}
+}
+
+// Applies f to e. If the budget is exceeded, the arguments of the nodes that
+// have been partially processed are sorted back before rethrowing, so that e
+// is still a valid expression.
+template <class F>
+static void within_budget(pa::Expr& e, F const& f)
+{
+	try {
+		f(e);
+	}
+	catch (pa::errors::BudgetExceeded const&) {
+		pa::simps::sort(e);
+		throw;
+	}
+}
+
+// Wraps f so that it runs with the budget of the calling thread, whichever
+// TBB thread executes it
+template <class F>
+static auto with_budget(F const& f)
+{
+	pa::Budget* const budget = pa::BudgetScope::current();
+	return [budget, &f](auto&&... args) {
+		pa::BudgetScope scope(budget);
+		return f(std::forward<decltype(args)>(args)...);
+	};
+}
+
+// Runs f within a TBB arena limited to the configured number of threads
+template <class F>
+static void run_parallel(F const& f)
+{
+#ifdef PA_USE_TBB
+	const unsigned nthreads = pa::simps::config().nthreads;
+	if (nthreads > 0) {
+		tbb::task_arena arena(nthreads);
+		arena.execute(with_budget(f));
+		return;
+	}
+#endif
+	f();
+}
+
+// Applies f to every argument of e, in parallel if there is enough work.
+// Returns true iif one of the calls returned true.
+template <class F>
+static bool for_each_arg(pa::Expr& e, F const& f)
+{
+	pa::ExprArgs& args = e.args();
+#ifdef PA_USE_TBB
+	if (args.size() >= 2) {
+		size_t work = 0;
+		for (pa::Expr const& a: args) {
+			work += a.has_args() ? a.nargs() : 1;
+		}
+		if (work >= pa::simps::config().grain_size) {
+			auto const reduce = [&args, &f](tbb::blocked_range<size_t> const& r, bool changed) {
+				for (size_t i = r.begin(); i != r.end(); ++i) {
+					changed |= f(args[i]);
+				}
+				return changed;
+			};
+			return tbb::parallel_reduce(tbb::blocked_range<size_t>(0, args.size()), false,
+				with_budget(reduce),
+				[](bool a, bool b) { return a || b; });
+		}
+	}
+#endif
+	bool changed = false;
+	for (pa::Expr& a: args) {
+		changed |= f(a);
+	}
+	return changed;
+}
 
 static bool flatten_no_rec_once(pa::Expr& expr)
 {
@@ -165,6 +280,10 @@ static bool remove_dead_ops_once(pa::Expr& expr)
 	// Multiplication or OR implies only a unique operation
 	if (expr.is_mul() || expr.is_or()) {
 		ret = unique_args(expr, args);
+		if (!expr.has_args()) {
+			// args isn't valid anymore
+			return ret;
+		}
 		if (args.size() > 1) {
 			pa::Expr const& last_arg = args.back();
 			// 0 is useless for or, 1 is useless for mul
@@ -194,6 +313,9 @@ static bool remove_dead_ops_once(pa::Expr& expr)
 		ret = (it != args.end());
 		if (ret) {
 			resize_args(expr, args, it);
+			if (!expr.has_args()) {
+				return true;
+			}
 		}
 	}
 
@@ -241,51 +363,139 @@ bool pa::simps::flatten(Expr& e)
 
 bool pa::simps::constants_prop_sorted_no_rec(pa::Expr& expr)
 {
-	pa::expr_type_id const type = expr.type();
-	if (type != pa::expr_type_id::esf_type) {
+	if (!expr.is_esf()) {
 		return false;
 	}
 
-	pa::ExprArgs& args = expr.args();
-	for (auto it = args.rbegin(); it != args.rend(); ++it) {
-		pa::Expr& a = *it;
-		if (a.type() != pa::expr_type_id::imm_type) {
-			break;
-		}
+	// Immediates are sorted at the end of the arguments. Zeros can just be
+	// removed, and ones lower the degree (see esf_with_ones).
+	pa::ExprArgs const& args = static_cast<pa::Expr const&>(expr).args();
+	size_t nimms = 0;
+	size_t ones = 0;
+	for (auto it = args.rbegin(); it != args.rend() && it->is_imm(); ++it) {
+		nimms++;
+		ones += pa::expr_static_cast<pa::ExprImm const&>(*it).value();
+	}
+	if (nimms == 0) {
+		return false;
+	}
 
-		if (pa::expr_static_cast<pa::ExprImm&>(a).value() == false) {
-			auto rbegin_zero = it;
-			++it;
-			auto rend_zero = it;
-			for (; it != args.rend(); ++it) {
-				if ((it->type() != pa::expr_type_id::imm_type) ||
-				    (pa::expr_static_cast<pa::ExprImm&>(*it).value() != false)) {
-					rend_zero = it;
-					break;
-				}
+	// expr is only modified once the result is simplified, so that it is left
+	// untouched if the budget is exceeded
+	const size_t deg = pa::expr_static_cast<pa::ExprESF const&>(expr).degree();
+	const pa::ExprArgs vars(true, args.begin(), args.end()-nimms);
+	pa::Expr ret = pa::esf_with_ones(deg, vars, ones);
+	simplify_rec(ret);
+	expr = std::move(ret);
+	return true;
+}
+
+bool pa::simps::esf_products_no_rec(Expr& e)
+{
+	if (!e.is_mul()) {
+		return false;
+	}
+
+	// ESFs are sorted before the multiplications and the additions, which
+	// are the ESFs of degree 1 of their arguments
+	ExprArgs& args = e.args();
+	for (size_t i = 0; i < args.size() && args[i].type() <= expr_type_id::esf_type; i++) {
+		if (!args[i].is_esf()) {
+			continue;
+		}
+		ExprESF const& a = expr_static_cast<ExprESF const&>(args[i]);
+		for (size_t j = i+1; j < args.size(); j++) {
+			Expr const& b = args[j];
+			size_t deg;
+			if (b.is_esf()) {
+				deg = expr_static_cast<ExprESF const&>(b).degree();
 			}
-			const auto begin_zero = rend_zero.base();
-			const auto end_zero = rbegin_zero.base();
-			if ((begin_zero == args.begin()) &&
-				(end_zero == args.end())) {
-				expr.set<ExprImm>(false);
+			else
+			if (b.is_add()) {
+				deg = 1;
 			}
 			else {
-				args.erase(begin_zero, end_zero);
-				const size_t size = args.size();
-				const size_t deg = pa::expr_static_cast<pa::ExprESF const&>(expr).degree();
-				if (size == deg) {
-					expr.set_type(pa::expr_type_id::mul_type);
-				}
-				else
-				if (size < deg) {
-					expr.set<ExprImm>(false);
-				}
+				continue;
+			}
+			if ((std::min(a.degree()+deg, a.nargs()) > esf_max_degree) || !(b.args() == a.args())) {
+				continue;
+			}
+			Expr prod = esf_product(a.degree(), deg, a.args());
+			simplify_rec(prod);
+			args.erase(args.begin()+j);
+			args.erase(args.begin()+i);
+			if (args.size() == 0) {
+				e = std::move(prod);
+			}
+			else {
+				e = e * prod;
 			}
 			return true;
 		}
 	}
+	return false;
+}
+
+// Index of the only argument of big that isn't in small, or -1 if there
+// isn't exactly one
+static size_t extra_arg(pa::ExprArgs const& big, pa::ExprArgs const& small)
+{
+	if (big.size() != small.size()+1) {
+		return -1;
+	}
+	size_t ret = 0;
+	while (ret < small.size() && big[ret] == small[ret]) {
+		ret++;
+	}
+	for (size_t i = ret; i < small.size(); i++) {
+		if (!(big[i+1] == small[i])) {
+			return -1;
+		}
+	}
+	return ret;
+}
+
+bool pa::simps::esf_sums_no_rec(Expr& e)
+{
+	if (!e.is_add()) {
+		return false;
+	}
 
+	// e_k(X, y) + e_k(X) = y*e_{k-1}(X). ESFs are sorted by degree, so that
+	// ESFs of the same degree are contiguous.
+	ExprArgs& args = e.args();
+	for (size_t i = 0; i < args.size() && args[i].type() <= expr_type_id::esf_type; i++) {
+		if (!args[i].is_esf()) {
+			continue;
+		}
+		ExprESF const& a = expr_static_cast<ExprESF const&>(args[i]);
+		for (size_t j = i+1; j < args.size() && args[j].is_esf(); j++) {
+			ExprESF const& b = expr_static_cast<ExprESF const&>(args[j]);
+			if (b.degree() != a.degree()) {
+				break;
+			}
+			ExprESF const* big = &a;
+			ExprESF const* small = &b;
+			if (big->nargs() < small->nargs()) {
+				std::swap(big, small);
+			}
+			const size_t y = extra_arg(big->args(), small->args());
+			if (y == (size_t)-1) {
+				continue;
+			}
+			Expr term = big->args()[y] * esf(a.degree()-1, small->args());
+			simplify_rec(term);
+			args.erase(args.begin()+j);
+			args.erase(args.begin()+i);
+			if (args.size() == 0) {
+				e = std::move(term);
+			}
+			else {
+				e = e + term;
+			}
+			return true;
+		}
+	}
 	return false;
 }
 
@@ -325,20 +535,72 @@ bool pa::simps::constants_prop(Expr& e)
 
 static void expand_mul_add_add(pa::Expr& ea, pa::Expr& eb)
 {
-	pa::ExprArgs ret;
-	ret.reserve(ea.nargs() * eb.nargs());
-	for (pa::Expr& a: ea.args()) {
-		for (pa::Expr& b: eb.args()) {
-			pa::Expr ne = a*b;
-			if (!ne.is_zero()) {
-				auto it = ret.insert(std::move(ne));
-				if (!it.second) {
-					ret.erase(it.first);
-				}
-			}
+	ea.args() = pa::ExprArgs(true, pa::expand_products(ea.args(), eb.args()));
+}
+
+// Computes the product of args[start:] using the dense ANF representation, if
+// they are all in ANF and their support is small enough. The resulting
+// ExprAdd has its arguments sorted.
+static bool expand_mul_anf(pa::ExprArgs const& args, const size_t start, pa::Expr& ret)
+{
+	std::vector<pa::ANF::idx_type> syms;
+	for (size_t i = start; i < args.size(); i++) {
+		if (!pa::ANF::is_anf(args[i])) {
+			return false;
+		}
+		pa::ANF::support(args[i], syms);
+		if (syms.size() > pa::ANF::max_symbols) {
+			return false;
 		}
 	}
-	ea.args() = std::move(ret);
+
+	pa::ANF prod;
+	pa::ANF::from_expr(args[start], syms, prod);
+	for (size_t i = start+1; i < args.size(); i++) {
+		pa::ANF f;
+		pa::ANF::from_expr(args[i], syms, f);
+		prod *= f;
+	}
+	ret = prod.to_expr_add();
+	return true;
+}
+
+// Computes the product of args[start:] from its truth table, if they are all
+// in ANF and if their support is small enough for this to be faster than
+// computing the partial products. The resulting ExprAdd has its arguments
+// sorted.
+static bool expand_mul_truth_table(pa::ExprArgs const& args, const size_t start, pa::Expr& ret)
+{
+	const size_t max_syms = std::min(pa::simps::config().truth_table_max_symbols, pa::ANF::max_truth_table_symbols);
+	if (max_syms == 0) {
+		return false;
+	}
+	// Rough costs of both methods: one operation per word of the truth
+	// table and argument, against one per partial product.
+	size_t nprods = 1;
+	size_t nargs = 0;
+	std::vector<pa::ANF::idx_type> syms;
+	for (size_t i = start; i < args.size(); i++) {
+		pa::Expr const& a = args[i];
+		if (!pa::ANF::is_anf(a)) {
+			return false;
+		}
+		pa::ANF::support(a, syms);
+		if (syms.size() > max_syms) {
+			return false;
+		}
+		const size_t n = a.is_add() ? a.nargs() : 1;
+		nprods = (nprods > std::numeric_limits<size_t>::max()/n) ? std::numeric_limits<size_t>::max() : nprods*n;
+		nargs += n;
+	}
+	const size_t tt_words = syms.size() <= 6 ? 1 : size_t{1} << (syms.size()-6);
+	if (tt_words*(nargs + syms.size()) >= nprods) {
+		return false;
+	}
+
+	std::vector<pa::ANF::word_type> tt = pa::ANF::truth_table(&args[start], &args[0] + args.size(), syms);
+	ret = pa::ANF::from_truth_table(std::move(syms), std::move(tt)).to_expr_add();
+	return true;
 }
 
 bool pa::simps::expand_no_rec(Expr& e)
@@ -382,32 +644,53 @@ bool pa::simps::expand_no_rec(Expr& e)
 		return false;
 	}
 
-	// Let's compute the final ExprAdd!
-	Expr final_add = std::move(args[add_start]);
-	assert(final_add.type() == expr_type_id::add_type);
-	size_t i;
-	for (i = add_start+1; i < n; i++) {
-		Expr& a = args[i];
-		if (a.type() == expr_type_id::add_type) {
-			expand_mul_add_add(final_add, a);
+	if ((add_start > 0) && (add_start == n-1) && args[add_start-1].is_or_esf()) {
+		// Generalization of the ExprMul(ExprOr, ExprAdd) case above to
+		// several ORs/ESFs: the addition can't be expanded any further
+		return false;
+	}
+
+	// Let's compute the final ExprAdd! Monomials are accounted before e is
+	// modified, so that it is left untouched if the budget is exceeded.
+	Expr final_add;
+	if (expand_mul_truth_table(args, add_start, final_add) ||
+	    expand_mul_anf(args, add_start, final_add)) {
+		consume_monomials(final_add.nargs());
+	}
+	else {
+		uint64_t nprods = 1;
+		for (size_t i = add_start; i < n && args[i].is_add(); i++) {
+			const uint64_t na = args[i].nargs();
+			nprods = (nprods > std::numeric_limits<uint64_t>::max()/na) ? std::numeric_limits<uint64_t>::max() : nprods*na;
 		}
-		else {
-			// Break here as it meens that we only have left ExprAdd(...)*symbols
-			// Just need to propagate this into our expradd
-			break;
+		consume_monomials(nprods);
+
+		final_add = std::move(args[add_start]);
+		assert(final_add.type() == expr_type_id::add_type);
+		size_t i;
+		for (i = add_start+1; i < n; i++) {
+			Expr& a = args[i];
+			if (a.type() == expr_type_id::add_type) {
+				expand_mul_add_add(final_add, a);
+			}
+			else {
+				// Break here as it meens that we only have left ExprAdd(...)*symbols
+				// Just need to propagate this into our expradd
+				break;
+			}
 		}
-	}
 
-	if (i < n) {
-		pa::ExprMul mul_sym;
-		mul_sym.as<pa::ExprMul>().extend_args(args.begin()+i, args.end());
-		mul_sym.fix_unary();
-		for (Expr& a: final_add.args()) {
-			a *= mul_sym;
+		if (i < n) {
+			pa::ExprMul mul_sym;
+			mul_sym.as<pa::ExprMul>().extend_args(args.begin()+i, args.end());
+			mul_sym.fix_unary();
+			for (Expr& a: final_add.args()) {
+				a *= mul_sym;
+			}
 		}
-	}
 
-	std::sort(final_add.args().begin(), final_add.args().end());
+		std::sort(final_add.args().begin(), final_add.args().end());
+	}
 	if (add_start == 0) {
 		e.set<ExprAdd>();
 		e.args() = std::move(final_add.args());
@@ -424,35 +707,210 @@ bool pa::simps::expand_no_rec(Expr& e)
 	return true;
 }
 
-bool pa::simps::expand(Expr& e)
+static bool expand_rec(pa::Expr& e)
 {
 	if (!e.has_args()) {
 		return false;
 	}
 
-	bool changed = false;
-	for (Expr& a: e.args()) {
-		changed |= expand(a);
-	}
+	bool changed = for_each_arg(e, expand_rec);
+	changed |= pa::simps::expand_no_rec(e);
+	return changed;
+}
 
-	changed |= expand_no_rec(e);
+bool pa::simps::expand(Expr& e)
+{
+	bool changed;
+	run_parallel([&e, &changed]() {
+		within_budget(e, [&changed](Expr& e) { changed = expand_rec(e); });
+	});
 	return changed;
 }
 
+// Rewrite rules used to simplify a node whose arguments are already
+// simplified. They are tried in this order (which is the order in which the
+// passes were originally run).
+namespace {
+
+enum rule_id: unsigned {
+	rule_constants_prop,
+	rule_flatten,
+	rule_constants_prop_sorted,
+	rule_remove_dead_ops,
+	rule_esf_products,
+	rule_esf_sums,
+	rule_expand,
+	rules_count
+};
+
+constexpr unsigned rule_bit(rule_id r) { return 1U << r; }
+constexpr unsigned all_rules = (1U << rules_count) - 1;
+
+constexpr unsigned type_bit(pa::expr_type_id t) { return 1U << static_cast<unsigned>(t); }
+
+struct Rule
+{
+	const char* name;
+	bool (*apply)(pa::Expr&);
+	// Types of the nodes this rule can rewrite
+	unsigned types;
+	// Rules that might apply again once this one has rewritten a node
+	// without changing its type. All of them are retried if the type
+	// changed.
+	unsigned enables;
+};
+
+const Rule rules[rules_count] = {
+	{"constants_prop", pa::simps::constants_prop_no_rec,
+		type_bit(pa::expr_type_id::mul_type),
+		0},
+	// Merged arguments can contain constants, duplicates and additions to
+	// expand
+	{"flatten", pa::simps::flatten_no_rec,
+		type_bit(pa::expr_type_id::or_type) | type_bit(pa::expr_type_id::esf_type) |
+		type_bit(pa::expr_type_id::mul_type) | type_bit(pa::expr_type_id::add_type),
+		rule_bit(rule_constants_prop) | rule_bit(rule_remove_dead_ops) | rule_bit(rule_esf_products) |
+		rule_bit(rule_esf_sums) | rule_bit(rule_expand)},
+	{"constants_prop_sorted", pa::simps::constants_prop_sorted_no_rec,
+		type_bit(pa::expr_type_id::esf_type),
+		0},
+	{"remove_dead_ops", pa::simps::remove_dead_ops_no_rec,
+		type_bit(pa::expr_type_id::or_type) | type_bit(pa::expr_type_id::mul_type) |
+		type_bit(pa::expr_type_id::add_type),
+		0},
+	// Closed forms of products and sums of ESFs, so that they don't need to
+	// be expanded
+	{"esf_products", pa::simps::esf_products_no_rec,
+		type_bit(pa::expr_type_id::mul_type),
+		all_rules},
+	{"esf_sums", pa::simps::esf_sums_no_rec,
+		type_bit(pa::expr_type_id::add_type),
+		all_rules},
+	// Products are computed with the operators, which don't flatten nor
+	// cancel everything
+	{"expand", pa::simps::expand_no_rec,
+		type_bit(pa::expr_type_id::mul_type),
+		all_rules},
+};
+
+// Passes run outside of simplify, whose statistics are recorded along with
+// the ones of the rules
+enum pass_id: unsigned {
+	pass_or_to_esf = rules_count,
+	pass_identify_ors,
+	pass_expand_esf,
+	passes_count
+};
+
+const char* const passes_names[passes_count-rules_count] = {
+	"or_to_esf",
+	"identify_ors",
+	"expand_esf"
+};
+
+#ifdef PA_SIMPS_STATS
+struct PassCounters
+{
+	std::atomic<uint64_t> attempts;
+	std::atomic<uint64_t> rewrites;
+	std::atomic<uint64_t> time_ns;
+	std::atomic<uint64_t> args_before;
+	std::atomic<uint64_t> args_after;
+	std::atomic<uint64_t> max_args;
+};
+
+PassCounters passes_counters[passes_count];
+
+inline uint64_t nargs_of(pa::Expr const& e)
+{
+	return e.has_args() ? e.nargs() : 0;
+}
+
+// Applies the pass p to e, and records its statistics if asked
+template <class F>
+bool run_pass(unsigned p, pa::Expr& e, F const& f)
+{
+	if (!pa::simps::config().rules_stats) {
+		return f(e);
+	}
+	typedef std::chrono::steady_clock clock_type;
+	PassCounters& c = passes_counters[p];
+	const uint64_t before = nargs_of(e);
+	const clock_type::time_point start = clock_type::now();
+	const bool changed = f(e);
+	const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now()-start).count();
+	c.attempts.fetch_add(1, std::memory_order_relaxed);
+	c.time_ns.fetch_add(ns, std::memory_order_relaxed);
+	if (changed) {
+		const uint64_t after = nargs_of(e);
+		c.rewrites.fetch_add(1, std::memory_order_relaxed);
+		c.args_before.fetch_add(before, std::memory_order_relaxed);
+		c.args_after.fetch_add(after, std::memory_order_relaxed);
+		uint64_t max = c.max_args.load(std::memory_order_relaxed);
+		const uint64_t size = std::max(before, after);
+		while (size > max && !c.max_args.compare_exchange_weak(max, size, std::memory_order_relaxed)) { }
+	}
+	return changed;
+}
+#else
+template <class F>
+inline bool run_pass(unsigned, pa::Expr& e, F const& f)
+{
+	return f(e);
+}
+#endif
+
+} // anonymous
+
+std::vector<pa::simps::RuleStats> pa::simps::rules_stats()
+{
+	std::vector<RuleStats> ret;
+#ifdef PA_SIMPS_STATS
+	ret.reserve(passes_count);
+	for (unsigned p = 0; p < passes_count; p++) {
+		PassCounters const& c = passes_counters[p];
+		const char* name = (p < rules_count) ? rules[p].name : passes_names[p-rules_count];
+		ret.push_back(RuleStats{name, c.attempts.load(), c.rewrites.load(), c.time_ns.load(),
+			c.args_before.load(), c.args_after.load(), c.max_args.load()});
+	}
+#endif
+	return ret;
+}
+
+void pa::simps::reset_rules_stats()
+{
+#ifdef PA_SIMPS_STATS
+	for (PassCounters& c: passes_counters) {
+		c.attempts.store(0);
+		c.rewrites.store(0);
+		c.time_ns.store(0);
+		c.args_before.store(0);
+		c.args_after.store(0);
+		c.max_args.store(0);
+	}
+#endif
+}
+
+// Applies the rewrite rules to e until none of them applies. A rule is only
+// retried if a rewrite might have made it applicable again.
 static bool simplify_no_rec(pa::Expr& e)
 {
 	bool changed = false;
-	bool exp_changed;
-	do {
-		changed |= pa::simps::constants_prop_no_rec(e);
-		changed |= pa::simps::flatten_no_rec(e);
-		changed |= pa::simps::constants_prop_sorted_no_rec(e);
-		changed |= pa::simps::remove_dead_ops_no_rec(e);
-		changed |= pa::simps::flatten_no_rec(e);
-		exp_changed = pa::simps::expand_no_rec(e);
-		changed |= exp_changed;
-	}
-	while (exp_changed);
+	unsigned pending = all_rules;
+	while (pending != 0 && e.has_args()) {
+		const rule_id r = static_cast<rule_id>(pa::ctz64(pending));
+		pending &= ~rule_bit(r);
+		Rule const& rule = rules[r];
+		const pa::expr_type_id type = e.type();
+		if (!(rule.types & type_bit(type))) {
+			continue;
+		}
+		if (!run_pass(r, e, rule.apply)) {
+			continue;
+		}
+		changed = true;
+		pending |= (e.type() == type) ? rule.enables : all_rules;
+	}
 	return changed;
 }
 
@@ -471,11 +929,12 @@ static bool expand_esf_rec(pa::Expr& e)
 		return ret;
 	}
 
-	pa::ExprESF& esf = pa::expr_static_cast<pa::ExprESF&>(e);
-	esf.expand();
-	simplify_no_rec(esf);
-
-	return true;
+	return run_pass(pass_expand_esf, e, [](pa::Expr& e) {
+		pa::ExprESF& esf = pa::expr_static_cast<pa::ExprESF&>(e);
+		esf.expand();
+		simplify_no_rec(esf);
+		return true;
+	});
 }
 
 static bool or_to_esf_no_rec(pa::Expr& e)
@@ -506,27 +965,28 @@ bool pa::simps::or_to_esf(pa::Expr& e)
 		}
 	}
 
-	return or_to_esf_no_rec(e);
+	return run_pass(pass_or_to_esf, e, or_to_esf_no_rec);
 }
 
 static bool simplify_rec(pa::Expr& e)
 {
-	if (!e.has_args()) {
+	// Normalized expressions are left untouched by a simplification, so that
+	// only the sub-expressions modified since the last one are processed.
+	if (!e.has_args() || e.is_normalized()) {
 		return false;
 	}
 
 	assert(std::is_sorted(e.args().cbegin(), e.args().cend()));
 
-	bool changed = false;
-	for (pa::Expr& a: e.args()) {
-		changed |= simplify_rec(a);
-	}
+	consume_nodes(1);
+	bool changed = for_each_arg(e, simplify_rec);
 
 	assert(changed || (!changed && std::is_sorted(e.args().cbegin(), e.args().cend())));
 	if (changed) {
 		sort_args(e.args());
 	}
 	changed |= simplify_no_rec(e);
+	e.set_normalized();
 	return changed;
 }
 
@@ -549,9 +1009,84 @@ static void simplify_rec_no_expand(pa::Expr& e, int tab)
 }
 #endif
 
+namespace {
+
+pa::ExprCache simplify_cache;
+pa::ExprCache expand_esf_cache;
+
+// Settings of the configuration the cached results depend on, as they were
+// when the caches have been filled
+struct CachedSettings
+{
+	size_t truth_table_max_symbols;
+	size_t identify_ors_max_candidates;
+};
+
+std::mutex cached_settings_mutex;
+CachedSettings cached_settings = {
+	pa::simps::Config{}.truth_table_max_symbols,
+	pa::simps::Config{}.identify_ors_max_candidates
+};
+
+// Clears the caches if these settings have changed since they have been
+// filled. Results interrupted by a budget are never inserted, so the
+// budget does not need to be part of them.
+void check_cached_settings(pa::simps::Config const& config)
+{
+	std::lock_guard<std::mutex> lock(cached_settings_mutex);
+	if (cached_settings.truth_table_max_symbols == config.truth_table_max_symbols &&
+	    cached_settings.identify_ors_max_candidates == config.identify_ors_max_candidates) {
+		return;
+	}
+	simplify_cache.clear();
+	expand_esf_cache.clear();
+	cached_settings.truth_table_max_symbols = config.truth_table_max_symbols;
+	cached_settings.identify_ors_max_candidates = config.identify_ors_max_candidates;
+}
+
+// Applies f to e, or gets its result from cache if it is enabled
+template <class F>
+void cached(pa::ExprCache& cache, pa::Expr& e, F const& f)
+{
+	pa::simps::Config const& config = pa::simps::config();
+	const size_t size = config.cache_size;
+	if (size == 0 || !e.has_args()) {
+		f(e);
+		return;
+	}
+	check_cached_settings(config);
+	if (cache.lookup(e, e)) {
+		return;
+	}
+	const pa::Expr in = e;
+	f(e);
+	cache.set_capacity(size);
+	cache.insert(in, e);
+}
+
+} // anonymous
+
+std::vector<pa::simps::CacheStats> pa::simps::caches_stats()
+{
+	const ExprCache::Stats simplify = simplify_cache.stats();
+	const ExprCache::Stats expand_esf = expand_esf_cache.stats();
+	return {
+		CacheStats{"simplify", simplify.hits, simplify.misses, simplify.evictions, simplify.size},
+		CacheStats{"expand_esf", expand_esf.hits, expand_esf.misses, expand_esf.evictions, expand_esf.size}
+	};
+}
+
+void pa::simps::clear_caches()
+{
+	simplify_cache.clear();
+	expand_esf_cache.clear();
+}
+
 pa::Expr& pa::simps::expand_esf(Expr& e)
 {
-	expand_esf_rec(e);
+	within_budget(e, [](Expr& e) {
+		cached(expand_esf_cache, e, expand_esf_rec);
+	});
 	return e;
 }
 
@@ -563,12 +1098,23 @@ pa::Vector& pa::simps::expand_esf(Vector& v)
 	return v;
 }
 
+static void simplify_expr(pa::Expr& e)
+{
+	// Normalized expressions are already simplified
+	if (e.is_normalized()) {
+		return;
+	}
+	within_budget(e, [](pa::Expr& e) {
+		cached(simplify_cache, e, [](pa::Expr& e) {
+			pa::simps::sort(e);
+			simplify_rec(e);
+		});
+	});
+}
+
 pa::Expr& pa::simps::simplify(Expr& e)
 {
-	sort(e);
-	simplify_rec(e);
-	//expand_esf_rec(e);
-	//simplify_rec(e);
+	run_parallel([&e]() { simplify_expr(e); });
 	return e;
 }
 
@@ -582,25 +1128,35 @@ pa::Expr& pa::simps::simplify(Expr& e)
 
 pa::Vector& pa::simps::simplify(Vector& v)
 {
+	run_parallel([&v]() {
 #ifdef PA_USE_TBB
-  tbb::parallel_for(size_t{0}, v.size(), [&v](size_t i) {
-		simplify(v[i]);
-	});
+		auto const simplify_elt = [&v](size_t i) {
+			simplify_expr(v[i]);
+		};
+		tbb::parallel_for(size_t{0}, v.size(), with_budget(simplify_elt));
 #else
-  for (Expr& e: v) {
-    simplify(e);
-  }
+		for (Expr& e: v) {
+			simplify_expr(e);
+		}
 #endif
+	});
 	return v;
 }
 
 pa::Matrix& pa::simps::simplify(Matrix& m)
 {
-//#pragma omp parallel for
-	//for (Expr& e: v) {
-	for (size_t i = 0; i < m.nelts(); i++) {
-		simplify(m.elt_at(i));
-	}
+	run_parallel([&m]() {
+#ifdef PA_USE_TBB
+		auto const simplify_elt = [&m](size_t i) {
+			simplify_expr(m.elt_at(i));
+		};
+		tbb::parallel_for(size_t{0}, m.nelts(), with_budget(simplify_elt));
+#else
+		for (size_t i = 0; i < m.nelts(); i++) {
+			simplify_expr(m.elt_at(i));
+		}
+#endif
+	});
 	return m;
 }
 
@@ -613,7 +1169,8 @@ void pa::simps::sort_no_rec(Expr& e)
 
 void pa::simps::sort(Expr& e)
 {
-	if (!e.has_args()) {
+	// Normalized expressions are already sorted
+	if (!e.has_args() || e.is_normalized()) {
 		return;
 	}
 
@@ -635,153 +1192,140 @@ bool pa::simps::identify_ors_no_rec(Expr& e)
 
 	assert(std::is_sorted(e.args().begin(), e.args().end()));
 
-	size_t sym_start = -1;
-	size_t mul_start = -1;
-	size_t esf_start = -1;
-
-	size_t n = e.nargs();
+	// (s_0|...|s_k) = s_0 + ... + s_k + ESF(2, s_0, ..., s_k) + ... +
+	// ESF(k, s_0, ..., s_k) + s_0*...*s_k. Every OR is thus identified by a
+	// product of symbols of the addition, and the ESFs over the same symbols
+	// are looked up in an index.
 	ExprArgs& eargs = e.args();
-	size_t i;
-	for (i = 0; i < n; i++) {
-		if (eargs[i].is_esf()) {
-			esf_start = i++;
-			break;
-		}
+	const size_t n = eargs.size();
+	size_t mul_start = 0;
+	while (mul_start < n && eargs[mul_start].type() < expr_type_id::mul_type) {
+		mul_start++;
 	}
-	if (esf_start == (size_t)-1) {
-		i = 0;
+	size_t sym_start = mul_start;
+	while (sym_start < n && !eargs[sym_start].is_sym()) {
+		sym_start++;
 	}
-	for (; i < n; i++) {
-		if (eargs[i].is_mul()) {
-			mul_start = i++;
-			break;
-		}
+	size_t sym_end = sym_start;
+	while (sym_end < n && eargs[sym_end].is_sym()) {
+		sym_end++;
 	}
-	if (mul_start == (size_t)-1) {
+	if (sym_end - sym_start <= 1) {
 		return false;
 	}
-	for (; i < n; i++) {
-		if (eargs[i].is_sym()) {
-			sym_start = i++;
-			break;
+
+	auto find_sym = [&](Expr const& s) -> size_t {
+		auto it = std::lower_bound(eargs.begin()+sym_start, eargs.begin()+sym_end, s);
+		if (it == eargs.begin()+sym_end || !(*it == s)) {
+			return -1;
+		}
+		return std::distance(eargs.begin(), it);
+	};
+
+	// Products of symbols of the addition are candidate ORs. Bigger ones
+	// are tried first.
+	std::vector<size_t> candidates;
+	for (size_t mul = mul_start; mul < n && eargs[mul].is_mul(); mul++) {
+		ExprArgs const& margs = eargs[mul].args();
+		if (margs.size() < 2) {
+			continue;
+		}
+		bool valid = true;
+		for (Expr const& a: margs) {
+			if (!a.is_sym() || find_sym(a) == (size_t)-1) {
+				valid = false;
+				break;
+			}
+		}
+		if (valid) {
+			candidates.push_back(mul);
 		}
 	}
-	if (sym_start == (size_t)-1) {
+	if (candidates.empty()) {
 		return false;
 	}
-	size_t nsym = 1;
-	for (; i < n; i++) {
-		if (!eargs[i].is_sym()) {
-			break;
-		}
-		++nsym;
+	std::stable_sort(candidates.begin(), candidates.end(),
+		[&eargs](size_t a, size_t b) { return eargs[a].nargs() > eargs[b].nargs(); });
+	const size_t max_candidates = config().identify_ors_max_candidates;
+	if ((max_candidates > 0) && (candidates.size() > max_candidates)) {
+		candidates.resize(max_candidates);
 	}
 
-	if (nsym <= 1) {
-		return false;
+	// ESFs, indexed by the hash of their arguments (which is the same as the
+	// one of a product of the same arguments)
+	std::unordered_multimap<uint64_t, size_t> esfs;
+	for (size_t esf = 0; esf < mul_start; esf++) {
+		if (eargs[esf].is_esf()) {
+			esfs.emplace(eargs[esf].hash(), esf);
+		}
 	}
 
+	std::vector<bool> removed(n, false);
+	std::vector<size_t> or_idxes;
 	ExprArgs new_ors;
-
-	// Select i symbols among new_ors, for i from 2 to nsym. This gives the arguments to check for the existance of an OR operation!
-search_begin:
-	for (size_t k = nsym; k >= 2; k--) {
-		bool go_again = false;
-		draw_without_replacement<size_t>(k, nsym,
-			[&](size_t const* idxes, size_t const n)
-			{
-				ExprArgs or_args;
-				or_args.resize(n);
-				for (size_t i = 0; i < n; i++) {
-					or_args[i] = eargs[sym_start+idxes[i]];
-				}
-
-				const size_t or_degree = n;
-				if (or_degree == 2) {
-					for (size_t mul = mul_start; mul < sym_start; mul++) {
-						if (eargs[mul].args() == or_args) {
-							new_ors.insert_dup(ExprOr(std::move(or_args)));
-							// This is an (a|b) operation
-							eargs.erase(std::begin(eargs)+sym_start+idxes[1]);
-							eargs.erase(std::begin(eargs)+sym_start+idxes[0]);
-							eargs.erase(std::begin(eargs)+mul);
-							--sym_start;
-							nsym -= 2;
-							go_again = true;
-							return false;
-						}
+	for (size_t mul: candidates) {
+		ExprArgs const& or_args = eargs[mul].args();
+		const size_t or_degree = or_args.size();
+		or_idxes.clear();
+		or_idxes.push_back(mul);
+		for (Expr const& a: or_args) {
+			const size_t sym = find_sym(a);
+			if (removed[sym]) {
+				break;
+			}
+			or_idxes.push_back(sym);
+		}
+		if (or_idxes.size() != or_degree+1) {
+			continue;
+		}
+		if (or_degree > 2) {
+			const auto range = esfs.equal_range(eargs[mul].hash());
+			for (size_t deg = 2; deg < or_degree; deg++) {
+				for (auto it = range.first; it != range.second; ++it) {
+					const size_t esf = it->second;
+					if (!removed[esf] &&
+					    (expr_static_cast<ExprESF const&>(eargs[esf]).degree() == deg) &&
+					    (eargs[esf].args() == or_args)) {
+						or_idxes.push_back(esf);
+						break;
 					}
-					// Nothing here, go to the next one.
-					return true;
 				}
-
-				if (esf_start == (size_t)-1) {
-					// No ESF, go to the next possibility.
-					return true;
+				if (or_idxes.size() != or_degree+deg) {
+					break;
 				}
+			}
+			if (or_idxes.size() != 2*or_degree-1) {
+				continue;
+			}
+		}
+		for (size_t idx: or_idxes) {
+			removed[idx] = true;
+		}
+		new_ors.insert_dup(ExprOr(or_args.begin(), or_args.end()));
+	}
 
-				assert(or_degree >= 2);
+	if (new_ors.size() == 0) {
+		return false;
+	}
 
-				// For size arguments bigger than 2, check ESFs 
-				size_t cur_degree = 2;
-				std::vector<size_t> idx_to_remove;
-				idx_to_remove.reserve(or_degree-1);
-				for (size_t esf = esf_start; esf < mul_start; esf++) {
-					ExprESF const& eesf = expr_assert_cast<ExprESF const&>(eargs[esf]);
-					if (eesf.degree() > cur_degree) {
-						break;
-					}
-					if ((eesf.degree() == cur_degree) && (eesf.args() == or_args)) {
-						idx_to_remove.push_back(esf);
-						cur_degree++;
-						if (cur_degree == or_degree) {
-							break;
-						}
-					}
-				}
-				if (cur_degree != or_degree) {
-					return true;
-				}
-				for (size_t mul = mul_start; mul < sym_start; mul++) {
-					ExprMul const& emul = expr_assert_cast<ExprMul const&>(eargs[mul]);
-					if (emul.args() == or_args) {
-						idx_to_remove.push_back(mul);
-						// Got an OR here
-						// Remove every invloved expressions
-						new_ors.insert_dup(ExprOr(std::move(or_args)));
-						for (ssize_t i = n-1; i >= 0; i--) {
-							eargs.erase(std::begin(eargs)+sym_start+idxes[i]);
-						}
-						for (auto it = idx_to_remove.rbegin(); it != idx_to_remove.rend(); it++) {
-							eargs.erase(std::begin(eargs)+*it);
-						}
-						nsym -= n;
-						mul_start -= idx_to_remove.size()-1;
-						sym_start -= idx_to_remove.size();
-						go_again = true;
-						return false;
-					}
-				}
-				return true;
-			});
-		if (go_again) {
-			goto search_begin;
+	ExprArgs new_args;
+	new_args.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		if (!removed[i]) {
+			new_args.insert_dup(std::move(eargs[i]));
 		}
 	}
 
 	// Preprend the new ORs at the beggining
-	if (new_ors.size() > 0) {
-		if (eargs.size() == 0 && new_ors.size() == 1) {
-			e = std::move(new_ors[0]);
-			return true;
-		}
-		for (size_t i = 0; i < new_ors.size(); i++) {
-			eargs.insert_dup(std::move(new_ors[i]));
-		}
+	if (new_args.size() == 0 && new_ors.size() == 1) {
+		e = std::move(new_ors[0]);
 		return true;
 	}
-	
-	return false;
+	for (size_t i = 0; i < new_ors.size(); i++) {
+		new_args.insert_dup(std::move(new_ors[i]));
+	}
+	eargs = std::move(new_args);
+	return true;
 }
 
 bool pa::simps::identify_ors(Expr& e)
@@ -790,7 +1334,7 @@ bool pa::simps::identify_ors(Expr& e)
 		return false;
 	}
 
-	bool ret = identify_ors_no_rec(e);
+	bool ret = run_pass(pass_identify_ors, e, identify_ors_no_rec);
 
 	for (Expr& a: e.args()) {
 		ret |= identify_ors(a);
@@ -0,0 +1,184 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/errors.h>
+#include <pa/matrix.h>
+#include <pa/products.h>
+#include <pa/sparse_matrix.h>
+#include <pa/vector.h>
+
+#include <algorithm>
+
+namespace {
+
+inline bool is_zero(pa::Expr const& e)
+{
+	return e.is_imm() && !e.as<pa::ExprImm>().value();
+}
+
+} // anonymous
+
+pa::SparseMatrix::SparseMatrix(Matrix const& m):
+	SparseMatrix(0, m.ncols())
+{
+	for (size_t i = 0; i < m.nlines(); i++) {
+		for (size_t j = 0; j < m.ncols(); j++) {
+			push(j, Expr{m.at(i, j)});
+		}
+		end_line();
+	}
+}
+
+pa::SparseMatrix pa::SparseMatrix::identity(const size_t n)
+{
+	return construct(n, n, [](size_t i, size_t j) { return ExprImm(i == j); });
+}
+
+pa::Matrix pa::SparseMatrix::to_matrix() const
+{
+	Matrix ret(nlines(), ncols(), ExprImm(0));
+	for (size_t i = 0; i < nlines(); i++) {
+		for (size_t k = line_begin(i); k < line_end(i); k++) {
+			ret.at(i, _cols[k]) = _values[k];
+		}
+	}
+	return ret;
+}
+
+void pa::SparseMatrix::push(const size_t col, Expr&& e)
+{
+	if (is_zero(e)) {
+		return;
+	}
+	_cols.push_back(static_cast<col_type>(col));
+	_values.emplace_back(std::move(e));
+}
+
+pa::Expr pa::SparseMatrix::at(const size_t line, const size_t col) const
+{
+	auto const begin = _cols.begin()+line_begin(line);
+	auto const end = _cols.begin()+line_end(line);
+	auto const it = std::lower_bound(begin, end, col);
+	if (it == end || *it != col) {
+		return ExprImm(0);
+	}
+	return _values[it-_cols.begin()];
+}
+
+pa::SparseMatrix pa::SparseMatrix::operator+(SparseMatrix const& o) const
+{
+	if (nlines() != o.nlines() || ncols() != o.ncols()) {
+		throw errors::SizeMismatch();
+	}
+	SparseMatrix ret(0, ncols());
+	for (size_t i = 0; i < nlines(); i++) {
+		size_t a = line_begin(i);
+		size_t b = o.line_begin(i);
+		const size_t a_end = line_end(i);
+		const size_t b_end = o.line_end(i);
+		while (a < a_end || b < b_end) {
+			if (b == b_end || (a < a_end && _cols[a] < o._cols[b])) {
+				ret.push(_cols[a], Expr{_values[a]});
+				a++;
+			}
+			else
+			if (a == a_end || o._cols[b] < _cols[a]) {
+				ret.push(o._cols[b], Expr{o._values[b]});
+				b++;
+			}
+			else {
+				ret.push(_cols[a], _values[a] + o._values[b]);
+				a++;
+				b++;
+			}
+		}
+		ret.end_line();
+	}
+	return ret;
+}
+
+pa::SparseMatrix pa::SparseMatrix::operator*(SparseMatrix const& o) const
+{
+	if (ncols() != o.nlines()) {
+		throw errors::SizeMismatch();
+	}
+	// Products of each line are accumulated by column of the result
+	SparseMatrix ret(0, o.ncols());
+	std::vector<ExprTerms> acc(o.ncols());
+	std::vector<size_t> used;
+	for (size_t i = 0; i < nlines(); i++) {
+		for (size_t k = line_begin(i); k < line_end(i); k++) {
+			const size_t l = _cols[k];
+			for (size_t m = o.line_begin(l); m < o.line_end(l); m++) {
+				ExprTerms& terms = acc[o._cols[m]];
+				if (terms.empty()) {
+					used.push_back(o._cols[m]);
+				}
+				terms.emplace_back(_values[k] * o._values[m]);
+			}
+		}
+		std::sort(used.begin(), used.end());
+		for (size_t j: used) {
+			ExprTerms& terms = acc[j];
+			sort_terms(terms, true);
+			if (terms.size() == 1) {
+				ret.push(j, std::move(terms[0]));
+			}
+			else
+			if (terms.size() > 1) {
+				ret.push(j, ExprAdd(ExprArgs(true, std::move(terms))));
+			}
+			terms.clear();
+		}
+		used.clear();
+		ret.end_line();
+	}
+	return ret;
+}
+
+pa::Vector pa::SparseMatrix::operator*(Vector const& o) const
+{
+	if (o.size() != ncols()) {
+		throw errors::SizeMismatch();
+	}
+	Vector ret(nlines());
+	for (size_t i = 0; i < nlines(); i++) {
+		ExprTerms terms;
+		terms.reserve(line_end(i)-line_begin(i));
+		for (size_t k = line_begin(i); k < line_end(i); k++) {
+			terms.emplace_back(_values[k] * o.at(_cols[k]));
+		}
+		if (!terms.empty()) {
+			sort_terms(terms, false);
+			ret[i] = ExprAdd(ExprArgs(true, std::move(terms)));
+		}
+	}
+	return ret;
+}
+
+bool pa::SparseMatrix::operator==(SparseMatrix const& o) const
+{
+	return _ncols == o._ncols && _lines == o._lines && _cols == o._cols && _values == o._values;
+}
@@ -25,6 +25,7 @@
 
 #include <pa/errors.h>
 #include <pa/vector.h>
+#include <pa/vector_view.h>
 #include <pa/simps.h>
 
 void pa::Vector::set_null()
@@ -195,13 +196,7 @@ pa::Vector& pa::Vector::operator>>=(const size_t n)
 
 pa::Vector pa::Vector::operator>>(const size_t n) const
 {
-	pa::Vector ret;
-	storage_type& new_args = ret.args();
-	new_args.resize(size(), pa::ExprImm(0));
-	if (n < size()) {
-		std::copy(_args.begin(), _args.end()-n, new_args.begin()+n);
-	}
-	return ret;
+	return VectorView::shift_right(*this, n).to_vector();
 }
 
 pa::Vector& pa::Vector::operator<<=(const size_t n)
@@ -221,9 +216,7 @@ pa::Vector& pa::Vector::operator<<=(const size_t n)
 
 pa::Vector pa::Vector::operator<<(const size_t n) const
 {
-	pa::Vector ret = *this;
-	ret <<= n;
-	return ret;
+	return VectorView::shift_left(*this, n).to_vector();
 }
 
 size_t pa::Vector::get_int_be(bool* res) const
@@ -0,0 +1,173 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <pa/errors.h>
+#include <pa/vector_view.h>
+
+#include <algorithm>
+
+pa::VectorView::VectorView(Vector const& v):
+	VectorView(v, v.size(), 0, 1, false, ExprImm(0))
+{ }
+
+pa::VectorView::VectorView(Vector const& v, const size_t size, const ptrdiff_t start, const ptrdiff_t step, const bool wrap, Expr const& fill):
+	_src(&v),
+	_fill(fill),
+	_size(size),
+	_start(start),
+	_step(step),
+	_wrap(wrap)
+{ }
+
+pa::VectorView pa::VectorView::shift_left(Vector const& v, const size_t n, Expr const& fill)
+{
+	return VectorView{v, v.size(), (ptrdiff_t)std::min(n, v.size()), 1, false, fill};
+}
+
+pa::VectorView pa::VectorView::shift_right(Vector const& v, const size_t n, Expr const& fill)
+{
+	return VectorView{v, v.size(), -(ptrdiff_t)std::min(n, v.size()), 1, false, fill};
+}
+
+pa::VectorView pa::VectorView::rotate_left(Vector const& v, const size_t n)
+{
+	const size_t size = v.size();
+	return VectorView{v, size, size == 0 ? 0 : (ptrdiff_t)(n%size), 1, true, ExprImm(0)};
+}
+
+pa::VectorView pa::VectorView::rotate_right(Vector const& v, const size_t n)
+{
+	const size_t size = v.size();
+	return VectorView{v, size, size == 0 ? 0 : -(ptrdiff_t)(n%size), 1, true, ExprImm(0)};
+}
+
+pa::VectorView pa::VectorView::extend(Vector const& v, const size_t n, Expr const& fill)
+{
+	return VectorView{v, n, 0, 1, false, fill};
+}
+
+pa::VectorView pa::VectorView::slice(Vector const& v, const size_t start, const size_t size, const ptrdiff_t step)
+{
+	if (size > 0) {
+		const ptrdiff_t last = (ptrdiff_t)start + (ptrdiff_t)(size-1)*step;
+		if (start >= v.size() || last < 0 || last >= (ptrdiff_t)v.size()) {
+			throw errors::SizeMismatch();
+		}
+	}
+	return VectorView{v, size, (ptrdiff_t)start, step, false, ExprImm(0)};
+}
+
+void pa::VectorView::copy()
+{
+	_own = to_vector();
+	_src = nullptr;
+}
+
+pa::Expr& pa::VectorView::at(const size_t i)
+{
+	assert(i < _size);
+	if (_src != nullptr) {
+		copy();
+	}
+	return _own.at(i);
+}
+
+pa::Vector pa::VectorView::to_vector() const
+{
+	if (_src == nullptr) {
+		return _own;
+	}
+	Vector ret;
+	Vector::storage_type& ret_args = ret.args();
+	ret_args.reserve(_size);
+	for (size_t i = 0; i < _size; i++) {
+		ret_args.emplace_back(at(i));
+	}
+	return ret;
+}
+
+pa::Vector pa::VectorView::operator+(pa::Vector const& o) const
+{
+	if (size() != o.size()) {
+		throw errors::SizeMismatch();
+	}
+
+	Vector ret;
+	Vector::storage_type& ret_args = ret.args();
+	ret_args.reserve(size());
+
+	const size_t size_ = size();
+	for (size_t i = 0; i < size_; i++) {
+		ret_args.emplace_back(at(i) + o.at(i));
+	}
+
+	return ret;
+}
+
+pa::Vector pa::VectorView::operator*(pa::Vector const& o) const
+{
+	if (size() != o.size()) {
+		throw errors::SizeMismatch();
+	}
+
+	Vector ret;
+	Vector::storage_type& ret_args = ret.args();
+	ret_args.reserve(size());
+
+	const size_t size_ = size();
+	for (size_t i = 0; i < size_; i++) {
+		ret_args.emplace_back(at(i) * o.at(i));
+	}
+
+	return ret;
+}
+
+pa::Vector pa::VectorView::operator*(pa::Expr const& e) const
+{
+	Vector ret;
+	Vector::storage_type& ret_args = ret.args();
+	ret_args.reserve(size());
+
+	const size_t size_ = size();
+	for (size_t i = 0; i < size_; i++) {
+		ret_args.emplace_back(at(i) * e);
+	}
+
+	return ret;
+}
+
+bool pa::VectorView::operator==(pa::Vector const& o) const
+{
+	if (size() != o.size()) {
+		return false;
+	}
+	const size_t size_ = size();
+	for (size_t i = 0; i < size_; i++) {
+		if (at(i) != o.at(i)) {
+			return false;
+		}
+	}
+	return true;
+}
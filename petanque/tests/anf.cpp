@@ -0,0 +1,86 @@
+#include <pa/anf.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+#include <pa/prettyprinter.h>
+
+#include <random>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static int check_anf(const char* name, ANF const& anf, Expr const& ref)
+{
+	Expr e = anf.to_expr();
+	return check_expr(name, e, ref);
+}
+
+int main()
+{
+	int ret = 0;
+
+	Expr a = symbol("a");
+	Expr b = symbol("b");
+	Expr c = symbol("c");
+	Expr d = symbol("d");
+
+	{
+		ANF anf;
+		if (!ANF::from_expr(ExprAdd({a*b, a*c, b, ExprImm(1)}), anf)) {
+			std::cerr << "unable to create an ANF object" << std::endl;
+			ret = 1;
+		}
+		ret |= check_anf("round trip", anf, ExprAdd({a*b, a*c, b, ExprImm(1)}));
+		if (anf.degree() != 2 || anf.nmonomials() != 4) {
+			std::cerr << "invalid degree or number of monomials" << std::endl;
+			ret = 1;
+		}
+		ANF a_;
+		ANF::from_expr(a+b, a_);
+		ret |= check_anf("(a+b)*(a+c)", a_*ANF{anf}, ExprAdd({a*b, a*c, a*b*c, a}));
+		ret |= check_anf("x+x", anf+anf, ExprImm(0));
+	}
+
+	{
+		ANF anf;
+		if (ANF::from_expr(ExprOr({a, b}), anf) || ANF::from_expr(ExprAdd({ExprMul({a, ExprAdd({b, c})}), d}), anf)) {
+			std::cerr << "ANF object created from an expression that is not in ANF" << std::endl;
+			ret = 1;
+		}
+	}
+
+	// Compare against generic expressions, with supports that span multiple
+	// words.
+	std::mt19937 rng(0xbadc0de);
+	for (size_t nsyms: {4, 20, 100}) {
+		std::vector<Expr> syms;
+		for (size_t i = 0; i < nsyms; i++) {
+			syms.emplace_back(symbol(("x" + std::to_string(i)).c_str()));
+		}
+		for (size_t t = 0; t < 20; t++) {
+			Expr ea = random_anf(rng, syms, 1 + rng()%12, 4);
+			Expr eb = random_anf(rng, syms, 1 + rng()%12, 4);
+			ANF fa, fb;
+			if (!ANF::from_expr(ea, fa) || !ANF::from_expr(eb, fb)) {
+				std::cerr << "unable to create an ANF object" << std::endl;
+				return 1;
+			}
+
+			Expr sum = ea + eb;
+			simps::simplify(sum);
+			ret |= check_anf("add", fa+fb, sum);
+
+			Expr prod = ea * eb;
+			simps::simplify(prod);
+			ANF fprod = fa*fb;
+			ret |= check_anf("mul", fprod, prod);
+			if (fprod != fb*fa) {
+				std::cerr << "multiplication is not commutative" << std::endl;
+				ret = 1;
+			}
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,86 @@
+#include <pa/arena.h>
+#include <pa/exprs.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+#include <pa/vector.h>
+
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static Vector symbolic_vector(size_t n, const char* prefix)
+{
+	Vector ret(n);
+	for (size_t i = 0; i < n; i++) {
+		ret[i] = symbol((std::string{prefix} + std::to_string(i)).c_str());
+	}
+	return ret;
+}
+
+static Vector carry_add(Vector const& a, Vector const& b)
+{
+	Vector ret(a.size());
+	Expr carry = ExprImm(0);
+	for (size_t i = 0; i < a.size(); i++) {
+		ret[i] = a[i] + b[i] + carry;
+		carry = (a[i] * b[i]) + (carry * (a[i] + b[i]));
+		simps::simplify(ret[i]);
+		simps::simplify(carry);
+	}
+	return ret;
+}
+
+int main()
+{
+	int ret = 0;
+	Vector a = symbolic_vector(8, "a");
+	Vector b = symbolic_vector(8, "b");
+
+	const Vector ref = carry_add(a, b);
+
+	Vector exported;
+	Expr escaped;
+	{
+		ArenaScope scope;
+		if (ArenaScope::current() == nullptr) {
+			std::cerr << "no current arena within the scope" << std::endl;
+			ret = 1;
+		}
+		Vector res = carry_add(a, b);
+		if (scope.bytes_allocated() == 0) {
+			std::cerr << "nothing has been allocated in the arena" << std::endl;
+			ret = 1;
+		}
+		exported = ArenaScope::export_vector(res);
+		// This one stays in the arena, and keeps it alive
+		escaped = res[2];
+
+		{
+			ArenaScope nested;
+			Expr e = a[0]*b[0] + a[1];
+			simps::simplify(e);
+			ret |= check_expr("nested", e, a[0]*b[0] + a[1]);
+		}
+		if (ArenaScope::current() == nullptr) {
+			std::cerr << "the nested scope did not restore the previous arena" << std::endl;
+			ret = 1;
+		}
+	}
+	if (ArenaScope::current() != nullptr) {
+		std::cerr << "the arena is still active out of its scope" << std::endl;
+		ret = 1;
+	}
+
+	if (exported != ref) {
+		std::cerr << "exported vector is different from the heap one" << std::endl;
+		ret = 1;
+	}
+	ret |= check_expr("escaped", escaped, ref[2]);
+
+	// Release the arena memory
+	escaped = ExprImm(0);
+
+	return ret;
+}
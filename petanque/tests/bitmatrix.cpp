@@ -0,0 +1,179 @@
+#include <pa/bitmatrix.h>
+#include <pa/matrix.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+
+#include <random>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static BitMatrix random_matrix(size_t nlines, size_t ncols, std::mt19937& rng)
+{
+	BitMatrix ret(nlines, ncols);
+	for (size_t i = 0; i < nlines; i++) {
+		for (size_t j = 0; j < ncols; j++) {
+			ret.set(i, j, rng() & 1);
+		}
+	}
+	return ret;
+}
+
+// Product of random lower and upper unitriangular matrices
+static BitMatrix invertible_matrix(size_t n, std::mt19937& rng)
+{
+	BitMatrix L = random_matrix(n, n, rng);
+	BitMatrix U = random_matrix(n, n, rng);
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++) {
+			L.set(i, j, (i == j) || (j < i && L.at(i, j)));
+			U.set(i, j, (i == j) || (j > i && U.at(i, j)));
+		}
+	}
+	return L*U;
+}
+
+static BitMatrix naive_product(BitMatrix const& a, BitMatrix const& b)
+{
+	BitMatrix ret(a.nlines(), b.ncols());
+	for (size_t i = 0; i < a.nlines(); i++) {
+		for (size_t j = 0; j < b.ncols(); j++) {
+			bool v = false;
+			for (size_t k = 0; k < a.ncols(); k++) {
+				v ^= a.at(i, k) && b.at(k, j);
+			}
+			ret.set(i, j, v);
+		}
+	}
+	return ret;
+}
+
+static int check(const char* name, bool v)
+{
+	if (!v) {
+		std::cerr << "error: " << name << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	int ret = 0;
+	std::mt19937 rng(0);
+
+	// Products, with partial groups of lines
+	for (size_t n: {1, 5, 64, 100}) {
+		BitMatrix a = random_matrix(n+3, n, rng);
+		BitMatrix b = random_matrix(n, 2*n+1, rng);
+		ret |= check(("product " + std::to_string(n)).c_str(), a*b == naive_product(a, b));
+	}
+
+	// Sizes around word and block boundaries
+	for (size_t n: {1, 7, 64, 65, 130, 300}) {
+		const std::string sn = std::to_string(n);
+		BitMatrix M = invertible_matrix(n, rng);
+		BitMatrix Minv = M.inverse();
+		ret |= check(("inverse " + sn).c_str(), M*Minv == BitMatrix::identity(n) && Minv*M == BitMatrix::identity(n));
+		ret |= check(("rank " + sn).c_str(), M.rank() == n);
+
+		// Same as the inverse computed on expressions
+		Matrix m = M.to_matrix();
+		BitMatrix back;
+		ret |= check(("conversion " + sn).c_str(), BitMatrix::from_matrix(m, back) && back == M);
+		ret |= check(("Matrix::inverse " + sn).c_str(), m.inverse() == Minv.to_matrix());
+
+		// Singular matrix: last line is the sum of the first ones
+		if (n > 1) {
+			BitMatrix S = M;
+			for (size_t j = 0; j < n; j++) {
+				S.set(n-1, j, false);
+			}
+			S.add_lines(n-1, 0);
+			S.add_lines(n-1, n/2);
+			ret |= check(("singular rank " + sn).c_str(), S.rank() == n-1);
+			ret |= check(("singular inverse " + sn).c_str(), S.inverse().empty());
+
+			// S*X = B has solutions iff B is in the image of S
+			BitMatrix X0 = random_matrix(n, 3, rng);
+			BitMatrix B = S*X0;
+			BitMatrix X;
+			ret |= check(("solve " + sn).c_str(), S.solve(B, X) && S*X == B);
+			B.set(n-1, 0, !B.at(n-1, 0));
+			ret |= check(("solve without solution " + sn).c_str(), !S.solve(B, X));
+		}
+	}
+
+	// T-factorization: T*M*P = U, with U upper triangular
+	{
+		BitMatrix M = random_matrix(70, 90, rng);
+		for (size_t j = 0; j < 90; j++) {
+			M.set(69, j, M.at(3, j) != M.at(10, j));
+		}
+		BitMatrix T, U;
+		std::vector<size_t> perm;
+		const size_t rank = M.T_fact(T, U, perm);
+		ret |= check("T_fact rank", rank == 69 && M.rank() == 69);
+		BitMatrix P(90, 90);
+		for (size_t j = 0; j < 90; j++) {
+			P.set(perm[j], j, true);
+		}
+		ret |= check("T_fact product", T*M*P == U);
+		bool upper = true;
+		for (size_t i = 0; i < 70; i++) {
+			for (size_t j = 0; j < std::min<size_t>(i+1, 90); j++) {
+				upper &= U.at(i, j) == (i == j && i < rank);
+			}
+		}
+		ret |= check("T_fact upper triangular", upper);
+
+		Matrix T_, U_;
+		std::vector<size_t> perm_;
+		ret |= check("Matrix::T_fact", M.to_matrix().T_fact(T_, U_, perm_) == rank && T_ == T.to_matrix() && U_ == U.to_matrix() && perm_ == perm);
+	}
+
+	// Non square systems
+	{
+		BitMatrix A = random_matrix(10, 150, rng);
+		BitMatrix X0 = random_matrix(150, 2, rng);
+		BitMatrix X;
+		ret |= check("solve 10x150", A.solve(A*X0, X) && A*X == A*X0);
+	}
+
+	// Matrices with symbols aren't converted
+	{
+		Matrix m(2, 2, ExprImm(0));
+		m.at(1, 0) = symbol("a");
+		BitMatrix bits;
+		ret |= check("matrix with symbols", !BitMatrix::from_matrix(m, bits));
+	}
+
+	// Application to a vector
+	{
+		Vector X(65);
+		for (size_t i = 0; i < X.size(); i++) {
+			X[i] = symbol(("x" + std::to_string(i)).c_str());
+		}
+		BitMatrix M = random_matrix(20, 65, rng);
+		Matrix m = M.to_matrix();
+		Vector ref(20);
+		for (size_t i = 0; i < 20; i++) {
+			Expr e = ExprImm(0);
+			for (size_t j = 0; j < 65; j++) {
+				e += m.at(i, j)*X[j];
+			}
+			ref[i] = e;
+		}
+		simps::simplify(ref);
+		Vector v = M*X;
+		simps::simplify(v);
+		ret |= check("BitMatrix*Vector", v == ref);
+		v = m*X;
+		simps::simplify(v);
+		ret |= check("Matrix*Vector", v == ref);
+	}
+
+	return ret;
+}
@@ -0,0 +1,171 @@
+#include <pa/app.h>
+#include <pa/bitsliced.h>
+#include <pa/matrix.h>
+#include <pa/symbols.h>
+#include <pa/vector.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+typedef BitslicedEvaluator::word_type word_type;
+
+static Vector symbolic_vector(const char* prefix, size_t n)
+{
+	Vector ret(n);
+	for (size_t i = 0; i < n; i++) {
+		ret[i] = symbol((std::string{prefix} + std::to_string(i)).c_str());
+	}
+	return ret;
+}
+
+static bool eval_ref(Expr const& e, std::map<Expr, bool> const& values)
+{
+	switch (e.type()) {
+		case expr_type_id::imm_type:
+			return e.as<ExprImm>().value();
+		case expr_type_id::symbol_type:
+			return values.at(e);
+		default:
+			break;
+	}
+	size_t n = 0;
+	for (Expr const& a: e.args()) {
+		n += eval_ref(a, values);
+	}
+	switch (e.type()) {
+		case expr_type_id::add_type:
+			return n & 1;
+		case expr_type_id::mul_type:
+			return n == e.nargs();
+		case expr_type_id::or_type:
+			return n > 0;
+		default:
+			break;
+	}
+	// binomial(n, degree) mod 2 (Lucas' theorem)
+	const size_t degree = e.as<ExprESF>().degree();
+	return (n & degree) == degree;
+}
+
+static int check_eval(const char* name, BitslicedEvaluator const& ev, Vector const& outputs, Vector const& inputs, std::vector<word_type> const& values)
+{
+	const size_t in_row = ev.input_row_words();
+	const size_t out_row = ev.output_row_words();
+	const size_t n = values.size()/in_row;
+	for (auto width: {BitslicedEvaluator::Width::Auto, BitslicedEvaluator::Width::W64, BitslicedEvaluator::Width::W256, BitslicedEvaluator::Width::W512}) {
+		std::vector<word_type> res = ev.eval(values, width);
+		if (res.size() != n*out_row) {
+			std::cerr << name << ": invalid number of results" << std::endl;
+			return 1;
+		}
+		for (size_t p = 0; p < n; p++) {
+			std::map<Expr, bool> point;
+			for (size_t i = 0; i < inputs.size(); i++) {
+				point[inputs[i]] = (values[p*in_row + i/64] >> (i%64)) & 1;
+			}
+			for (size_t o = 0; o < outputs.size(); o++) {
+				const bool ref = eval_ref(outputs[o], point);
+				const bool v = (res[p*out_row + o/64] >> (o%64)) & 1;
+				if (v != ref) {
+					std::cerr << name << ": invalid output " << o << " for input " << p << " (width " << (unsigned)width << ")" << std::endl;
+					return 1;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+int main()
+{
+	int ret = 0;
+	std::mt19937 rng(0);
+
+	{
+		Vector x = symbolic_vector("x", 6);
+		Vector outs(5);
+		for (size_t i = 0; i < outs.size(); i++) {
+			outs[i] = random_expr(rng, x, 4);
+		}
+		// Shared subexpressions are only computed once
+		outs[4] = outs[0];
+		BitslicedEvaluator ev(outs, x);
+
+		// Not a multiple of any block size
+		std::vector<word_type> values(64*8 + 37);
+		for (word_type& v: values) {
+			v = rng() & 0x3F;
+		}
+		ret |= check_eval("random", ev, outs, x, values);
+	}
+
+	{
+		// More than 64 inputs and outputs
+		Vector x = symbolic_vector("x", 70);
+		Vector outs(70);
+		for (size_t i = 0; i < outs.size(); i++) {
+			outs[i] = ExprAdd({x[i]*x[(i+1)%70], x[(i+5)%70], ExprImm(1)});
+		}
+		BitslicedEvaluator ev(outs, x);
+		std::vector<word_type> values(2*300);
+		for (size_t i = 0; i < values.size(); i++) {
+			values[i] = ((word_type)rng() << 32) | rng();
+			if (i & 1) {
+				values[i] &= 0x3F;
+			}
+		}
+		ret |= check_eval("wide", ev, outs, x, values);
+	}
+
+	{
+		// App(X) = NL(X) + M*X + V
+		Vector x = symbolic_vector("x", 4);
+		Vector nl{x[0]*x[1], x[2]|x[3], ExprImm(0), ExprESF(2, {x[0], x[1], x[2]})};
+		Matrix M(4, 4, ExprImm(0));
+		M.at(0, 0) = ExprImm(1);
+		M.at(1, 3) = ExprImm(1);
+		M.at(2, 1) = ExprImm(1);
+		M.at(2, 2) = ExprImm(1);
+		Vector V{ExprImm(1), ExprImm(0), ExprImm(1), ExprImm(0)};
+		App app(VectorApp(x, nl), M, V);
+		BitslicedEvaluator ev(app);
+
+		Vector args(4);
+		Vector outs(4);
+		for (size_t i = 0; i < 4; i++) {
+			args[i] = arg_symbol(i);
+		}
+		for (size_t i = 0; i < 4; i++) {
+			outs[i] = ExprAdd({app.nl().vector()[i], V[i]});
+			for (size_t j = 0; j < 4; j++) {
+				if (M.at(i, j).as<ExprImm>().value()) {
+					outs[i] = ExprAdd({outs[i], args[j]});
+				}
+			}
+		}
+		std::vector<word_type> values(16);
+		for (size_t i = 0; i < values.size(); i++) {
+			values[i] = i;
+		}
+		ret |= check_eval("app", ev, outs, args, values);
+	}
+
+	{
+		Vector x = symbolic_vector("x", 2);
+		Vector y = symbolic_vector("y", 1);
+		try {
+			BitslicedEvaluator ev(Vector{x[0]*y[0]}, x);
+			std::cerr << "unknown symbols should be rejected" << std::endl;
+			ret = 1;
+		}
+		catch (BitslicedEvaluator::UnknownSymbol const&) {
+		}
+	}
+
+	return ret;
+}
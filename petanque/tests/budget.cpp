@@ -0,0 +1,199 @@
+#include <pa/budget.h>
+#include <pa/errors.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "tests.h"
+
+using namespace pa;
+
+static Expr simplified(Expr e)
+{
+	simps::simplify(e);
+	return e;
+}
+
+static Vector simplified(Vector v)
+{
+	simps::simplify(v);
+	return v;
+}
+
+static Expr expanded(Expr e)
+{
+	simps::expand_esf(e);
+	simps::simplify(e);
+	return e;
+}
+
+// Checks that f throws BudgetExceeded for the given reason
+template <class F>
+static int check_exceeded(const char* name, errors::BudgetExceeded::Reason reason, F const& f)
+{
+	try {
+		f();
+	}
+	catch (errors::BudgetExceeded const& e) {
+		if (e.reason != reason) {
+			std::cerr << name << ": bad reason: " << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+	std::cerr << name << ": budget not exceeded" << std::endl;
+	return 1;
+}
+
+int main()
+{
+	int ret = 0;
+
+	std::vector<Expr> syms;
+	for (size_t i = 0; i < 30; i++) {
+		syms.push_back(symbol(("x" + std::to_string(i)).c_str()));
+	}
+	ExprMul prod;
+	for (size_t i = 0; i < 3; i++) {
+		prod.args().insert(ExprAdd(syms.begin()+i*10, syms.begin()+(i+1)*10));
+	}
+	const Expr ref = simplified(prod);
+
+	Budget budget;
+	BudgetScope scope(&budget);
+
+	// Too many nodes: the expression is left partially simplified, and can
+	// be simplified again afterwards
+	{
+		budget.set_max_nodes(2);
+		Expr e = ExprAdd({prod, ExprMul({syms[0], ExprAdd({syms[1], syms[2]})})});
+		ret |= check_exceeded("nodes", errors::BudgetExceeded::nodes, [&e]() { simps::simplify(e); });
+		budget.set_max_nodes(0);
+		budget.reset();
+		simps::simplify(e);
+		ret |= check_expr("simplify after nodes", e, simplified(ExprAdd({ref, ExprMul({syms[0], ExprAdd({syms[1], syms[2]})})})));
+	}
+
+	// Too many monomials: the product is left untouched
+	{
+		budget.set_max_monomials(100);
+		Expr e = prod;
+		ret |= check_exceeded("monomials", errors::BudgetExceeded::monomials, [&e]() { simps::simplify(e); });
+		ret |= check_expr("product after monomials", e, prod);
+		budget.set_max_monomials(1000);
+		budget.reset();
+		simps::simplify(e);
+		ret |= check_expr("product within budget", e, ref);
+		if (budget.monomials() != 1000) {
+			std::cerr << "bad number of monomials: " << budget.monomials() << std::endl;
+			ret = 1;
+		}
+		budget.set_max_monomials(0);
+		budget.reset();
+	}
+
+	// ESFs are left untouched too
+	{
+		budget.set_max_monomials(1000);
+		const Expr esf = ExprESF(10, syms.begin(), syms.end());
+		Expr e = esf;
+		ret |= check_exceeded("ESF monomials", errors::BudgetExceeded::monomials, [&e]() { simps::expand_esf(e); });
+		ret |= check_expr("ESF after monomials", e, esf);
+		budget.set_max_monomials(0);
+		budget.reset();
+	}
+
+	// ESFs with immediate arguments are rewritten once their new form is
+	// simplified: whenever the budget is exceeded, the ESF still expands to
+	// the same value
+	{
+		const Expr esf = ExprESF(2, {syms[0], syms[1], syms[2], ExprImm(1)});
+		const Expr esf_ref = expanded(esf);
+		for (uint64_t max_nodes = 1; ; max_nodes++) {
+			budget.set_max_nodes(max_nodes);
+			budget.reset();
+			Expr e = esf;
+			bool exceeded = false;
+			try {
+				simps::simplify(e);
+			}
+			catch (errors::BudgetExceeded const&) {
+				exceeded = true;
+			}
+			budget.set_max_nodes(0);
+			budget.reset();
+			ret |= check_expr(("ESF with immediates after " + std::to_string(max_nodes) + " nodes").c_str(), expanded(e), esf_ref);
+			if (!exceeded) {
+				break;
+			}
+		}
+	}
+
+	// Cancellation
+	{
+		budget.cancel();
+		Expr e = prod;
+		ret |= check_exceeded("cancel", errors::BudgetExceeded::cancelled, [&e]() { simps::simplify(e); });
+		budget.reset();
+		simps::simplify(e);
+		ret |= check_expr("simplify after reset", e, ref);
+	}
+
+	// Deadline
+	{
+		budget.set_timeout(1e-6);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		Expr e = prod;
+		ret |= check_exceeded("deadline", errors::BudgetExceeded::deadline, [&e]() { simps::simplify(e); });
+		budget.set_timeout(0);
+		simps::simplify(e);
+		ret |= check_expr("simplify without deadline", e, ref);
+	}
+
+	// Tasks spawned by parallel simplifications account their resources in
+	// the budget of the caller
+	{
+		const size_t grain_size = simps::config().grain_size;
+		Vector v(256);
+		for (size_t i = 0; i < v.size(); i++) {
+			v[i] = ExprMul({syms[i%30], ExprAdd({syms[(i+1)%30], syms[(i+2)%30]}), ExprAdd({syms[(i+3)%30], syms[(i+4)%30], syms[i%7]})});
+		}
+		budget.reset();
+		simps::config().grain_size = ~size_t{0};
+		simplified(v);
+		const uint64_t nodes = budget.nodes();
+		budget.reset();
+		simps::config().grain_size = 1;
+		simplified(v);
+		if (budget.nodes() != nodes) {
+			std::cerr << "bad number of nodes in parallel: " << budget.nodes() << " instead of " << nodes << std::endl;
+			ret = 1;
+		}
+		simps::config().grain_size = grain_size;
+		budget.reset();
+	}
+
+	// Budgets only apply to the threads in their scope
+	{
+		budget.cancel();
+		Expr e = prod;
+		std::thread t([&e]() { simps::simplify(e); });
+		t.join();
+		ret |= check_expr("simplify in another thread", e, ref);
+
+		e = prod;
+		{
+			BudgetScope no_limit(nullptr);
+			simps::simplify(e);
+		}
+		ret |= check_expr("simplify in a nested scope", e, ref);
+		e = prod;
+		ret |= check_exceeded("cancel after a nested scope", errors::BudgetExceeded::cancelled, [&e]() { simps::simplify(e); });
+		budget.reset();
+	}
+
+	return ret;
+}
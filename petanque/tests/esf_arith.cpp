@@ -0,0 +1,118 @@
+#include <pa/anf.h>
+#include <pa/esf.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+// Checks that e and ref are the same boolean function
+static int check_same(std::string const& name, Expr const& e, Expr const& ref)
+{
+	ANF anf_e;
+	ANF anf_ref;
+	if (!ANF::from_expr_truth_table(e, anf_e, 20) || !ANF::from_expr_truth_table(ref, anf_ref, 20)) {
+		std::cerr << name << ": support is too large" << std::endl;
+		return 1;
+	}
+	return check_expr(name.c_str(), anf_e.to_expr(), anf_ref.to_expr());
+}
+
+static size_t count_esfs(Expr const& e)
+{
+	size_t ret = e.is_esf();
+	if (e.has_args()) {
+		for (Expr const& a: e.args()) {
+			ret += count_esfs(a);
+		}
+	}
+	return ret;
+}
+
+int main()
+{
+	int ret = 0;
+
+	Expr a = symbol("a");
+	Expr b = symbol("b");
+	Expr c = symbol("c");
+	Expr d = symbol("d");
+
+	ExprArgs X;
+	for (size_t i = 0; i < 7; i++) {
+		X.insert(symbol(("x" + std::to_string(i)).c_str()));
+	}
+
+	for (size_t i = 0; i <= X.size(); i++) {
+		for (size_t j = 0; j <= X.size(); j++) {
+			const std::string name = "e_" + std::to_string(i) + "*e_" + std::to_string(j);
+			ret |= check_same(name, esf_product(i, j, X), ExprMul({esf(i, X), esf(j, X)}));
+		}
+		for (size_t ones = 0; ones <= 3; ones++) {
+			ExprArgs Y = X;
+			for (size_t o = 0; o < ones; o++) {
+				Y.insert_dup(ExprImm(1));
+			}
+			const std::string name = "e_" + std::to_string(i) + "(X, " + std::to_string(ones) + " ones)";
+			ret |= check_same(name, esf_with_ones(i, X, ones), (i == 0) ? Expr(ExprImm(1)) : Expr(ExprESF(i, Y)));
+		}
+	}
+
+	// Operators
+	ret |= check_expr("SF(2, a, b, c, d)*SF(3, a, b, c, d)", ExprESF(2, {a, b, c, d})*ExprESF(3, {a, b, c, d}), ExprESF(3, {a, b, c, d}));
+	ret |= check_expr("SF(2, a, b, c)*(a+b+c)", ExprESF(2, {a, b, c})*ExprAdd({a, b, c}), a*b*c);
+
+	// Simplifications
+	{
+		Expr e = ExprMul({ExprESF(2, {a, b, c, d}), ExprAdd({a, b, c, d}), d});
+		Expr ref = e;
+		simps::simplify(e);
+		ret |= check_same("simplify(SF(2, a, b, c, d)*(a+b+c+d)*d)", e, ref);
+		ret |= check_expr("simplify(SF(2, a, b, c, d)*(a+b+c+d)*d)", e, ExprMul({ExprESF(3, {a, b, c, d}), d}));
+	}
+	{
+		Expr e = ExprAdd({ExprESF(2, {a, b, c}), ExprESF(2, {a, b, c, d})});
+		simps::simplify(e);
+		ret |= check_expr("simplify(SF(2, a, b, c) + SF(2, a, b, c, d))", e, ExprAdd({a*d, b*d, c*d}));
+	}
+	{
+		Expr e = ExprESF(3, {a, b, c, d, ExprImm(1)});
+		simps::simplify(e);
+		ret |= check_expr("simplify(SF(3, a, b, c, d, 1))", e, ExprAdd({ExprESF(3, {a, b, c, d}), ExprESF(2, {a, b, c, d})}));
+	}
+
+	// An 8-bit adder with the carries kept as ESFs. The carry of bit i+1 is
+	// e_2 of the arguments of the sum bit i, thus their product is e_3 of
+	// these arguments, which doesn't need to expand the ESFs.
+	{
+		std::vector<Expr> sum;
+		std::vector<Expr> carries;
+		Expr carry = ExprImm(0);
+		for (size_t i = 0; i < 8; i++) {
+			Expr x = symbol(("a" + std::to_string(i)).c_str());
+			Expr y = symbol(("b" + std::to_string(i)).c_str());
+			Expr s = ExprAdd({x, y, carry});
+			simps::simplify(s);
+			sum.push_back(s);
+			carry = ExprESF(2, {x, y, carry});
+			simps::simplify(carry);
+			carries.push_back(carry);
+		}
+		for (size_t i = 1; i < 8; i++) {
+			const std::string name = "carry*sum " + std::to_string(i);
+			Expr e = ExprMul({carries[i], sum[i]});
+			Expr ref = e;
+			simps::simplify(e);
+			ret |= check_same(name, e, ref);
+			if (count_esfs(e) > count_esfs(ref)) {
+				std::cerr << name << ": ESFs have been expanded" << std::endl;
+				ret = 1;
+			}
+		}
+	}
+
+	return ret;
+}
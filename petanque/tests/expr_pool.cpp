@@ -0,0 +1,113 @@
+#include <pa/exprs.h>
+#include <pa/expr_pool.h>
+#include <pa/prettyprinter.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+#include <pa/vector.h>
+
+#include "tests.h"
+
+using namespace pa;
+
+static int check_op(const char* name, Expr const& ref, ExprRef r)
+{
+	return check_expr(name, ExprPool::to_expr(r), ref);
+}
+
+int main()
+{
+	int ret = 0;
+	Expr a = symbol("a");
+	Expr b = symbol("b");
+	Expr c = symbol("c");
+	Expr d = symbol("d");
+
+	ExprPool pool;
+
+	{
+		Expr e = ExprAdd({ExprMul({a, b}), ExprMul({c, d}), a, ExprImm(1)});
+		simps::simplify(e);
+		ExprRef r0 = pool.intern(e);
+		const size_t size = pool.size();
+		ExprRef r1 = pool.intern(Expr{e});
+		if (r0 != r1 || pool.size() != size) {
+			std::cerr << "interning the same expression twice gave different handles" << std::endl;
+			ret = 1;
+		}
+		if (r0.hash() != r1.hash()) {
+			std::cerr << "hashes are different" << std::endl;
+			ret = 1;
+		}
+		ret |= check_expr("intern/to_expr", ExprPool::to_expr(r0), e);
+	}
+
+	{
+		// Shared subterms must be stored once
+		ExprPool pool2;
+		Expr carry = ExprAdd({ExprMul({a, b}), ExprMul({c, d})});
+		Vector v({ExprAdd({carry, a}), ExprMul({carry, b}), ExprOr({carry, c})});
+		auto refs = pool2.intern(v);
+		// a, b, c, d, a*b, c*d, carry, and the three roots
+		if (pool2.size() != 10) {
+			std::cerr << "expected 10 interned nodes, got " << pool2.size() << std::endl;
+			ret = 1;
+		}
+		if (ExprPool::to_vector(refs) != v) {
+			std::cerr << "intern/to_vector round trip failed" << std::endl;
+			ret = 1;
+		}
+	}
+
+	{
+		Expr e0 = ExprAdd({ExprMul({a, b}), c, ExprImm(1)});
+		Expr e1 = ExprAdd({ExprMul({a, b}), d});
+		Expr e2 = ExprMul({a, c});
+		Expr e3 = ExprOr({a, d});
+		Expr e4 = ExprESF(2, {a, b, c});
+		Expr e5 = ExprESF(3, {a, b, c, d});
+		Expr e6 = ExprAdd({a, b, c});
+		Expr exprs[] = {a, b, ExprImm(0), ExprImm(1), e0, e1, e2, e3, e4, e5, e6};
+		for (Expr const& x: exprs) {
+			for (Expr const& y: exprs) {
+				ExprRef rx = pool.intern(x);
+				ExprRef ry = pool.intern(y);
+				ret |= check_op("x+y", x + y, rx + ry);
+				ret |= check_op("x*y", x * y, rx * ry);
+				ret |= check_op("x|y", x | y, rx | ry);
+			}
+		}
+	}
+
+	{
+		// Carry-chain like construction: everything must stay shared
+		ExprRef ra = pool.intern(a);
+		ExprRef rb = pool.intern(b);
+		ExprRef carry = pool.imm(false);
+		for (int i = 0; i < 8; i++) {
+			carry = ra*rb + carry*(ra + rb);
+		}
+		const size_t size = pool.size();
+		ExprRef carry2 = pool.imm(false);
+		for (int i = 0; i < 8; i++) {
+			carry2 = ra*rb + carry2*(ra + rb);
+		}
+		if (carry != carry2 || pool.size() != size) {
+			std::cerr << "carry chain has not been shared" << std::endl;
+			ret = 1;
+		}
+
+		// Same as with the Expr operators
+		Expr ecarry = ExprImm(0);
+		for (int i = 0; i < 8; i++) {
+			ecarry = a*b + ecarry*(a + b);
+		}
+		ret |= check_expr("carry chain", ExprPool::to_expr(carry), ecarry);
+		Vector v({ecarry, a*b + ecarry, ecarry*b});
+		if (ExprPool::to_vector({carry, ra*rb + carry, carry*rb}) != v) {
+			std::cerr << "to_vector of the carry chain failed" << std::endl;
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
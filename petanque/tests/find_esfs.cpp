@@ -0,0 +1,88 @@
+#include <pa/analyses.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+
+#include <random>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static Expr expanded(Expr e)
+{
+	simps::expand_esf(e);
+	simps::simplify(e);
+	return e;
+}
+
+int main()
+{
+	int ret = 0;
+
+	Expr a = symbol("a");
+	Expr b = symbol("b");
+	Expr c = symbol("c");
+	Expr d = symbol("d");
+
+	{
+		Expr e = ExprOr({a, b, c, d});
+		simps::or_to_esf(e);
+		e = expanded(e);
+		std::vector<Expr> esfs = analyses::find_esfs(e);
+		if (esfs.size() != 2) {
+			std::cerr << "bad number of ESFs found in a|b|c|d: " << esfs.size() << std::endl;
+			return 1;
+		}
+		ret |= check_expr("first ESF of a|b|c|d", esfs[0], ExprESF(3, {a, b, c, d}));
+		ret |= check_expr("second ESF of a|b|c|d", esfs[1], ExprESF(2, {a, b, c, d}));
+		simps::simplify(e);
+		ret |= check_expr("a|b|c|d", e, ExprAdd({ExprESF(2, {a, b, c, d}), ExprESF(3, {a, b, c, d}), a*b*c*d, a, b, c, d}));
+	}
+
+	{
+		Expr e = expanded(ExprAdd({a*b, a, ExprImm(1)}));
+		Expr ref = e;
+		std::vector<Expr> esfs = analyses::find_esfs(e);
+		if (!esfs.empty()) {
+			std::cerr << "ESF found in a*b + a + 1" << std::endl;
+			ret = 1;
+		}
+		ret |= check_expr("a*b + a + 1", e, ref);
+	}
+
+	// ESFs over disjoint sets of symbols, mixed with some linear terms
+	{
+		std::mt19937 rng(0);
+		std::vector<Expr> syms;
+		for (size_t i = 0; i < 256; i++) {
+			syms.push_back(symbol(("x" + std::to_string(i)).c_str()));
+		}
+		Expr planted = ExprImm(0);
+		size_t nesfs = 0;
+		size_t i = 0;
+		while (true) {
+			const size_t degree = 2 + rng()%3;
+			const size_t nargs = degree + 1 + rng()%6;
+			if (i + nargs > syms.size()) {
+				break;
+			}
+			planted = planted + ExprESF(degree, syms.begin()+i, syms.begin()+i+nargs);
+			nesfs++;
+			i += nargs;
+			if (rng()%2) {
+				planted = planted + syms[i-1];
+			}
+		}
+		Expr e = expanded(planted);
+		const Expr ref = e;
+		std::vector<Expr> esfs = analyses::find_esfs(e);
+		if (esfs.size() != nesfs) {
+			std::cerr << "found " << esfs.size() << " ESFs, expected " << nesfs << std::endl;
+			ret = 1;
+		}
+		ret |= check_expr("expansion of the found ESFs", expanded(e), ref);
+	}
+
+	return ret;
+}
@@ -1,6 +1,8 @@
 #include <pa/simps.h>
 #include <pa/symbols.h>
 
+#include <string>
+
 #include "tests.h"
 
 using namespace pa;
@@ -88,5 +90,22 @@ int main()
 		ret |= check_ors(exp);
 	}
 
-	return 0;
+	{
+		// ORs of 2, 3 and 4 symbols among 96 symbols, with some symbols that
+		// aren't part of any OR
+		std::vector<Expr> syms;
+		for (size_t i = 0; i < 96; i++) {
+			syms.push_back(symbol(("s" + std::to_string(i)).c_str()));
+		}
+		ExprAdd exp;
+		size_t i = 0;
+		for (size_t k = 2; i+k < syms.size(); k = ((k-1) % 3) + 2) {
+			exp.emplace_arg(ExprOr(syms.begin()+i, syms.begin()+i+k));
+			i += k+1;
+			exp.emplace_arg(syms[i-1]);
+		}
+		ret |= check_ors(exp);
+	}
+
+	return ret;
 }
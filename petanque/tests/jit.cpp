@@ -0,0 +1,124 @@
+#include <pa/app.h>
+#include <pa/bitsliced.h>
+#include <pa/jit.h>
+#include <pa/matrix.h>
+#include <pa/symbols.h>
+#include <pa/vector.h>
+
+#include <random>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+typedef JitFunction::word_type word_type;
+
+static Vector symbolic_vector(const char* prefix, size_t n)
+{
+	Vector ret(n);
+	for (size_t i = 0; i < n; i++) {
+		ret[i] = symbol((std::string{prefix} + std::to_string(i)).c_str());
+	}
+	return ret;
+}
+
+// Compares the native function with the interpreter of its evaluator
+static int check_jit(const char* name, JitFunction const& f, std::vector<word_type> const& values)
+{
+	const size_t in_row = f.input_row_words();
+	const size_t out_row = f.output_row_words();
+	const size_t n = values.size()/in_row;
+	std::vector<word_type> ref = f.evaluator().eval(values, BitslicedEvaluator::Width::W64);
+	if (f.eval(values) != ref) {
+		std::cerr << name << ": batch evaluation differs from the interpreter" << std::endl;
+		return 1;
+	}
+	std::vector<word_type> out(out_row);
+	for (size_t p = 0; p < n; p++) {
+		f(&values[p*in_row], &out[0]);
+		if (!std::equal(out.begin(), out.end(), ref.begin() + p*out_row)) {
+			std::cerr << name << ": invalid result for input " << p << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main()
+{
+	int ret = 0;
+	std::mt19937 rng(0);
+
+	{
+		Vector x = symbolic_vector("x", 6);
+		Vector outs(6);
+		for (size_t i = 0; i < outs.size(); i++) {
+			outs[i] = random_expr(rng, x, 4);
+		}
+		auto f = jit_compile(outs, x);
+#if defined(__x86_64__) || defined(_M_X64)
+		if (!f->is_native()) {
+			std::cerr << "no native code generated" << std::endl;
+			ret = 1;
+		}
+#endif
+		// Not a multiple of any block size
+		std::vector<word_type> values(64*5 + 13);
+		for (word_type& v: values) {
+			v = rng() & 0x3F;
+		}
+		ret |= check_jit("random", *f, values);
+
+		// Compiled functions are cached
+		if (jit_compile(Vector(outs), Vector(x)) != f || jit_cache_size() != 1) {
+			std::cerr << "function not found in the cache" << std::endl;
+			ret = 1;
+		}
+		outs[0] = outs[0] + x[0];
+		if (jit_compile(outs, x) == f || jit_cache_size() != 2) {
+			std::cerr << "different vectors must have different functions" << std::endl;
+			ret = 1;
+		}
+		jit_cache_clear();
+		if (jit_cache_size() != 0) {
+			std::cerr << "cache not cleared" << std::endl;
+			ret = 1;
+		}
+	}
+
+	{
+		// More than 64 inputs and outputs
+		Vector x = symbolic_vector("x", 70);
+		Vector outs(70);
+		for (size_t i = 0; i < outs.size(); i++) {
+			outs[i] = ExprAdd({x[i]*x[(i+1)%70], ExprESF(2, {x[(i+5)%70], x[(i+7)%70], x[i]}), ExprImm(1)});
+		}
+		auto f = jit_compile(outs, x);
+		std::vector<word_type> values(2*100);
+		for (size_t i = 0; i < values.size(); i++) {
+			values[i] = ((word_type)rng() << 32) | rng();
+			if (i & 1) {
+				values[i] &= 0x3F;
+			}
+		}
+		ret |= check_jit("wide", *f, values);
+	}
+
+	{
+		Vector x = symbolic_vector("x", 3);
+		Vector nl{x[0]*x[1], x[1]|x[2], ExprImm(1)};
+		Matrix M(3, 3, ExprImm(0));
+		M.at(0, 2) = ExprImm(1);
+		M.at(2, 0) = ExprImm(1);
+		App app(VectorApp(x, nl), M, Vector{ExprImm(0), ExprImm(1), ExprImm(0)});
+		auto f = jit_compile(app);
+		std::vector<word_type> values(8);
+		for (size_t i = 0; i < values.size(); i++) {
+			values[i] = i;
+		}
+		ret |= check_jit("app", *f, values);
+	}
+
+	return ret;
+}
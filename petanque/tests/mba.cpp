@@ -0,0 +1,155 @@
+#include <pa/errors.h>
+#include <pa/mba.h>
+#include <pa/simps.h>
+#include <pa/subs.h>
+
+#include <array>
+#include <functional>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static uint64_t eval(Vector v, Vector const& X, uint64_t x, Vector const& Y, uint64_t y)
+{
+	simps::expand_esf(v);
+	subs_vectors(v, std::array<Vector, 2>{{X, Y}}, std::array<uint64_t, 2>{{x, y}});
+	simps::simplify(v);
+	bool res;
+	const uint64_t ret = v.get_int_be(&res);
+	if (!res) {
+		std::cerr << "result is not an immediate" << std::endl;
+		return ~uint64_t{0};
+	}
+	return ret;
+}
+
+// Checks that v evaluates to ref(x, y) for every value of x (and y if v
+// depends on Y)
+static int check_op(MBA const& mba, std::string const& name, Vector const& X, Vector const& Y, Vector const& v, std::function<uint64_t(uint64_t, uint64_t)> const& ref, bool binary = false)
+{
+	const uint64_t mask = (uint64_t{1} << mba.nbits()) - 1;
+	for (uint64_t x = 0; x <= mask; x++) {
+		for (uint64_t y = 0; y <= (binary ? mask : 0); y++) {
+			const uint64_t res = eval(v, X, x, Y, y);
+			if (res != (ref(x, y) & mask)) {
+				std::cerr << name << (mba.use_esf() ? " (ESF)" : "") << ": invalid result for x = " << x << ", y = " << y << ": " << res << " instead of " << (ref(x, y) & mask) << std::endl;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int main()
+{
+	int ret = 0;
+
+	for (bool use_esf: {false, true}) {
+		MBA mba(4);
+		mba.set_use_esf(use_esf);
+		const Vector X = mba.var_symbols("X");
+		const Vector Y = mba.var_symbols("Y");
+
+		ret |= check_op(mba, "add_Y", X, Y, mba.add_Y(X, Y), [](uint64_t x, uint64_t y) { return x+y; }, true);
+		ret |= check_op(mba, "sub_Y", X, Y, mba.sub_Y(X, Y), [](uint64_t x, uint64_t y) { return x-y; }, true);
+		ret |= check_op(mba, "mul_Y", X, Y, mba.mul_Y(X, Y), [](uint64_t x, uint64_t y) { return x*y; }, true);
+		ret |= check_op(mba, "or_Y", X, Y, mba.or_Y(X, Y), [](uint64_t x, uint64_t y) { return x|y; }, true);
+		ret |= check_op(mba, "oppose_X", X, Y, mba.oppose_X(X), [](uint64_t x, uint64_t) { return -x; });
+		for (uint64_t n = 0; n < 16; n++) {
+			const std::string sn = std::to_string(n);
+			ret |= check_op(mba, "add_n " + sn, X, Y, mba.add_n(X, n), [n](uint64_t x, uint64_t) { return x+n; });
+			ret |= check_op(mba, "sub_n " + sn, X, Y, mba.sub_n(X, n), [n](uint64_t x, uint64_t) { return x-n; });
+			ret |= check_op(mba, "mul_n " + sn, X, Y, mba.mul_n(X, n), [n](uint64_t x, uint64_t) { return x*n; });
+			ret |= check_op(mba, "xor_n " + sn, X, Y, mba.xor_n(X, n), [n](uint64_t x, uint64_t) { return x^n; });
+			// Expanding the carries of the 9 bits multiplication is too
+			// expensive with ESFs
+			if (n > 0 && !use_esf) {
+				ret |= check_op(mba, "div_n " + sn, X, Y, mba.div_n(X, n), [n](uint64_t x, uint64_t) { return x/n; });
+			}
+			ret |= check_op(mba, "lshift_n " + sn, X, Y, mba.lshift_n(X, n), [n](uint64_t x, uint64_t) { return x<<n; });
+			ret |= check_op(mba, "rshift_n " + sn, X, Y, mba.rshift_n(X, n), [n](uint64_t x, uint64_t) { return x>>n; });
+			ret |= check_op(mba, "rol_n " + sn, X, Y, mba.rol_n(X, n), [n](uint64_t x, uint64_t) { return (x<<(n%4)) | (x>>((4-n%4)%4)); });
+		}
+		{
+			Vector Z = X;
+			mba.iadd_lshifted_Y(Z, Y, 2);
+			ret |= check_op(mba, "iadd_lshifted_Y", X, Y, Z, [](uint64_t x, uint64_t y) { return x+(y<<2); }, true);
+		}
+	}
+
+	// Multiplications and divisions by constants over larger words, with
+	// constant operands
+	{
+		MBA mba(64);
+		const uint64_t xs[] = {0, 1, 0x1234567890ABCDEF, ~uint64_t{0}, uint64_t{1} << 63};
+		const uint64_t ns[] = {1, 3, 7, 10, 0xB, 0xD, 0xFFFF, 0x5555555555555555, ~uint64_t{0}, uint64_t{1} << 63};
+		for (uint64_t x: xs) {
+			const Vector X = mba.cst(x);
+			for (uint64_t n: ns) {
+				Vector v = mba.mul_n(X, n);
+				simps::simplify(v);
+				if (v.get_int_be() != x*n) {
+					std::cerr << "mul_n: invalid result for " << x << "*" << n << std::endl;
+					ret = 1;
+				}
+				v = mba.div_n(X, n);
+				simps::simplify(v);
+				if (v.get_int_be() != x/n) {
+					std::cerr << "div_n: invalid result for " << x << "/" << n << std::endl;
+					ret = 1;
+				}
+			}
+		}
+	}
+
+	// Constants wider than 64 bits, over 128 bits words
+	for (bool use_esf: {false, true}) {
+		MBA mba(128);
+		mba.set_use_esf(use_esf);
+		const MBA::Constant x{3, 1};
+		const MBA::Constant n{5, 2};
+		const MBA::Constant mask{~uint64_t{0}, ~uint64_t{0}};
+		const Vector X = mba.cst(x);
+		auto check = [&](const char* name, Vector v, MBA::Constant const& ref) {
+			simps::simplify(v);
+			if (v != mba.cst(ref)) {
+				std::cerr << name << (use_esf ? " (ESF)" : "") << ": invalid result over 128 bits" << std::endl;
+				ret = 1;
+			}
+		};
+		check("add_n", mba.add_n(X, n), {8, 3});
+		check("sub_n", mba.sub_n(X, n), {~uint64_t{0}-1, ~uint64_t{0}-1});
+		check("mul_n", mba.mul_n(X, n), {15, 11});
+		// Simplifying the carries of the 257 bits multiplication is too
+		// expensive with ESFs
+		if (!use_esf) {
+			check("div_n", mba.div_n(mba.cst(MBA::Constant{0, 7}), MBA::Constant{7}), {0, 1});
+			check("div_n", mba.div_n(mba.cst(n), x), {1, 0});
+			check("div_n", mba.div_n(X, mask), {0, 0});
+		}
+		check("and_n", mba.and_n(X, n), {1, 0});
+		check("xor_n", mba.xor_n(X, n), {6, 3});
+		check("or_n", mba.or_n(X, n), {7, 3});
+		// Bits above nbits are ignored
+		check("add_n", mba.add_n(X, MBA::Constant{1, 0, 1}), {4, 1});
+	}
+
+	{
+		MBA mba(8);
+		bool thrown = false;
+		try {
+			mba.div_n(mba.cst(1), 0);
+		}
+		catch (errors::DivisionByZero const&) {
+			thrown = true;
+		}
+		if (!thrown) {
+			std::cerr << "division by zero not detected" << std::endl;
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,95 @@
+#include <pa/anf.h>
+#include <pa/products.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static Expr random_term(std::mt19937& rng, std::vector<Expr> const& syms)
+{
+	switch (rng()%6) {
+		case 0:
+			return ExprImm(rng()&1);
+		case 1:
+			return syms[rng()%syms.size()];
+		case 2:
+			return ExprOr({syms[0], syms[1 + rng()%(syms.size()-1)]});
+		case 3:
+			return ExprESF(2, {syms[0], syms[1], syms[2 + rng()%(syms.size()-2)]});
+		default:
+		{
+			Expr ret = ExprImm(1);
+			const size_t n = 1 + rng()%4;
+			for (size_t i = 0; i < n; i++) {
+				ret = ret*syms[rng()%syms.size()];
+			}
+			return ret;
+		}
+	};
+}
+
+int main()
+{
+	int ret = 0;
+
+	std::mt19937 rng(0x5eed);
+	std::vector<Expr> syms;
+	for (size_t i = 0; i < 600; i++) {
+		syms.emplace_back(symbol(("x" + std::to_string(i)).c_str()));
+	}
+	// Some symbols far away in the symbols table
+	syms.emplace_back(arg_symbol(0));
+	syms.emplace_back(arg_symbol(1));
+
+	for (size_t n: {10, 100, 1000}) {
+		ExprTerms terms;
+		for (size_t i = 0; i < n; i++) {
+			terms.emplace_back(random_term(rng, syms));
+		}
+		// Duplicates to cancel
+		for (size_t i = 0; i < n/4; i++) {
+			terms.emplace_back(terms[rng()%n]);
+		}
+		std::vector<Expr> ref(terms.begin(), terms.end());
+		std::sort(ref.begin(), ref.end());
+
+		ExprTerms sorted = terms;
+		sort_terms(sorted, false);
+		if (!std::equal(sorted.begin(), sorted.end(), ref.begin(), ref.end())) {
+			std::cerr << "sort_terms doesn't sort " << n << " terms" << std::endl;
+			ret = 1;
+		}
+
+		Expr sum = ExprAdd(ref.begin(), ref.end());
+		simps::simplify(sum);
+		sort_terms(terms, true);
+		ret |= check_expr("cancelled terms", ExprAdd(ExprArgs(true, std::move(terms))), sum);
+	}
+
+	{
+		// Two additions whose product is too large for the dense ANF
+		Expr a = ExprImm(0);
+		Expr b = ExprImm(0);
+		for (size_t i = 0; i < 40; i++) {
+			a += syms[rng()%syms.size()]*syms[rng()%syms.size()];
+			b += syms[rng()%syms.size()]*syms[rng()%syms.size()] + syms[rng()%syms.size()];
+		}
+		simps::simplify(a);
+		simps::simplify(b);
+		Expr prod = ExprAdd(ExprArgs(true, expand_products(a.args(), b.args())));
+		Expr ref = ExprImm(0);
+		for (Expr const& ea: a.args()) {
+			ref += ea*b;
+		}
+		simps::simplify(ref);
+		ret |= check_expr("expand_products", prod, ref);
+	}
+
+	return ret;
+}
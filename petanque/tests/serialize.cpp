@@ -0,0 +1,183 @@
+#include <pa/app.h>
+#include <pa/errors.h>
+#include <pa/matrix.h>
+#include <pa/serialize.h>
+#include <pa/symbols.h>
+#include <pa/vector.h>
+
+#include <cstdio>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static int check_invalid(const char* name, std::vector<uint8_t> const& data)
+{
+	try {
+		serialize::Reader r(data.data(), data.size());
+		r.to_vector();
+	}
+	catch (errors::InvalidFormat const&) {
+		return 0;
+	}
+	std::cerr << name << ": invalid data has been accepted" << std::endl;
+	return 1;
+}
+
+int main()
+{
+	int ret = 0;
+
+	Expr a = symbol("a");
+	Expr b = symbol("b");
+	Expr c = symbol("c");
+	Expr x0 = arg_symbol(0);
+	Expr x1 = arg_symbol(1);
+
+	{
+		Expr e = ExprAdd({a*b, ExprOr({a, c}), ExprESF(2, {a, b, c}), x0, ExprImm(1)});
+		std::vector<uint8_t> data = serialize::dump(e);
+		serialize::Reader r(data.data(), data.size());
+		ret |= check_expr("expr", r.to_expr(), e);
+		if (r.kind() != serialize::Kind::Expr || r.nsymbols() != 4) {
+			std::cerr << "invalid header" << std::endl;
+			ret = 1;
+		}
+	}
+
+	{
+		// Shared subexpressions are stored once
+		Expr s = ExprAdd({a*b*c, a|b});
+		Vector v{s, s*c, ExprMul({s, a}), ExprImm(0)};
+		std::vector<uint8_t> data = serialize::dump(v);
+		serialize::Reader r(data.data(), data.size());
+		if (r.to_vector() != v) {
+			std::cerr << "invalid vector" << std::endl;
+			ret = 1;
+		}
+		// a, b, c, a*b*c, a|b, s, s*c, s*a, 0
+		if (r.nnodes() != 9) {
+			std::cerr << "invalid number of nodes: " << r.nnodes() << std::endl;
+			ret = 1;
+		}
+		// Nodes can be walked without creating expressions
+		serialize::Reader::Node n = r.node(r.root(1));
+		if (n.type != expr_type_id::mul_type || n.nargs != 2 || r.arg(n, 0) != r.root(0)) {
+			std::cerr << "invalid node" << std::endl;
+			ret = 1;
+		}
+	}
+
+	{
+		Matrix M(2, 3, ExprImm(0));
+		M.at(0, 1) = a;
+		M.at(1, 2) = b+c;
+		std::vector<uint8_t> data = serialize::dump(M);
+		serialize::Reader r(data.data(), data.size());
+		if (r.to_matrix() != M) {
+			std::cerr << "invalid matrix" << std::endl;
+			ret = 1;
+		}
+
+		// Objects of another kind are rejected
+		try {
+			r.to_vector();
+			std::cerr << "a matrix has been loaded as a vector" << std::endl;
+			ret = 1;
+		}
+		catch (errors::InvalidFormat const&) {
+		}
+	}
+
+	{
+		Matrix M(2, 2, ExprImm(0));
+		M.at(0, 0) = ExprImm(1);
+		M.at(1, 0) = ExprImm(1);
+		M.at(1, 1) = ExprImm(1);
+		Vector V{ExprImm(1), ExprImm(0)};
+		Vector X{a, b};
+		App app(VectorApp(X, Vector{a*b, ExprImm(0)}), M, V);
+
+		const std::string path = "serialize_test.bin";
+		serialize::save(path, app);
+		App app2 = serialize::load_app(path);
+		if (app2.matrix() != app.matrix() || app2.cst() != app.cst() || app2.nl().vector() != app.nl().vector()) {
+			std::cerr << "invalid app" << std::endl;
+			ret = 1;
+		}
+
+		serialize::save(path, app.affine());
+		AffApp aff = serialize::load_affapp(path);
+		if (aff.matrix() != M || aff.cst() != V) {
+			std::cerr << "invalid affine app" << std::endl;
+			ret = 1;
+		}
+		remove(path.c_str());
+	}
+
+	{
+		Vector v{ExprAdd({a*b, x1}), a};
+		std::vector<uint8_t> data = serialize::dump(v);
+
+		std::vector<uint8_t> bad = data;
+		bad[0] = 'X';
+		ret |= check_invalid("magic", bad);
+
+		bad = data;
+		bad[4] = 2;
+		ret |= check_invalid("version", bad);
+
+		bad = data;
+		bad.resize(data.size()/2);
+		ret |= check_invalid("truncated", bad);
+
+		// Make the first node use itself as an argument
+		bad = data;
+		const size_t nodes = bad[40] | (bad[41] << 8);
+		const size_t args = bad[48] | (bad[49] << 8);
+		for (size_t i = 0; i < bad.size(); i += 16) {
+			if (nodes + i + 16 > args) {
+				break;
+			}
+			if (bad[nodes + i] == (uint8_t)expr_type_id::mul_type) {
+				const size_t first_arg = args + 4*bad[nodes + i + 8];
+				bad[first_arg] = i/16;
+				break;
+			}
+		}
+		ret |= check_invalid("cycle", bad);
+	}
+
+	{
+		Vector v{ExprESF(2, {a, b, c}), a};
+		std::vector<uint8_t> data = serialize::dump(v);
+
+		// Set the degree of the ESF node to 0, and then to more than its
+		// number of arguments
+		const size_t nodes = data[40] | (data[41] << 8);
+		const size_t args = data[48] | (data[49] << 8);
+		size_t esf = 0;
+		for (size_t i = nodes; i + 16 <= args; i += 16) {
+			if (data[i] == (uint8_t)expr_type_id::esf_type) {
+				esf = i;
+				break;
+			}
+		}
+		if (esf == 0) {
+			std::cerr << "ESF node not found" << std::endl;
+			ret = 1;
+		}
+		else {
+			std::vector<uint8_t> bad = data;
+			bad[esf + 4] = 0;
+			ret |= check_invalid("ESF degree 0", bad);
+
+			bad = data;
+			bad[esf + 4] = 4;
+			ret |= check_invalid("ESF degree > nargs", bad);
+		}
+	}
+
+	return ret;
+}
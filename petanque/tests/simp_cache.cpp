@@ -0,0 +1,131 @@
+#include <pa/cache.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static int check_stats(const char* name, simps::CacheStats const& s, uint64_t hits, uint64_t misses, uint64_t evictions, size_t size)
+{
+	if (s.hits != hits || s.misses != misses || s.evictions != evictions || s.size != size) {
+		std::cerr << name << ": bad " << s.name << " cache stats: " << s.hits << " hits, " << s.misses << " misses, " << s.evictions << " evictions, " << s.size << " entries" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	int ret = 0;
+
+	Expr a = symbol("a");
+	Expr b = symbol("b");
+	Expr c = symbol("c");
+
+	std::vector<Expr> exprs;
+	for (size_t i = 0; i < 6; i++) {
+		Expr s = symbol(("x" + std::to_string(i)).c_str());
+		exprs.push_back(ExprMul({ExprAdd({a, s}), ExprAdd({b, s, c})}));
+	}
+
+	// Disabled by default
+	{
+		Expr e = exprs[0];
+		simps::simplify(e);
+		ret |= check_stats("disabled", simps::caches_stats()[0], 0, 0, 0, 0);
+	}
+
+	simps::config().cache_size = 4;
+	for (size_t i = 0; i < 4; i++) {
+		Expr e = exprs[i];
+		simps::simplify(e);
+	}
+	ret |= check_stats("first simplifications", simps::caches_stats()[0], 0, 4, 0, 4);
+
+	// Cached results are the same as the simplified expressions
+	{
+		Expr ref = exprs[0];
+		simps::config().cache_size = 0;
+		simps::simplify(ref);
+		simps::config().cache_size = 4;
+
+		Expr e = exprs[0];
+		simps::simplify(e);
+		ret |= check_expr("cached simplification", e, ref);
+		ret |= check_stats("cached simplification", simps::caches_stats()[0], 1, 4, 0, 4);
+
+		// Simplifying an already simplified expression doesn't consult the
+		// cache
+		simps::simplify(e);
+		ret |= check_stats("simplified expression", simps::caches_stats()[0], 1, 4, 0, 4);
+	}
+
+	// exprs[1] is now the least recently used entry, and is evicted first
+	{
+		Expr e = exprs[4];
+		simps::simplify(e);
+		ret |= check_stats("eviction", simps::caches_stats()[0], 1, 5, 1, 4);
+		e = exprs[0];
+		simps::simplify(e);
+		ret |= check_stats("eviction", simps::caches_stats()[0], 2, 5, 1, 4);
+		e = exprs[1];
+		simps::simplify(e);
+		ret |= check_stats("eviction", simps::caches_stats()[0], 2, 6, 2, 4);
+	}
+
+	// Lowering the size evicts entries
+	simps::config().cache_size = 2;
+	{
+		Expr e = exprs[5];
+		simps::simplify(e);
+		ret |= check_stats("smaller cache", simps::caches_stats()[0], 2, 7, 5, 2);
+	}
+
+	// Changing the settings results depend on clears the caches
+	{
+		simps::config().identify_ors_max_candidates = 1;
+		Expr e = exprs[5];
+		simps::simplify(e);
+		ret |= check_stats("identify_ors_max_candidates", simps::caches_stats()[0], 0, 1, 0, 1);
+		simps::config().identify_ors_max_candidates = 0;
+		simps::config().truth_table_max_symbols = 0;
+		e = exprs[5];
+		simps::simplify(e);
+		ret |= check_stats("truth_table_max_symbols", simps::caches_stats()[0], 0, 1, 0, 1);
+		simps::config().truth_table_max_symbols = 20;
+	}
+
+	// ESFs expansions
+	{
+		Expr e = ExprESF(2, {a, b, c});
+		Expr ref = e;
+		simps::expand_esf(ref);
+		simps::expand_esf(e);
+		ret |= check_expr("cached expansion", e, ref);
+		ret |= check_stats("expand_esf", simps::caches_stats()[1], 1, 1, 0, 1);
+	}
+
+	simps::clear_caches();
+	ret |= check_stats("clear", simps::caches_stats()[0], 0, 0, 0, 0);
+	ret |= check_stats("clear", simps::caches_stats()[1], 0, 0, 0, 0);
+
+	// Structurally equal expressions share their entry
+	{
+		ExprCache cache(8);
+		cache.insert(ExprAdd({a, b}), a);
+		Expr out;
+		if (!cache.lookup(ExprAdd({b, a}), out) || !(out == a)) {
+			std::cerr << "a+b not found in the cache" << std::endl;
+			ret = 1;
+		}
+		if (cache.lookup(ExprOr({a, b}), out)) {
+			std::cerr << "a|b found in the cache" << std::endl;
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,88 @@
+#include <pa/simps.h>
+#include <pa/symbols.h>
+
+#include "tests.h"
+
+using namespace pa;
+
+int main()
+{
+	int ret = 0;
+
+	Expr a = symbol("a");
+	Expr b = symbol("b");
+	Expr c = symbol("c");
+	Expr d = symbol("d");
+
+	{
+		Expr e = ExprAdd({ExprMul({b, a}), ExprMul({d, c})});
+		if (e.is_normalized()) {
+			std::cerr << "new expression is normalized!" << std::endl;
+			ret = 1;
+		}
+		simps::simplify(e);
+		Expr const& ce = e;
+		if (!ce.is_normalized() || !ce.args()[0].is_normalized()) {
+			std::cerr << "simplified expression isn't normalized!" << std::endl;
+			ret = 1;
+		}
+		Expr cp = e;
+		if (!cp.is_normalized()) {
+			std::cerr << "copy of a normalized expression isn't normalized!" << std::endl;
+			ret = 1;
+		}
+		// Modifying an argument invalidates all its parents
+		e.args()[0] *= c;
+		if (ce.is_normalized()) {
+			std::cerr << "modified expression is still normalized!" << std::endl;
+			ret = 1;
+		}
+		simps::simplify(e);
+		ret |= check_expr("a*b*c + c*d", e, ExprAdd({ExprMul({a, b, c}), ExprMul({c, d})}));
+	}
+
+	{
+		// Only the modified parts of an already simplified expression are
+		// simplified again
+		Expr e = ExprAdd({ExprMul({a, b}), c});
+		simps::simplify(e);
+		e += ExprAdd({ExprMul({a, b}), d, ExprImm(0)});
+		simps::simplify(e);
+		ret |= check_expr("(a*b + c) + (a*b + d + 0)", e, ExprAdd({c, d}));
+	}
+
+	{
+		// Adder simplified after each operation, compared with the
+		// simplification of the whole expression
+		const size_t n = 6;
+		std::vector<Expr> X, Y;
+		for (size_t i = 0; i < n; i++) {
+			X.push_back(symbol((std::string("x") + std::to_string(i)).c_str()));
+			Y.push_back(symbol((std::string("y") + std::to_string(i)).c_str()));
+		}
+		Expr carry = ExprImm(0);
+		Expr carry_ref = ExprImm(0);
+		for (size_t i = 0; i < n; i++) {
+			Expr s = X[i] + Y[i];
+			simps::simplify(s);
+			s += carry;
+			simps::simplify(s);
+
+			Expr s_ref = ExprAdd({X[i], Y[i], carry_ref});
+			simps::simplify(s_ref);
+			ret |= check_expr("incremental sum", s, s_ref);
+
+			Expr t = carry * (X[i] + Y[i]);
+			simps::simplify(t);
+			carry = X[i] * Y[i];
+			simps::simplify(carry);
+			carry += t;
+			simps::simplify(carry);
+			carry_ref = ExprAdd({ExprMul({X[i], Y[i]}), ExprMul({carry_ref, ExprAdd({X[i], Y[i]})})});
+		}
+		simps::simplify(carry_ref);
+		ret |= check_expr("incremental carry", carry, carry_ref);
+	}
+
+	return ret;
+}
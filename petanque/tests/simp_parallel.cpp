@@ -0,0 +1,65 @@
+#include <pa/simps.h>
+#include <pa/symbols.h>
+#include <pa/vector.h>
+
+#include <limits>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static Vector symbolic_vector(size_t n, const char* prefix)
+{
+	Vector ret(n);
+	for (size_t i = 0; i < n; i++) {
+		ret[i] = symbol((std::string{prefix} + std::to_string(i)).c_str());
+	}
+	return ret;
+}
+
+// Unsimplified carry chain of an addition of x*y with z
+static Expr build(Vector const& x, Vector const& y, Vector const& z)
+{
+	Expr carry = ExprImm(0);
+	Expr ret;
+	for (size_t i = 0; i < x.size(); i++) {
+		Expr a = ExprMul({ExprAdd({x[i], ExprOr({y[i], z[i]})}), ExprAdd({y[i], z[(i+1)%z.size()]})});
+		ret = ExprAdd({a, z[i], carry});
+		carry = ExprAdd({ExprMul({a, z[i]}), ExprMul({carry, ExprAdd({a, z[i]})})});
+	}
+	return ExprAdd({ret, carry});
+}
+
+int main()
+{
+	int ret = 0;
+	Vector x = symbolic_vector(3, "x");
+	Vector y = symbolic_vector(3, "y");
+	Vector z = symbolic_vector(3, "z");
+
+	simps::Config& config = simps::config();
+	const simps::Config org = config;
+
+	Expr ref = build(x, y, z);
+	config.grain_size = std::numeric_limits<size_t>::max();
+	config.products_grain_size = std::numeric_limits<size_t>::max();
+	simps::simplify(ref);
+
+	// Force the parallel paths
+	config.nthreads = 2;
+	config.grain_size = 1;
+	config.products_grain_size = 1;
+	Expr e = build(x, y, z);
+	simps::simplify(e);
+	ret |= check_expr("parallel simplify", e, ref);
+
+	Expr exp = ExprMul({ExprAdd({x[0], x[1], ExprOr({x[2], z[0]})}), ExprAdd({y[0], y[1], y[2]})});
+	Expr exp_ref = exp;
+	simps::expand(exp);
+	config = org;
+	simps::expand(exp_ref);
+	ret |= check_expr("parallel expand", exp, exp_ref);
+
+	return ret;
+}
@@ -0,0 +1,84 @@
+#include <pa/config.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+
+#include "tests.h"
+
+#include <cstring>
+
+using namespace pa;
+
+int main()
+{
+#ifndef PA_SIMPS_STATS
+	return 0;
+#endif
+	int ret = 0;
+
+	Expr a = symbol("a");
+	Expr b = symbol("b");
+	Expr c = symbol("c");
+	Expr d = symbol("d");
+
+	simps::config().rules_stats = true;
+	simps::reset_rules_stats();
+
+	{
+		// ORs multiplied by an addition can't be expanded any further
+		Expr e = ExprMul({ExprOr({a, b}), ExprOr({a, b, c}), c, ExprAdd({a, d, ExprImm(1)}), ExprImm(1)});
+		simps::simplify(e);
+		ret |= check_expr("(a|b)*(a|b|c)*c*(a+d+1)*1", e,
+			ExprMul({ExprOr({a, b}), ExprOr({a, b, c}), ExprAdd({ExprMul({a, c}), ExprMul({c, d}), c})}));
+	}
+
+	{
+		// A node is only rewritten by the rules that apply to its type
+		Expr e = ExprAdd({ExprMul({a, ExprAdd({b, c})}), a, a});
+		simps::simplify(e);
+		ret |= check_expr("a*(b+c) + a + a", e, ExprAdd({ExprMul({a, b}), ExprMul({a, c})}));
+	}
+
+	{
+		Expr e = ExprOr({a, b, c});
+		simps::or_to_esf(e);
+	}
+
+	uint64_t rewrites = 0;
+	uint64_t time_ns = 0;
+	for (simps::RuleStats const& r: simps::rules_stats()) {
+		std::cerr << r.name << ": " << r.rewrites << "/" << r.attempts << ", " << r.time_ns << " ns, "
+			<< r.args_before << " -> " << r.args_after << " args (max " << r.max_args << ")" << std::endl;
+		if (r.rewrites > r.attempts) {
+			std::cerr << "more rewrites than attempts for " << r.name << std::endl;
+			ret = 1;
+		}
+		if (r.rewrites > 0 && r.max_args == 0) {
+			std::cerr << "no size recorded for " << r.name << std::endl;
+			ret = 1;
+		}
+		if (strcmp(r.name, "or_to_esf") == 0 && (r.rewrites != 1 || r.args_before != 3)) {
+			std::cerr << "bad or_to_esf stats" << std::endl;
+			ret = 1;
+		}
+		time_ns += r.time_ns;
+		if (strcmp(r.name, "constants_prop_sorted") == 0 && r.attempts != 0) {
+			std::cerr << "constants_prop_sorted tried on nodes without ESFs" << std::endl;
+			ret = 1;
+		}
+		rewrites += r.rewrites;
+	}
+	if (rewrites == 0 || time_ns == 0) {
+		std::cerr << "no rewrites counted" << std::endl;
+		ret = 1;
+	}
+
+	simps::reset_rules_stats();
+	for (simps::RuleStats const& r: simps::rules_stats()) {
+		if (r.attempts != 0 || r.rewrites != 0 || r.time_ns != 0 || r.max_args != 0) {
+			std::cerr << "stats not reset for " << r.name << std::endl;
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
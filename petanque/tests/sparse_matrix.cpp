@@ -0,0 +1,95 @@
+#include <pa/matrix.h>
+#include <pa/simps.h>
+#include <pa/sparse_matrix.h>
+#include <pa/symbols.h>
+
+#include <random>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static int check(const char* name, bool v)
+{
+	if (!v) {
+		std::cerr << "error: " << name << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+static Matrix simplified(Matrix m)
+{
+	simps::simplify(m);
+	return m;
+}
+
+static Vector simplified(Vector v)
+{
+	simps::simplify(v);
+	return v;
+}
+
+int main()
+{
+	int ret = 0;
+	std::mt19937 rng(0);
+
+	std::vector<Expr> syms;
+	for (size_t i = 0; i < 8; i++) {
+		syms.push_back(symbol(("x" + std::to_string(i)).c_str()));
+	}
+	// Mostly zero matrices, with some immediates and symbols
+	auto random_entry = [&]() -> Expr {
+		switch (rng() % 8) {
+			case 0:
+				return ExprImm(1);
+			case 1:
+				return syms[rng() % syms.size()];
+			default:
+				return ExprImm(0);
+		}
+	};
+	Matrix a = Matrix::construct(13, 20, [&](size_t, size_t) { return random_entry(); });
+	Matrix b = Matrix::construct(20, 13, [&](size_t, size_t) { return random_entry(); });
+	Matrix c = Matrix::construct(13, 20, [&](size_t, size_t) { return random_entry(); });
+	SparseMatrix sa(a);
+	SparseMatrix sb(b);
+	SparseMatrix sc(c);
+
+	ret |= check("conversion", sa.to_matrix() == a);
+	size_t nnz = 0;
+	for (Expr const& e: a) {
+		nnz += !(e == ExprImm(0));
+	}
+	ret |= check("nnz", sa.nnz() == nnz);
+	ret |= check("at", sa.at(3, 4) == a.at(3, 4) && sa.at(12, 19) == a.at(12, 19));
+	ret |= check("identity", SparseMatrix::identity(10).to_matrix() == Matrix::identity(10) && SparseMatrix::identity(10).nnz() == 10);
+
+	ret |= check("sum", simplified((sa + sc).to_matrix()) == simplified(a + c));
+	ret |= check("sum with itself", (sa + sa).nnz() == 0);
+
+	// Matrix::operator* requires square matrices
+	Matrix a_sq = Matrix::construct(20, 20, [&](size_t, size_t) { return random_entry(); });
+	Matrix b_sq = Matrix::construct(20, 20, [&](size_t, size_t) { return random_entry(); });
+	ret |= check("product", simplified((SparseMatrix(a_sq)*SparseMatrix(b_sq)).to_matrix()) == simplified(a_sq*b_sq));
+	{
+		Matrix ref = Matrix::construct(13, 13, [&](size_t i, size_t j) {
+			Expr e = ExprImm(0);
+			for (size_t k = 0; k < 20; k++) {
+				e += a.at(i, k)*b.at(k, j);
+			}
+			return e;
+		});
+		ret |= check("rectangular product", simplified((sa*sb).to_matrix()) == simplified(ref));
+	}
+
+	Vector X(20);
+	for (size_t i = 0; i < X.size(); i++) {
+		X[i] = symbol(("y" + std::to_string(i)).c_str());
+	}
+	ret |= check("product with a vector", simplified(sa*X) == simplified(a*X));
+
+	return ret;
+}
@@ -62,3 +62,43 @@ int check_name(pa::Expr const& e, const char* name)
 	}
 	return 0;
 }
+
+pa::Expr random_expr(std::mt19937& rng, pa::Vector const& syms, unsigned depth)
+{
+	if (depth == 0 || rng()%4 == 0) {
+		if (rng()%8 == 0) {
+			return pa::ExprImm(rng()&1);
+		}
+		return syms[rng()%syms.size()];
+	}
+	const size_t nargs = 1 + rng()%4;
+	std::vector<pa::Expr> args;
+	for (size_t i = 0; i < nargs; i++) {
+		args.push_back(random_expr(rng, syms, depth-1));
+	}
+	switch (rng()%4) {
+		case 0:
+			return pa::ExprAdd(args.begin(), args.end());
+		case 1:
+			return pa::ExprMul(args.begin(), args.end());
+		case 2:
+			return pa::ExprOr(args.begin(), args.end());
+		default:
+			return pa::ExprESF(1 + rng()%nargs, args.begin(), args.end());
+	}
+}
+
+pa::Expr random_anf(std::mt19937& rng, std::vector<pa::Expr> const& syms, size_t nmonos, size_t max_degree)
+{
+	pa::Expr ret = pa::ExprImm(0);
+	for (size_t i = 0; i < nmonos; i++) {
+		const size_t degree = rng()%(max_degree+1);
+		pa::Expr m = pa::ExprImm(1);
+		for (size_t j = 0; j < degree; j++) {
+			m = m*syms[rng()%syms.size()];
+		}
+		ret = ret + m;
+	}
+	pa::simps::simplify(ret);
+	return ret;
+}
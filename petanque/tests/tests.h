@@ -3,14 +3,25 @@
 
 #include <iostream>
 #include <functional>
+#include <random>
+#include <vector>
 
 #include <pa/exprs.h>
+#include <pa/vector.h>
 
 int check_expr(pa::Expr const& e_, pa::Expr const& ref, std::function<void(pa::Expr&)> const& F);
 int check_expr(const char* expr, pa::Expr const& v, pa::Expr const& ref);
 int check_imm(pa::Expr const& e, bool v);
 int check_name(pa::Expr const& e, const char* name);
 
+// Random expression of at most depth levels of ADD, MUL, OR and ESF nodes,
+// whose leaves are immediates or elements of syms
+pa::Expr random_expr(std::mt19937& rng, pa::Vector const& syms, unsigned depth);
+
+// Random simplified ANF made of nmonos monomials (before cancellation) of at
+// most max_degree elements of syms
+pa::Expr random_anf(std::mt19937& rng, std::vector<pa::Expr> const& syms, size_t nmonos, size_t max_degree);
+
 template <class E>
 static int check_type(pa::Expr const& e)
 {
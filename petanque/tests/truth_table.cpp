@@ -0,0 +1,90 @@
+#include <pa/anf.h>
+#include <pa/simps.h>
+#include <pa/symbols.h>
+
+#include <random>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static int check_tt(const char* name, Expr const& e, Expr const& ref)
+{
+	ANF anf;
+	if (!ANF::from_expr_truth_table(e, anf, 20)) {
+		std::cerr << name << ": support is too large" << std::endl;
+		return 1;
+	}
+	return check_expr(name, anf.to_expr(), ref);
+}
+
+int main()
+{
+	int ret = 0;
+
+	Expr a = symbol("a");
+	Expr b = symbol("b");
+	Expr c = symbol("c");
+
+	ret |= check_tt("0", ExprImm(0), ExprImm(0));
+	ret |= check_tt("1", ExprImm(1), ExprImm(1));
+	ret |= check_tt("a", a, a);
+	ret |= check_tt("a|b", ExprOr({a, b}), ExprAdd({a*b, a, b}));
+	ret |= check_tt("ESF(2, a, b, c)", ExprESF(2, {a, b, c}), ExprAdd({a*b, a*c, b*c}));
+	ret |= check_tt("(a+b)*(a+c)+1", ExprAdd({ExprMul({ExprAdd({a, b}), ExprAdd({a, c})}), ExprImm(1)}),
+		ExprAdd({a*b, a*c, b*c, a, ExprImm(1)}));
+
+	{
+		ANF anf;
+		if (ANF::from_expr_truth_table(ExprAdd({a, b, c}), anf, 2)) {
+			std::cerr << "truth table computed with too many symbols" << std::endl;
+			ret = 1;
+		}
+	}
+
+	// Products expanded from their truth tables against the dense ANF
+	// multiplication, with tables smaller than, equal to and larger than a
+	// word
+	std::mt19937 rng(0x7a7a);
+	for (size_t nsyms: {3, 6, 12}) {
+		std::vector<Expr> syms;
+		for (size_t i = 0; i < nsyms; i++) {
+			syms.emplace_back(symbol(("x" + std::to_string(i)).c_str()));
+		}
+		for (size_t t = 0; t < 10; t++) {
+			Expr ea = random_anf(rng, syms, 1 + rng()%40, 3);
+			Expr eb = random_anf(rng, syms, 1 + rng()%40, 3);
+			ANF fa, fb;
+			ANF::from_expr(ea, fa);
+			ANF::from_expr(eb, fb);
+			ret |= check_tt("product", ExprMul({ea, eb}), (fa*fb).to_expr());
+
+			// simplify picks the truth table if it is cheaper
+			Expr prod = ExprMul({ea, eb});
+			simps::simplify(prod);
+			ret |= check_expr("simplified product", prod, (fa*fb).to_expr());
+		}
+	}
+
+	{
+		// Large enough for simplify to use the truth table
+		std::vector<Expr> syms;
+		for (size_t i = 0; i < 8; i++) {
+			syms.emplace_back(symbol(("y" + std::to_string(i)).c_str()));
+		}
+		Expr ea = random_anf(rng, syms, 100, 4);
+		Expr eb = random_anf(rng, syms, 100, 4);
+		Expr ec = random_anf(rng, syms, 100, 4);
+		Expr prod = ExprMul({ea, eb, ec});
+		Expr prod_ref = prod;
+		simps::simplify(prod);
+		const size_t max_syms = simps::config().truth_table_max_symbols;
+		simps::config().truth_table_max_symbols = 0;
+		simps::simplify(prod_ref);
+		simps::config().truth_table_max_symbols = max_syms;
+		ret |= check_expr("product of three additions", prod, prod_ref);
+	}
+
+	return ret;
+}
@@ -0,0 +1,121 @@
+#include <pa/errors.h>
+#include <pa/symbols.h>
+#include <pa/vector.h>
+#include <pa/vector_view.h>
+
+#include <algorithm>
+#include <string>
+
+#include "tests.h"
+
+using namespace pa;
+
+static int check(const char* name, bool v)
+{
+	if (!v) {
+		std::cerr << "error: " << name << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	int ret = 0;
+
+	const size_t n = 8;
+	Vector v(n);
+	for (size_t i = 0; i < n; i++) {
+		v[i] = symbol(("x" + std::to_string(i)).c_str()) * symbol(("y" + std::to_string(i)).c_str());
+	}
+
+	for (size_t s = 0; s <= n+1; s++) {
+		Vector ref_l(n);
+		Vector ref_r(n);
+		Vector ref_rol(n);
+		Vector ref_ror(n);
+		for (size_t i = 0; i < n; i++) {
+			if (i+s < n) {
+				ref_l[i] = v[i+s];
+			}
+			if (i >= s) {
+				ref_r[i] = v[i-s];
+			}
+			ref_rol[i] = v[(i+s)%n];
+			ref_ror[i] = v[(i+n-s%n)%n];
+		}
+		ret |= check("shift_left", VectorView::shift_left(v, s) == ref_l);
+		ret |= check("shift_right", VectorView::shift_right(v, s) == ref_r);
+		ret |= check("operator<<", (v << s) == ref_l);
+		ret |= check("operator>>", (v >> s) == ref_r);
+		ret |= check("rotate_left", VectorView::rotate_left(v, s) == ref_rol);
+		ret |= check("rotate_right", VectorView::rotate_right(v, s) == ref_ror);
+	}
+
+	// Extensions
+	{
+		Vector sext = VectorView::extend(v, 12, v[n-1]);
+		ret |= check("sext size", sext.size() == 12);
+		for (size_t i = 0; i < 12; i++) {
+			ret |= check_expr("sext", sext[i], v[std::min(i, n-1)]);
+		}
+		VectorView trunc = VectorView::extend(v, 3);
+		ret |= check("truncation", trunc.to_vector() == Vector{v[0], v[1], v[2]});
+	}
+
+	// Slices
+	{
+		VectorView s = VectorView::slice(v, 1, 3, 2);
+		ret |= check("slice", s == Vector{v[1], v[3], v[5]});
+		VectorView r = VectorView::slice(v, n-1, n, -1);
+		for (size_t i = 0; i < n; i++) {
+			ret |= check_expr("reversed slice", r[i], v[n-1-i]);
+		}
+		bool thrown = false;
+		try {
+			VectorView::slice(v, 6, 3);
+		}
+		catch (errors::SizeMismatch const&) {
+			thrown = true;
+		}
+		ret |= check("out of bounds slice", thrown);
+	}
+
+	// Reads don't copy, writes copy the elements and leave the viewed vector
+	// untouched
+	{
+		const Vector ref = v;
+		VectorView view = VectorView::shift_right(v, 2);
+		VectorView const& cview = view;
+		ret |= check("shared element", &cview[3] == &v[1]);
+		ret |= check("not copied", !view.copied());
+		view[3] = ExprImm(1);
+		view[0] += symbol("a");
+		ret |= check("copied", view.copied());
+		ret |= check("viewed vector", v == ref);
+		Vector expected = v >> 2;
+		expected[3] = ExprImm(1);
+		expected[0] = symbol("a");
+		ret |= check("written view", view == expected);
+
+		// Copies of a written view own their elements
+		VectorView view2 = view;
+		view2[1] = ExprImm(1);
+		ret |= check("copy of a written view", view == expected);
+	}
+
+	// Arithmetic on views
+	{
+		Expr a = symbol("a");
+		Vector prod = VectorView::shift_right(v, 3) * a;
+		Vector sum = VectorView::rotate_left(v, 1) + v;
+		for (size_t i = 0; i < n; i++) {
+			ret |= check_expr("view*expr", prod[i], (i < 3) ? Expr(ExprImm(0)) : v[i-3]*a);
+			ret |= check_expr("view+vector", sum[i], v[(i+1)%n] + v[i]);
+		}
+		const Vector conv = VectorView::rotate_right(v, 1);
+		ret |= check("conversion", conv == Vector(VectorView::rotate_left(v, n-1)));
+	}
+
+	return ret;
+}
@@ -69,6 +69,27 @@ int main()
 		ret = 1;
 	}
 
+	{
+		analyses::VectorialDecomp decomp = analyses::vectorial_decomp_bits(X, F);
+		if (decomp.matrix.to_matrix() != mref || decomp.cst != vref) {
+			std::cerr << "invalid packed decomposition!" << std::endl;
+			ret = 1;
+		}
+		Vector nl = decomp.nl;
+		if (nl[4] != a*b || nl[5] != ExprMul({a, b, c, d})) {
+			std::cerr << "invalid non linear part of the packed decomposition!" << std::endl;
+			ret = 1;
+		}
+	}
+
+	try {
+		analyses::vectorial_decomp(Vector{{a, b}}, F);
+		std::cerr << "unknown symbols not detected" << std::endl;
+		ret = 1;
+	}
+	catch (analyses::UnknownSymbol const&) {
+	}
+
 	Vector test = app(X);
 	simps::simplify(test);
 	if (test != F) {
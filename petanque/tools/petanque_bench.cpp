@@ -0,0 +1,517 @@
+// Copyright (c) 2016 Adrien Guinet <adrien@guinet.me>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Micro-benchmarks of the petanque kernels.
+//
+// Each benchmark is run on inputs of several widths (number of bits of the
+// symbolic variables involved), and reports its wall time, the number and
+// size of the allocations done and the peak resident memory as JSON.
+//
+// Usage: petanque_bench [--filter substring] [--widths 8,16,...] [--reps n]
+//                       [--seed n] [--out file.json] [--list]
+
+#include <pa/analyses.h>
+#include <pa/exprs.h>
+#include <pa/matrix.h>
+#include <pa/simps.h>
+#include <pa/subs.h>
+#include <pa/symbols.h>
+#include <pa/vector.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Allocation counters, updated by the global allocation functions below
+static std::atomic<uint64_t> g_nallocs{0};
+static std::atomic<uint64_t> g_alloc_bytes{0};
+
+static void* counted_alloc(size_t size)
+{
+	g_nallocs.fetch_add(1, std::memory_order_relaxed);
+	g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+	void* ret = malloc(size == 0 ? 1 : size);
+	if (ret == nullptr) {
+		throw std::bad_alloc{};
+	}
+	return ret;
+}
+
+void* operator new(size_t size) { return counted_alloc(size); }
+void* operator new[](size_t size) { return counted_alloc(size); }
+void* operator new(size_t size, std::nothrow_t const&) noexcept
+{
+	try {
+		return counted_alloc(size);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+void* operator new[](size_t size, std::nothrow_t const& nt) noexcept { return operator new(size, nt); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::nothrow_t const&) noexcept { free(p); }
+void operator delete[](void* p, std::nothrow_t const&) noexcept { free(p); }
+
+namespace {
+
+using namespace pa;
+
+// Peak resident memory, in KB. On Linux, the peak can be reset so that it is
+// measured for each benchmark.
+void reset_peak_rss()
+{
+#ifdef __linux__
+	std::ofstream f("/proc/self/clear_refs");
+	f << "5";
+#endif
+}
+
+uint64_t peak_rss_kb()
+{
+#ifdef __linux__
+	std::ifstream f("/proc/self/status");
+	std::string line;
+	while (std::getline(f, line)) {
+		if (line.compare(0, 6, "VmHWM:") == 0) {
+			return strtoull(line.c_str() + 6, nullptr, 10);
+		}
+	}
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+	return ru.ru_maxrss/1024;
+#else
+	return ru.ru_maxrss;
+#endif
+#else
+	return 0;
+#endif
+}
+
+// Inputs
+
+Vector symbolic_vector(const char* prefix, size_t n)
+{
+	Vector ret(n);
+	for (size_t i = 0; i < n; i++) {
+		ret[i] = symbol((std::string{prefix} + std::to_string(i)).c_str());
+	}
+	return ret;
+}
+
+struct Inputs
+{
+	Inputs(size_t n):
+		X(symbolic_vector("x", n)),
+		Y(symbolic_vector("y", n))
+	{ }
+
+	Vector X;
+	Vector Y;
+};
+
+// Binary tree of additions of the terms in [begin, end), to be flattened
+Expr nested_add(std::vector<Expr> const& terms, size_t begin, size_t end)
+{
+	if (end - begin == 1) {
+		return terms[begin];
+	}
+	const size_t mid = begin + (end-begin)/2;
+	return ExprAdd({nested_add(terms, begin, mid), nested_add(terms, mid, end)});
+}
+
+// Unsimplified expression mixing all the kinds of operations, with
+// constants, duplicated arguments and nested operations of the same kind
+Expr mixed_expr(Inputs const& in, std::mt19937& rng)
+{
+	Vector const& X = in.X;
+	Vector const& Y = in.Y;
+	const size_t n = X.size();
+	std::vector<Expr> terms;
+	for (size_t i = 0; i < n; i++) {
+		const size_t j = rng()%n;
+		const size_t k = rng()%n;
+		switch (i % 4) {
+			case 0:
+				terms.push_back(ExprMul({ExprAdd({X[i], Y[j], ExprImm(1)}), ExprOr({X[k], Y[i]})}));
+				break;
+			case 1:
+				terms.push_back(ExprMul({X[i], ExprImm(1), ExprAdd({Y[j], Y[j], X[k]})}));
+				break;
+			case 2:
+				terms.push_back(ExprAdd({ExprMul({X[i], Y[j]}), ExprMul({X[i], ExprImm(0)}), ExprESF(2, {X[i], Y[j], X[k]})}));
+				break;
+			default:
+				terms.push_back(ExprOr({ExprMul({X[i], Y[i]}), ExprAdd({X[j], ExprImm(0)})}));
+				break;
+		};
+	}
+	return nested_add(terms, 0, terms.size());
+}
+
+Expr sum(Vector const& v, size_t n)
+{
+	return ExprAdd(v.begin(), v.begin() + std::min(n, v.size()));
+}
+
+// Carry-propagation form of X+Y, without simplification
+Vector adder(Inputs const& in)
+{
+	Vector const& X = in.X;
+	Vector const& Y = in.Y;
+	Vector ret(X.size());
+	Expr carry = ExprImm(0);
+	for (size_t i = 0; i < X.size(); i++) {
+		ret[i] = ExprAdd({X[i], Y[i], carry});
+		carry = ExprAdd({ExprMul({X[i], Y[i]}), ExprMul({carry, ExprAdd({X[i], Y[i]})})});
+	}
+	return ret;
+}
+
+// Random invertible n*n matrix of immediates, as the product of random unit
+// lower and upper triangular matrices
+Matrix invertible_matrix(size_t n, std::mt19937& rng)
+{
+	std::vector<uint8_t> L(n*n, 0);
+	std::vector<uint8_t> U(n*n, 0);
+	for (size_t i = 0; i < n; i++) {
+		L[i*n+i] = U[i*n+i] = 1;
+		for (size_t j = 0; j < i; j++) {
+			L[i*n+j] = rng()&1;
+			U[j*n+i] = rng()&1;
+		}
+	}
+	return Matrix::construct(n, n,
+		[&](size_t i, size_t j) {
+			uint8_t v = 0;
+			for (size_t k = 0; k < n; k++) {
+				v ^= L[i*n+k] & U[k*n+j];
+			}
+			return ExprImm(v);
+		});
+}
+
+// Benchmarks
+
+typedef std::function<void()> bench_run;
+typedef std::function<bench_run(Inputs const&, std::mt19937&)> bench_prepare;
+
+struct Bench
+{
+	const char* name;
+	// Creates the inputs of one run, and returns the function to time
+	bench_prepare prepare;
+};
+
+template <class F>
+bench_prepare simp_pass(F const& pass)
+{
+	return [pass](Inputs const& in, std::mt19937& rng) -> bench_run {
+		auto e = std::make_shared<Expr>(mixed_expr(in, rng));
+		return [e, pass]() { pass(*e); };
+	};
+}
+
+std::vector<Bench> const& benchs()
+{
+	static const std::vector<Bench> ret = {
+		{"ops.add", [](Inputs const& in, std::mt19937&) -> bench_run {
+			return [&in]() {
+				Expr acc = ExprImm(0);
+				for (size_t i = 0; i < in.X.size(); i++) {
+					acc += in.X[i]*in.Y[i];
+					acc += in.X[i];
+				}
+			};
+		}},
+		{"ops.mul", [](Inputs const& in, std::mt19937&) -> bench_run {
+			return [&in]() {
+				Expr acc = ExprImm(1);
+				for (size_t i = 0; i < in.X.size(); i++) {
+					acc *= in.X[i] + in.Y[i];
+				}
+			};
+		}},
+		{"ops.or", [](Inputs const& in, std::mt19937&) -> bench_run {
+			return [&in]() {
+				Expr acc = ExprImm(0);
+				for (size_t i = 0; i < in.X.size(); i++) {
+					acc |= in.X[i]*in.Y[i];
+				}
+			};
+		}},
+		{"simps.flatten", simp_pass([](Expr& e) { simps::flatten(e); })},
+		{"simps.constants_prop", simp_pass([](Expr& e) { simps::constants_prop(e); })},
+		{"simps.remove_dead_ops", simp_pass([](Expr& e) { simps::remove_dead_ops(e); })},
+		{"simps.sort", simp_pass([](Expr& e) { simps::sort(e); })},
+		{"simps.expand_esf", simp_pass([](Expr& e) { simps::expand_esf(e); })},
+		{"simps.simplify", simp_pass([](Expr& e) { simps::simplify(e); })},
+		{"simps.incremental", [](Inputs const& in, std::mt19937&) -> bench_run {
+			// Expression simplified after each operation, as done by arybo's
+			// "always simplify" mode
+			return [&in]() {
+				const size_t n = in.X.size();
+				Expr acc = ExprImm(0);
+				for (size_t i = 0; i < n; i++) {
+					Expr t = in.X[i] * (in.Y[i] + in.X[(i+1)%n]);
+					simps::simplify(t);
+					acc += t;
+					simps::simplify(acc);
+					acc += in.Y[(i+2)%n];
+					simps::simplify(acc);
+				}
+			};
+		}},
+		{"simps.expand", [](Inputs const& in, std::mt19937&) -> bench_run {
+			auto e = std::make_shared<Expr>(ExprAdd({
+				ExprMul({sum(in.X, in.X.size()), sum(in.Y, in.Y.size())}),
+				ExprMul({sum(in.X, 8), sum(in.Y, 8), sum(in.X, in.X.size())})}));
+			return [e]() { simps::expand(*e); };
+		}},
+		{"simps.identify_ors", [](Inputs const& in, std::mt19937&) -> bench_run {
+			// Expanded forms of x_i|y_i
+			const size_t n = in.X.size();
+			std::vector<Expr> terms;
+			for (size_t i = 0; i < n; i++) {
+				terms.push_back(ExprMul({in.X[(i+1)%n], ExprAdd({in.X[i], in.Y[i], ExprMul({in.X[i], in.Y[i]})})}));
+			}
+			auto e = std::make_shared<Expr>(ExprAdd(terms.begin(), terms.end()));
+			return [e]() { simps::identify_ors(*e); };
+		}},
+		{"simps.or_to_esf", [](Inputs const& in, std::mt19937&) -> bench_run {
+			auto e = std::make_shared<Expr>(ExprOr(in.X.begin(), in.X.end()));
+			return [e]() { simps::or_to_esf(*e); };
+		}},
+		{"esf.expand", [](Inputs const& in, std::mt19937&) -> bench_run {
+			std::vector<Expr> args(in.X.begin(), in.X.end());
+			args.insert(args.end(), in.Y.begin(), in.Y.end());
+			auto e = std::make_shared<Expr>(ExprESF(2, args.begin(), args.end()));
+			return [e]() { e->as<ExprESF>().expand(); };
+		}},
+		{"matrix.T_fact", [](Inputs const& in, std::mt19937& rng) -> bench_run {
+			auto M = std::make_shared<Matrix>(invertible_matrix(in.X.size(), rng));
+			return [M]() {
+				Matrix T, U;
+				std::vector<size_t> perm;
+				M->T_fact(T, U, perm);
+			};
+		}},
+		{"matrix.inverse", [](Inputs const& in, std::mt19937& rng) -> bench_run {
+			auto M = std::make_shared<Matrix>(invertible_matrix(in.X.size(), rng));
+			return [M]() { M->inverse(); };
+		}},
+		{"subs.bits", [](Inputs const& in, std::mt19937& rng) -> bench_run {
+			auto v = std::make_shared<Vector>(adder(in));
+			auto values = std::make_shared<std::vector<bool>>(in.X.size());
+			for (size_t i = 0; i < values->size(); i++) {
+				(*values)[i] = rng()&1;
+			}
+			return [&in, v, values]() { subs(*v, in.X, *values); };
+		}},
+		{"subs.exprs", [](Inputs const& in, std::mt19937&) -> bench_run {
+			auto v = std::make_shared<Vector>(adder(in));
+			auto map = std::make_shared<std::map<Expr, Expr>>();
+			for (size_t i = 0; i < in.X.size(); i++) {
+				map->insert(std::make_pair(in.X[i], in.X[i]*in.Y[i]));
+			}
+			return [v, map]() { subs_exprs(*v, *map); };
+		}},
+		{"analyses.vectorial_decomp", [](Inputs const& in, std::mt19937& rng) -> bench_run {
+			const size_t n = in.X.size();
+			auto v = std::make_shared<Vector>(n);
+			for (size_t i = 0; i < n; i++) {
+				(*v)[i] = ExprAdd({in.X[i], in.X[(i+1)%n], in.X[i]*in.X[rng()%n], ExprImm(rng()&1)});
+				simps::simplify((*v)[i]);
+			}
+			return [&in, v]() { analyses::vectorial_decomp(in.X, *v); };
+		}},
+	};
+	return ret;
+}
+
+struct Result
+{
+	std::string name;
+	size_t width;
+	std::vector<double> times_ns;
+	uint64_t nallocs;
+	uint64_t alloc_bytes;
+	uint64_t peak_rss_kb;
+};
+
+Result run(Bench const& b, size_t width, unsigned reps, unsigned seed)
+{
+	Result ret;
+	ret.name = b.name;
+	ret.width = width;
+	Inputs in(width);
+	std::mt19937 rng(seed);
+	for (unsigned r = 0; r < reps; r++) {
+		bench_run f = b.prepare(in, rng);
+		reset_peak_rss();
+		const uint64_t nallocs = g_nallocs.load();
+		const uint64_t alloc_bytes = g_alloc_bytes.load();
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		ret.times_ns.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+		ret.nallocs = g_nallocs.load() - nallocs;
+		ret.alloc_bytes = g_alloc_bytes.load() - alloc_bytes;
+		ret.peak_rss_kb = peak_rss_kb();
+	}
+	return ret;
+}
+
+void write_json(std::ostream& os, std::vector<Result> const& results, unsigned reps, unsigned seed)
+{
+	os << "{\n  \"reps\": " << reps << ",\n  \"seed\": " << seed << ",\n  \"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); i++) {
+		Result const& r = results[i];
+		std::vector<double> t = r.times_ns;
+		std::sort(t.begin(), t.end());
+		double mean = 0;
+		for (double v: t) {
+			mean += v;
+		}
+		mean /= t.size();
+		os << (i == 0 ? "\n" : ",\n");
+		os << "    {\"name\": \"" << r.name << "\", \"width\": " << r.width
+		   << ", \"time_ns\": {\"min\": " << (uint64_t)t.front()
+		   << ", \"median\": " << (uint64_t)t[t.size()/2]
+		   << ", \"mean\": " << (uint64_t)mean
+		   << ", \"max\": " << (uint64_t)t.back()
+		   << "}, \"allocations\": " << r.nallocs
+		   << ", \"allocated_bytes\": " << r.alloc_bytes
+		   << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}";
+	}
+	os << "\n  ]\n}\n";
+}
+
+void usage(const char* prog)
+{
+	std::cerr << "Usage: " << prog << " [--filter substring] [--widths 8,16,...] [--reps n] [--seed n] [--out file.json] [--list]" << std::endl;
+}
+
+} // anonymous
+
+int main(int argc, char** argv)
+{
+	std::string filter;
+	std::vector<size_t> widths = {8, 16, 32, 64, 128};
+	unsigned reps = 5;
+	unsigned seed = 0;
+	std::string out;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		if (arg == "--list") {
+			for (Bench const& b: benchs()) {
+				std::cout << b.name << std::endl;
+			}
+			return 0;
+		}
+		if (i+1 >= argc) {
+			usage(argv[0]);
+			return 1;
+		}
+		const char* value = argv[++i];
+		if (arg == "--filter") {
+			filter = value;
+		}
+		else
+		if (arg == "--widths") {
+			widths.clear();
+			std::stringstream ss(value);
+			std::string w;
+			while (std::getline(ss, w, ',')) {
+				widths.push_back(strtoull(w.c_str(), nullptr, 10));
+			}
+		}
+		else
+		if (arg == "--reps") {
+			reps = std::max(1, atoi(value));
+		}
+		else
+		if (arg == "--seed") {
+			seed = strtoul(value, nullptr, 10);
+		}
+		else
+		if (arg == "--out") {
+			out = value;
+		}
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+	for (Bench const& b: benchs()) {
+		if (!filter.empty() && strstr(b.name, filter.c_str()) == nullptr) {
+			continue;
+		}
+		for (size_t w: widths) {
+			if (w == 0) {
+				continue;
+			}
+			std::cerr << b.name << " (" << w << " bits)..." << std::endl;
+			results.push_back(run(b, w, reps, seed));
+		}
+	}
+
+	if (out.empty()) {
+		write_json(std::cout, results, reps, seed);
+	}
+	else {
+		std::ofstream f(out);
+		if (!f) {
+			std::cerr << "unable to open " << out << std::endl;
+			return 1;
+		}
+		write_json(f, results, reps, seed);
+	}
+	return 0;
+}
@@ -0,0 +1,37 @@
+import threading
+import unittest
+
+from pytanque import symbol, simplify, Budget, BudgetScope, BudgetExceeded
+
+class BudgetTest(unittest.TestCase):
+    def setUp(self):
+        self.syms = [symbol("x%d" % i) for i in range(12)]
+        a = self.syms[0]+self.syms[1]+self.syms[2]
+        b = self.syms[3]+self.syms[4]+self.syms[5]
+        self.e = a*b
+
+    def test_scope(self):
+        budget = Budget()
+        budget.cancel()
+        with BudgetScope(budget):
+            self.assertRaises(BudgetExceeded, simplify, self.e)
+            with BudgetScope(None):
+                simplify(self.e)
+        simplify(self.e)
+
+    def test_threads(self):
+        # A budget cancelled in a thread does not affect the others
+        budget = Budget()
+        budget.cancel()
+        results = []
+        def run():
+            results.append(simplify(self.e))
+        with BudgetScope(budget):
+            t = threading.Thread(target=run)
+            t.start()
+            t.join()
+            self.assertRaises(BudgetExceeded, simplify, self.e)
+        self.assertEqual(results, [simplify(self.e)])
+
+if __name__ == "__main__":
+    unittest.main()
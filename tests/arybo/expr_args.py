@@ -0,0 +1,37 @@
+import unittest
+
+from pytanque import symbol, simplify, simplify_inplace
+
+class ExprArgsTest(unittest.TestCase):
+    def setUp(self):
+        self.a = symbol("a")
+        self.b = symbol("b")
+        self.c = symbol("c")
+        self.d = symbol("d")
+
+    def mutate_after_simplify(self, simp):
+        a,b,c,d = self.a,self.b,self.c,self.d
+        e = a*b + c
+        simplify_inplace(e)
+
+        # Arguments are returned as a reference, kept across a simplification
+        # and modified afterwards
+        args = e.args()
+        simplify_inplace(e)
+        child = args[0]
+        child += d
+        self.assertNotEqual(e, simplify(a*b + c))
+        return simp(e)
+
+    def test_simplify_inplace(self):
+        a,b,c,d = self.a,self.b,self.c,self.d
+        e = self.mutate_after_simplify(lambda e: simplify_inplace(e))
+        self.assertEqual(e, simplify(a*b + c + d))
+
+    def test_simplify(self):
+        a,b,c,d = self.a,self.b,self.c,self.d
+        e = self.mutate_after_simplify(lambda e: simplify(e))
+        self.assertEqual(e, simplify(a*b + c + d))
+
+if __name__ == "__main__":
+    unittest.main()
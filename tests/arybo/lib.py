@@ -1,5 +1,6 @@
 from arybo.lib import MBA
 from arybo.lib import MBATester
+from pytanque import Matrix, imm
 
 import unittest
 
@@ -10,5 +11,34 @@ class Lib(unittest.TestCase):
         ret = mba_tester.test_all()
         self.assertTrue(ret)
 
+    def test_matrices(self):
+        mba = MBA(8)
+        X = mba.var_symbols('X')
+        for M in (mba.identity(), mba.null_matrix(), mba.cst_matrix(imm(1)), mba.phi_X(X), mba.add_n_matrix(5)):
+            self.assertIsInstance(M, Matrix)
+            self.assertEqual((M.nlines(), M.ncols()), (8, 8))
+
+    def test_wide_cst(self):
+        mba = MBA(128)
+        mask = (1<<128)-1
+        C = (0xDEADBEEF << 64) | 0x1234
+        x = (0xCAFE << 96) | (5 << 64) | 0xFFFFFFFFFFFFFFFF
+        self.assertEqual(mba.from_cst(C).to_cst(), C)
+        # Symbolic carries over 128 bits are too expensive to evaluate: check
+        # the arithmetic operations on a constant operand
+        for use_esf in (False, True):
+            mba.use_esf = use_esf
+            X = mba.from_cst(x)
+            self.assertEqual((X+C).to_cst(), (x+C) & mask)
+            self.assertEqual((X-C).to_cst(), (x-C) & mask)
+            self.assertEqual((X*C).to_cst(), (x*C) & mask)
+        mba.use_esf = False
+        self.assertEqual((mba.from_cst(x)/C).to_cst(), x//C)
+        X = mba.var('X')
+        self.assertEqual((X&C).eval({X: x}), x&C)
+        self.assertEqual((X^C).eval({X: x}), x^C)
+        self.assertEqual((X|C).eval({X: x}), x|C)
+        self.assertEqual((X+(1<<100)).eval({X: x}), (x+(1<<100)) & mask)
+
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,38 @@
+import unittest
+
+from pytanque import Vector, VectorView, symbol, imm
+
+class VectorViewTest(unittest.TestCase):
+    def setUp(self):
+        self.v = Vector(4)
+        for i in range(4):
+            self.v[i] = symbol("x%d" % i)
+
+    def test_iter(self):
+        views = (
+            VectorView.shift_left(self.v, 1),
+            VectorView.shift_right(self.v, 1),
+            VectorView.rotate_left(self.v, 1),
+            VectorView.rotate_right(self.v, 3),
+            VectorView.extend(self.v, 6))
+        for view in views:
+            ref = view.to_vector()
+            self.assertEqual(list(view), [ref[i] for i in range(len(ref))])
+            self.assertEqual(len([b for b in view]), len(view))
+
+    def test_iter_copied(self):
+        view = VectorView.rotate_left(self.v, 1)
+        view[0] = imm(1)
+        self.assertTrue(view.copied())
+        self.assertEqual(list(view), [imm(1), self.v[2], self.v[3], self.v[0]])
+
+    def test_index_error(self):
+        view = VectorView.extend(self.v, 6)
+        self.assertRaises(IndexError, view.__getitem__, 6)
+        self.assertRaises(IndexError, view.__setitem__, 6, imm(0))
+        view = VectorView.rotate_left(self.v, 1)
+        view[0] = imm(1)
+        self.assertRaises(IndexError, view.__getitem__, 4)
+
+if __name__ == "__main__":
+    unittest.main()